@@ -0,0 +1,57 @@
+// Cost per frame of the global association, with tracks spread over a square kilometre and
+// the measurements of the frame, in a 50 m field of view, packed in clusters of cluster_size
+// targets within the gate.
+// usage: association_benchmark [n_tracks] [cluster_size] [n_clusters] [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "association.hpp"
+
+int main(int argc, char* argv[]) {
+  const int n_tracks = argc > 1 ? std::stoi(argv[1]) : 4096;
+  const int cluster_size = argc > 2 ? std::stoi(argv[2]) : 8;
+  const int n_clusters = argc > 3 ? std::stoi(argv[3]) : 4;
+  const int frames = argc > 4 ? std::stoi(argv[4]) : 1000;
+  const double gate = 1.0;
+
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> position(-500.0, 500.0);
+  std::uniform_real_distribution<double> view(0.0, 50.0);
+  std::normal_distribution<double> jitter(0.0, 0.15);
+  std::vector<Eigen::Vector3d> tracks(n_tracks);
+  std::vector<int> track_classes(n_tracks, 0);
+  for (auto& p : tracks) p = Eigen::Vector3d(position(rng), position(rng), 0.0);
+  // the clustered targets are the first tracks, a third of a gate apart
+  for (int c = 0; c < n_clusters; c++) {
+    const Eigen::Vector3d centre(view(rng), view(rng), 0.0);
+    for (int i = 0; i < cluster_size && c * cluster_size + i < n_tracks; i++) {
+      tracks[c * cluster_size + i] = centre + Eigen::Vector3d(0.3 * (i % 4), 0.3 * (i / 4), 0.0);
+    }
+  }
+
+  Associator associator;
+  std::vector<Eigen::Vector3d> measurements;
+  std::vector<int> measurement_classes, assignment;
+  double ns = 0.0;
+  int correct = 0, total = 0;
+  for (int frame = 0; frame < frames; frame++) {
+    measurements.clear();
+    for (int i = 0; i < n_clusters * cluster_size && i < n_tracks; i++) {
+      measurements.push_back(tracks[i] + Eigen::Vector3d(jitter(rng), jitter(rng), 0.0));
+    }
+    measurement_classes.assign(measurements.size(), 0);
+    const auto start = std::chrono::steady_clock::now();
+    associator.solve(measurements, measurement_classes, tracks, track_classes, gate, 32, assignment);
+    ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    for (size_t i = 0; i < assignment.size(); i++) correct += assignment[i] == static_cast<int>(i);
+    total += assignment.size();
+  }
+  std::printf("%d tracks, %d clusters of %d, largest component %d, %d greedy\n", n_tracks, n_clusters,
+              cluster_size, associator.largestComponent(), associator.greedyComponents());
+  std::printf("solve %10.2f us/frame, %.1f%% measurements on their own track\n", ns / frames / 1000,
+              100.0 * correct / std::max(total, 1));
+  return 0;
+}
@@ -0,0 +1,117 @@
+// Cost of building DepthIntegral over the whole frame at several depth resolutions, next to
+// the per pixel build it replaced, of a box query on it, and its agreement with the direct
+// scan of depthBoxStats on random boxes.
+// usage: depth_stats_benchmark [iterations] [n_boxes]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "depth_stats.hpp"
+
+// Ground, a wall and a few near objects, with holes and noise like a stereo sensor
+static std::vector<float> makeDepth(int width, int height) {
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::normal_distribution<float> noise(0.0f, 0.01f);
+  std::vector<float> depth(size_t(width) * height);
+  for (int v = 0; v < height; v++) {
+    for (int u = 0; u < width; u++) {
+      const float y = (v - height / 2.0f) / height;
+      float d = y > 0.02f ? 1.5f / y / 2.0f : 25.0f;
+      if (std::abs(u - width / 3) < width / 20 && std::abs(v - height / 2) < height / 10) d = 3.0f;
+      if (std::abs(u - 2 * width / 3) < width / 40 && std::abs(v - height / 3) < height / 20) d = 0.8f;
+      const float r = unit(rng);
+      depth[size_t(v) * width + u] = r < 0.05f ? 0.0f : r < 0.06f ? NAN : std::min(d, 50.0f) + noise(rng);
+    }
+  }
+  return depth;
+}
+
+// The previous build, one serial prefix per pixel reading the row above, kept as reference
+static void referenceBuild(const DepthView& depth, std::vector<double>& sum, std::vector<double>& sum_sq,
+                           std::vector<uint32_t>& count) {
+  const int cols = depth.width;
+  const size_t size = size_t(depth.height + 1) * (cols + 1);
+  sum.assign(size, 0.0);
+  sum_sq.assign(size, 0.0);
+  count.assign(size, 0);
+  for (int v = 0; v < depth.height; v++) {
+    const float* row = depth.row(v);
+    const size_t above = size_t(v) * (cols + 1), here = above + cols + 1;
+    double line_sum = 0.0, line_sum_sq = 0.0;
+    uint32_t line_count = 0;
+    for (int u = 0; u < cols; u++) {
+      const float d = row[u];
+      if (d > 0 && std::isfinite(d)) {
+        line_sum += d;
+        line_sum_sq += double(d) * d;
+        line_count++;
+      }
+      sum[here + u + 1] = sum[above + u + 1] + line_sum;
+      sum_sq[here + u + 1] = sum_sq[above + u + 1] + line_sum_sq;
+      count[here + u + 1] = count[above + u + 1] + line_count;
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const int iterations = argc > 1 ? std::stoi(argv[1]) : 50;
+  const int n_boxes = argc > 2 ? std::stoi(argv[2]) : 1000;
+  const int resolutions[][2] = {{640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+
+  std::printf("%-10s %10s %10s %10s %10s %14s %14s\n", "size", "build_ms", "ns/pixel", "ref_ns/px", "ns/query",
+              "max_mean_err", "max_std_err");
+  for (const auto& size : resolutions) {
+    const int width = size[0], height = size[1];
+    const auto pixels = makeDepth(width, height);
+    const DepthView depth{pixels.data(), width, height, size_t(width)};
+    DepthIntegral integral;
+    integral.build(depth, 0, height);  // warm up, allocates
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) integral.build(depth, 0, height);
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> ref_sum, ref_sum_sq;
+    std::vector<uint32_t> ref_count;
+    referenceBuild(depth, ref_sum, ref_sum_sq, ref_count);
+    const auto ref_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) referenceBuild(depth, ref_sum, ref_sum_sq, ref_count);
+    const double ref_ns =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - ref_start).count();
+
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> side(2, std::max(3, width / 8));
+    std::vector<PixelRect> boxes(n_boxes);
+    for (auto& box : boxes) {
+      box.width = side(rng);
+      box.height = side(rng);
+      box.x = std::uniform_int_distribution<int>(-box.width / 2, width - box.width / 2)(rng);
+      box.y = std::uniform_int_distribution<int>(-box.height / 2, height - box.height / 2)(rng);
+    }
+    std::vector<DepthBoxStats> tables(n_boxes);
+    const auto query_start = std::chrono::steady_clock::now();
+    for (int b = 0; b < n_boxes; b++) tables[b] = integral.stats(boxes[b]);
+    const double query_ns =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - query_start).count();
+
+    double max_mean_err = 0.0, max_std_err = 0.0;
+    for (int b = 0; b < n_boxes; b++) {
+      const DepthBoxStats direct = depthBoxStats(depth, boxes[b]);
+      if (direct.valid != tables[b].valid) {
+        std::printf("valid count mismatch %u %u\n", direct.valid, tables[b].valid);
+        return 1;
+      }
+      max_mean_err = std::max(max_mean_err, std::abs(direct.mean - tables[b].mean));
+      max_std_err = std::max(max_std_err, std::abs(std::sqrt(direct.variance) - std::sqrt(tables[b].variance)));
+    }
+    const double pixels_built = double(iterations) * width * height;
+    std::printf("%4dx%-5d %10.3f %10.3f %10.3f %10.1f %14.2e %14.2e\n", width, height, ns / iterations / 1e6,
+                ns / pixels_built, ref_ns / pixels_built, query_ns / n_boxes, max_mean_err, max_std_err);
+  }
+  return 0;
+}
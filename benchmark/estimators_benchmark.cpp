@@ -0,0 +1,66 @@
+// Runs every point estimator policy on the same synthetic target: a 0.3 m box lying on the
+// ground seen from 3 m, with sensor noise and a few stray points.
+// usage: estimators_benchmark [n_points] [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "point_estimators.hpp"
+
+static std::vector<Point3f> makeTarget(size_t n_points) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> side(-0.15f, 0.15f);
+  std::uniform_real_distribution<float> ground(-0.5f, 0.5f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::normal_distribution<float> noise(0.0f, 0.005f);
+
+  std::vector<Point3f> points;
+  points.reserve(n_points);
+  for (size_t i = 0; i < n_points; i++) {
+    const float kind = unit(rng);
+    if (kind < 0.5f) {
+      // box top at z = 0.3
+      points.push_back({side(rng), side(rng), 0.3f + noise(rng)});
+    } else if (kind < 0.75f) {
+      // box side facing the sensor
+      points.push_back({-0.15f + noise(rng), side(rng), unit(rng) * 0.3f});
+    } else if (kind < 0.98f) {
+      points.push_back({ground(rng), ground(rng), noise(rng)});
+    } else {
+      // stray points between the sensor and the target
+      points.push_back({-1.0f - unit(rng), side(rng), 0.2f * unit(rng)});
+    }
+  }
+  return points;
+}
+
+template <typename Set>
+static void runAll(const std::vector<Point3f>& points, int iterations) {
+  EstimatorFrame frame;
+  frame.sensor = Eigen::Vector3f(-3.0f, 0.0f, 1.5f);
+  const EstimatorParams params;
+
+  std::printf("%-18s %12s %12s   %s\n", "estimator", "us/call", "ns/point", "estimate");
+  for (int e = 0; e < Set::size; e++) {
+    Eigen::Vector3f out = Eigen::Vector3f::Zero();
+    Set::estimate(e, points.data(), points.size(), frame, params, out);  // warm up
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      Set::estimate(e, points.data(), points.size(), frame, params, out);
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-18s %12.2f %12.3f   %.3f %.3f %.3f\n", std::string(Set::name(e)).c_str(),
+                ns / iterations / 1000.0, ns / iterations / points.size(), out.x(), out.y(), out.z());
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const size_t n_points = argc > 1 ? std::stoul(argv[1]) : 5000;
+  const int iterations = argc > 2 ? std::stoi(argv[2]) : 200;
+  std::printf("%zu points, %d iterations, true top centre 0.000 0.000 0.300\n", n_points, iterations);
+  runAll<PointEstimators>(makeTarget(n_points), iterations);
+  return 0;
+}
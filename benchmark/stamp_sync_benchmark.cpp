@@ -0,0 +1,70 @@
+// Cost per message of StampSync on a 30 Hz rgb + depth stream, with the detector answering
+// every detector_period frames detector_latency frames late, and the sets it recovers. With
+// a tolerance the depth stamps get up to tolerance / 2 of jitter against the rgb ones.
+// usage: stamp_sync_benchmark [frames] [detector_period] [detector_latency] [tolerance_ms] [window_ms]
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <string>
+
+#include "stamp_sync.hpp"
+
+struct Frame {
+  int64_t stamp;
+};
+
+int main(int argc, char* argv[]) {
+  const int frames = argc > 1 ? std::stoi(argv[1]) : 1000000;
+  const int detector_period = argc > 2 ? std::stoi(argv[2]) : 3;
+  const int detector_latency = argc > 3 ? std::stoi(argv[3]) : 10;
+  const int64_t tolerance = argc > 4 ? static_cast<int64_t>(std::stod(argv[4]) * 1e6) : 0;
+  const int64_t window = argc > 5 ? static_cast<int64_t>(std::stod(argv[5]) * 1e6) : 1000000000;
+  const int64_t period = 33333333;
+
+  uint64_t received = 0, wrong = 0;
+  StampSync<Frame, Frame, Frame> sync(
+      tolerance, window, {true, true, true},
+      [&](const std::shared_ptr<Frame>& rgb, const std::shared_ptr<Frame>& depth,
+          const std::shared_ptr<Frame>& detections) {
+        received++;
+        wrong += rgb->stamp != detections->stamp || std::abs(depth->stamp - rgb->stamp) > tolerance;
+      });
+
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<int64_t> jitter(-tolerance / 2, tolerance / 2);
+  std::bernoulli_distribution depth_first(0.5);
+  std::deque<std::shared_ptr<Frame>> pending_detections;
+  int sent_detections = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++) {
+    const int64_t stamp = 1700000000000000000 + f * period;
+    auto rgb = std::make_shared<Frame>(Frame{stamp});
+    auto depth = std::make_shared<Frame>(Frame{stamp + jitter(rng)});
+    if (depth_first(rng)) {
+      sync.add<1>(depth->stamp, depth);
+      sync.add<0>(stamp, rgb);
+    } else {
+      sync.add<0>(stamp, rgb);
+      sync.add<1>(depth->stamp, depth);
+    }
+    if (f % detector_period == 0) pending_detections.push_back(std::make_shared<Frame>(Frame{stamp}));
+    if (!pending_detections.empty() && pending_detections.front()->stamp <= stamp - detector_latency * period) {
+      sync.add<2>(pending_detections.front()->stamp, pending_detections.front());
+      pending_detections.pop_front();
+      sent_detections++;
+    }
+  }
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  const auto& stats = sync.stats();
+  std::printf("%d frames, detector every %d frames %d frames late, tolerance %.1f ms, window %.1f ms\n", frames,
+              detector_period, detector_latency, tolerance / 1e6, window / 1e6);
+  std::printf("add %8.1f ns/message\n", ns / (2.0 * frames + sent_detections));
+  std::printf("matched %lu of %d detections, %lu wrong, partial %lu, dropped rgb %lu depth %lu detections %lu\n",
+              static_cast<unsigned long>(stats.matched.load()), sent_detections, static_cast<unsigned long>(wrong),
+              static_cast<unsigned long>(stats.partial.load()), static_cast<unsigned long>(stats.dropped[0].load()),
+              static_cast<unsigned long>(stats.dropped[1].load()), static_cast<unsigned long>(stats.dropped[2].load()));
+  return received == stats.matched && wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+// Cost per track of the batched commit and predict of TrackTable, with a fraction of the
+// tracks measured each frame.
+// usage: track_table_benchmark [n_tracks] [frames] [measured_fraction]
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "track_table.hpp"
+
+int main(int argc, char* argv[]) {
+  const size_t n_tracks = argc > 1 ? std::stoul(argv[1]) : 4096;
+  const int frames = argc > 2 ? std::stoi(argv[2]) : 2000;
+  const double measured = argc > 3 ? std::stod(argv[3]) : 0.25;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  TrackTable table;
+  for (size_t i = 0; i < n_tracks; i++) table.add(Eigen::Vector3f(position(rng), position(rng), 0.0f), 0.0);
+
+  double commit_ns = 0, predict_ns = 0;
+  for (int frame = 1; frame <= frames; frame++) {
+    const double stamp = frame * 0.033;
+    for (uint32_t slot = 0; slot < n_tracks; slot++) {
+      if (unit(rng) < measured) table.stage(slot, table.filtered(slot) + Eigen::Vector3f(0.01f, 0.0f, 0.0f));
+    }
+    auto start = std::chrono::steady_clock::now();
+    table.commit(stamp);
+    auto middle = std::chrono::steady_clock::now();
+    table.predict(stamp + 0.033);
+    auto end = std::chrono::steady_clock::now();
+    commit_ns += std::chrono::duration<double, std::nano>(middle - start).count();
+    predict_ns += std::chrono::duration<double, std::nano>(end - middle).count();
+  }
+  std::printf("%zu tracks, %d frames, %.0f%% measured per frame\n", n_tracks, frames, measured * 100);
+  std::printf("commit  %8.3f ns/track %10.2f us/frame\n", commit_ns / frames / n_tracks, commit_ns / frames / 1000);
+  std::printf("predict %8.3f ns/track %10.2f us/frame\n", predict_ns / frames / n_tracks, predict_ns / frames / 1000);
+  const auto v = table.velocity(0);
+  std::printf("track 0 velocity %.3f %.3f %.3f\n", v.x(), v.y(), v.z());
+  return 0;
+}
@@ -0,0 +1,90 @@
+// Compares VoxelHash against std::unordered_map on the per frame pattern of the spatial
+// stages: clear, accumulate a cloud into voxels, then probe the 26 neighbours of every voxel.
+// usage: voxel_hash_benchmark [n_points] [voxel_size] [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "voxel_hash.hpp"
+
+struct Point {
+  float x, y, z;
+};
+
+static std::vector<Point> makeCloud(size_t n_points) {
+  // a 1 m box surface seen from one side plus ground, like an ROI crop
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::normal_distribution<float> noise(0.0f, 0.005f);
+  std::vector<Point> cloud(n_points);
+  for (auto& p : cloud) {
+    if (unit(rng) < 0.6f) {
+      p = {unit(rng), unit(rng), 1.0f + noise(rng)};
+    } else {
+      p = {2.0f * unit(rng) - 0.5f, 2.0f * unit(rng) - 0.5f, noise(rng)};
+    }
+  }
+  return cloud;
+}
+
+template <typename F>
+static double nsPerCall(int iterations, F&& f) {
+  f();  // warm up
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) f();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+  const size_t n_points = argc > 1 ? std::stoul(argv[1]) : 20000;
+  const float voxel_size = argc > 2 ? std::stof(argv[2]) : 0.05f;
+  const int iterations = argc > 3 ? std::stoi(argv[3]) : 200;
+  const auto cloud = makeCloud(n_points);
+  const float inv = 1.0f / voxel_size;
+
+  VoxelHash<uint32_t> hash(n_points);
+  std::unordered_map<uint64_t, uint32_t> map;
+  size_t hash_hits = 0, map_hits = 0;
+
+  const double hash_insert = nsPerCall(iterations, [&] {
+    hash.clear();
+    for (const auto& p : cloud) (*hash.findOrInsert(voxelKey(p.x, p.y, p.z, inv)))++;
+  });
+  const double hash_neighbours = nsPerCall(iterations, [&] {
+    hash_hits = 0;
+    hash.forEach([&](uint64_t key, uint32_t) {
+      for (int dx = -1; dx <= 1; dx++)
+        for (int dy = -1; dy <= 1; dy++)
+          for (int dz = -1; dz <= 1; dz++) hash_hits += hash.find(voxelNeighbour(key, dx, dy, dz)) != nullptr;
+    });
+  });
+
+  const double map_insert = nsPerCall(iterations, [&] {
+    map.clear();
+    for (const auto& p : cloud) map[voxelKey(p.x, p.y, p.z, inv)]++;
+  });
+  const double map_neighbours = nsPerCall(iterations, [&] {
+    map_hits = 0;
+    for (const auto& [key, count] : map) {
+      for (int dx = -1; dx <= 1; dx++)
+        for (int dy = -1; dy <= 1; dy++)
+          for (int dz = -1; dz <= 1; dz++) map_hits += map.count(voxelNeighbour(key, dx, dy, dz));
+    }
+  });
+
+  std::printf("%zu points, %zu voxels of %.3f m, %d iterations\n", n_points, hash.size(), voxel_size, iterations);
+  std::printf("%-14s %14s %16s %12s\n", "container", "insert ns/pt", "neighbours us", "bytes");
+  std::printf("%-14s %14.2f %16.2f %12zu\n", "voxel_hash", hash_insert / n_points, hash_neighbours / 1000.0,
+              hash.bytes());
+  std::printf("%-14s %14.2f %16.2f %12zu\n", "unordered_map", map_insert / n_points, map_neighbours / 1000.0,
+              map.bucket_count() * sizeof(void*) + map.size() * (sizeof(std::pair<uint64_t, uint32_t>) + 2 * sizeof(void*)));
+  if (hash_hits != map_hits || hash.size() != map.size()) {
+    std::printf("mismatch: %zu vs %zu neighbours\n", hash_hits, map_hits);
+    return 1;
+  }
+  return 0;
+}
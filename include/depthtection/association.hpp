@@ -0,0 +1,80 @@
+/**
+ * @file association.hpp
+ * @brief Global assignment of the measurements of one frame to the predicted tracks.
+ *
+ * Same class pairs closer than the gate are the edges of a bipartite graph, found through a
+ * sorted grid of gate sized cells. Each connected component is solved on its own with the
+ * Hungarian method, where leaving a measurement unassigned costs as much as a pair at the
+ * gate, so the result does not depend on the box order and the work grows with the largest
+ * cluster instead of the number of tracks. Components with more than max_component
+ * measurements or tracks are assigned greedily, closest pair first.
+ */
+
+#ifndef __ASSOCIATION_HPP__
+#define __ASSOCIATION_HPP__
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "voxel_hash.hpp"
+
+class Associator {
+  public:
+  // assignment[i] is the track of measurement i, or -1 when it is left for a new track. A
+  // measurement only goes to a track of the same class, tracks of class -1 are never used.
+  void solve(const std::vector<Eigen::Vector3d>& measurements, const std::vector<int>& measurement_classes,
+             const std::vector<Eigen::Vector3d>& tracks, const std::vector<int>& track_classes, double gate,
+             int max_component, std::vector<int>& assignment);
+
+  // Of the last solve
+  int components() const { return components_; }
+  int largestComponent() const { return largest_component_; }
+  int greedyComponents() const { return greedy_components_; }
+
+  size_t bytes() const;
+
+  private:
+  struct Edge {
+    int measurement;
+    int track;
+    int track_node;  // the track among the graph nodes, after the measurements
+    double cost;     // squared distance
+    int component;
+  };
+
+  int find(int node);
+  int trackOf(int node) const { return track_nodes_[node - n_measurements_]; }
+  // Exact solve of the edges of one component, rows measurements and cols tracks
+  void hungarian(const Edge* edges, size_t n_edges, int rows, int cols, double gate_cost,
+                 std::vector<int>& assignment);
+  void greedy(Edge* edges, size_t n_edges, std::vector<int>& assignment);
+
+  int components_ = 0;
+  int largest_component_ = 0;
+  int greedy_components_ = 0;
+
+  // grid cell key and measurement, sorted by key
+  std::vector<std::pair<uint64_t, int>> cells_;
+  // cells next to a measurement
+  VoxelHash<uint8_t> near_{1024};
+  std::vector<Edge> edges_;
+  // tracks with a gated pair, in node order
+  std::vector<int> track_nodes_;
+  int n_measurements_ = 0;
+  // union-find over the nodes
+  std::vector<int> parent_;
+  // component local index of each node, -1 outside the current component
+  std::vector<int> local_;
+  // nodes of the current component
+  std::vector<int> rows_, cols_;
+  std::vector<uint8_t> used_;
+  // Hungarian method state, rows x (cols + rows) costs, the last rows columns leave a row
+  // unassigned
+  std::vector<double> cost_, u_, v_, min_v_;
+  std::vector<int> match_, way_;
+  std::vector<uint8_t> visited_;
+};
+
+#endif  // __ASSOCIATION_HPP__
@@ -0,0 +1,90 @@
+/**
+ * @file batch_evaluation.hpp
+ * @brief Offline evaluation of the core over whole datasets held in memory.
+ *
+ * Depth frames and boxes are read in place through strided views, so arrays owned by the
+ * caller (NumPy through the depthtection_py module) are never copied. Estimation is
+ * stateless per box and split across threads, tracking runs the frames in order.
+ */
+
+#ifndef __BATCH_EVALUATION_HPP__
+#define __BATCH_EVALUATION_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "depthtection_core.hpp"
+
+// n_frames x height x width float depth in metres, strides in floats
+struct DepthBatch {
+  const float* data = nullptr;
+  int n_frames = 0;
+  int height = 0;
+  int width = 0;
+  ptrdiff_t frame_stride = 0;
+  ptrdiff_t row_stride = 0;
+
+  DepthView frame(int i) const {
+    return DepthView{data + i * frame_stride, width, height, static_cast<size_t>(row_stride)};
+  }
+};
+
+// Rows of [frame, center_x, center_y, size_x, size_y, score, class], class indexes classes
+struct BoxBatch {
+  static constexpr int COLUMNS = 7;
+  const double* data = nullptr;
+  size_t n = 0;
+  ptrdiff_t stride = COLUMNS;  // doubles per row
+
+  const double* row(size_t i) const { return data + i * stride; }
+  int frame(size_t i) const { return static_cast<int>(row(i)[0]); }
+};
+
+struct BatchConfig {
+  CoreParams params;
+  std::string estimator = "top_slab";
+  // class name, estimator name
+  std::vector<std::pair<std::string, std::string>> class_estimators;
+  std::vector<std::string> classes;
+  // CameraInfo fields, k row major
+  std::string distortion_model = "plumb_bob";
+  double k[9] = {0, 0, 0, 0, 0, 0, 0, 0, 1};
+  std::vector<double> d;
+  int width = 0;
+  int height = 0;
+};
+
+class BatchEvaluator {
+  public:
+  // error is set and valid() is false on an unknown estimator or a missing camera
+  BatchEvaluator(const BatchConfig& config, std::string& error);
+
+  bool valid() const { return valid_; }
+
+  // Position of every box in the optical frame, or in the tracking frame when poses
+  // (n_frames row major 4x4 optical to earth) are given. valid[i] is 0 for boxes without
+  // depth, out_xyz is n x 3. n_threads 0 uses every core.
+  bool estimate(const DepthBatch& depths, const BoxBatch& boxes, const double* poses, int n_threads, float* out_xyz,
+                uint8_t* out_valid, std::string& error) const;
+
+  // Runs the tracker over the frames in order with a fresh track store. Boxes must be sorted
+  // by frame. Per box: BoxOutcome, track id (-1 if rejected) and the filtered track position
+  // after the frame.
+  bool track(const DepthBatch& depths, const BoxBatch& boxes, const double* poses, const double* stamps,
+             uint8_t* out_outcome, int32_t* out_track_id, float* out_xyz, std::string& error) const;
+
+  private:
+  std::unique_ptr<DepthtectionCore> makeCore() const;
+  bool checkBoxes(const DepthBatch& depths, const BoxBatch& boxes, std::string& error) const;
+  BoundingBox boxAt(const BoxBatch& boxes, size_t i) const;
+
+  BatchConfig config_;
+  CameraModel camera_;
+  bool valid_ = false;
+};
+
+#endif  // __BATCH_EVALUATION_HPP__
@@ -0,0 +1,151 @@
+/**
+ * @file camera_model.hpp
+ * @brief Depth back-projection specialized per CameraInfo distortion model.
+ *
+ * Intrinsics are kept as typed members. Distorted models undistort every pixel once into a
+ * table of normalized rays, so back-projecting a pixel costs a table read and three
+ * multiplications whatever the model. Callers visit the CameraModel variant once per region
+ * so the per pixel loop is compiled for the concrete model.
+ *
+ * The inverse of the distortion has no closed form, inlined it would be an iterative solve per
+ * pixel rather than a few multiply-adds. The table trades that for 8 bytes per pixel, 7.4 MB
+ * at 1280x720 and 16.6 MB at 1920x1080, built in 0.2 to 0.7 s when the calibration arrives.
+ *
+ * A new model only needs a distortion struct with name, distort() and undistort(), and an
+ * entry in CameraModel and makeCameraModel().
+ */
+
+#ifndef __CAMERA_MODEL_HPP__
+#define __CAMERA_MODEL_HPP__
+
+#include <Eigen/Dense>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+struct PinholeModel {
+  static constexpr std::string_view name = "pinhole";
+  float fx = 1.0f, fy = 1.0f, cx = 0.0f, cy = 0.0f;
+  float inv_fx = 1.0f, inv_fy = 1.0f;
+
+  PinholeModel() = default;
+  PinholeModel(float fx, float fy, float cx, float cy)
+      : fx(fx), fy(fy), cx(cx), cy(cy), inv_fx(1.0f / fx), inv_fy(1.0f / fy) {}
+
+  const PinholeModel& pinhole() const { return *this; }
+
+  Eigen::Vector3f backProject(int u, int v, float depth) const {
+    return Eigen::Vector3f((u - cx) * inv_fx * depth, (v - cy) * inv_fy * depth, depth);
+  }
+};
+
+// sensor_msgs::distortion_models::PLUMB_BOB, k1 k2 p1 p2 k3
+struct PlumbBobDistortion {
+  static constexpr std::string_view name = "plumb_bob";
+  float k1 = 0, k2 = 0, p1 = 0, p2 = 0, k3 = 0;
+
+  Eigen::Vector2f distort(const Eigen::Vector2f& p) const {
+    const float r2 = p.squaredNorm();
+    const float radial = 1.0f + r2 * (k1 + r2 * (k2 + r2 * k3));
+    return Eigen::Vector2f(p.x() * radial + 2 * p1 * p.x() * p.y() + p2 * (r2 + 2 * p.x() * p.x()),
+                           p.y() * radial + p1 * (r2 + 2 * p.y() * p.y()) + 2 * p2 * p.x() * p.y());
+  }
+
+  // fixed point iteration, as cv::undistortPoints
+  Eigen::Vector2f undistort(const Eigen::Vector2f& distorted) const {
+    Eigen::Vector2f p = distorted;
+    for (int i = 0; i < 20; i++) {
+      const float r2 = p.squaredNorm();
+      const float radial = 1.0f + r2 * (k1 + r2 * (k2 + r2 * k3));
+      const Eigen::Vector2f tangential(2 * p1 * p.x() * p.y() + p2 * (r2 + 2 * p.x() * p.x()),
+                                       p1 * (r2 + 2 * p.y() * p.y()) + 2 * p2 * p.x() * p.y());
+      p = (distorted - tangential) / radial;
+    }
+    return p;
+  }
+};
+
+// sensor_msgs::distortion_models::EQUIDISTANT (fisheye), k1 k2 k3 k4 on the incidence angle
+struct EquidistantDistortion {
+  static constexpr std::string_view name = "equidistant";
+  float k1 = 0, k2 = 0, k3 = 0, k4 = 0;
+
+  Eigen::Vector2f distort(const Eigen::Vector2f& p) const {
+    const float r = p.norm();
+    if (r < 1e-8f) return p;
+    const float theta = std::atan(r);
+    const float t2 = theta * theta;
+    const float theta_d = theta * (1 + t2 * (k1 + t2 * (k2 + t2 * (k3 + t2 * k4))));
+    return p * (theta_d / r);
+  }
+
+  // Newton on theta_d = f(theta)
+  Eigen::Vector2f undistort(const Eigen::Vector2f& distorted) const {
+    const float theta_d = distorted.norm();
+    if (theta_d < 1e-8f) return distorted;
+    float theta = theta_d;
+    for (int i = 0; i < 10; i++) {
+      const float t2 = theta * theta;
+      const float f = theta * (1 + t2 * (k1 + t2 * (k2 + t2 * (k3 + t2 * k4)))) - theta_d;
+      const float df = 1 + t2 * (3 * k1 + t2 * (5 * k2 + t2 * (7 * k3 + t2 * 9 * k4)));
+      theta -= f / df;
+    }
+    return distorted * (std::tan(theta) / theta_d);
+  }
+};
+
+template <typename Distortion>
+struct DistortedModel {
+  static constexpr std::string_view name = Distortion::name;
+  PinholeModel intrinsics;
+  Distortion distortion;
+  int width = 0, height = 0;
+  std::vector<float> rays;  // normalized x, y per pixel
+
+  DistortedModel() = default;
+  DistortedModel(const PinholeModel& intrinsics, const Distortion& distortion, int width, int height)
+      : intrinsics(intrinsics), distortion(distortion), width(width), height(height) {
+    rays.resize(size_t(width) * height * 2);
+    for (int v = 0; v < height; v++) {
+      for (int u = 0; u < width; u++) {
+        const Eigen::Vector2f distorted((u - intrinsics.cx) * intrinsics.inv_fx, (v - intrinsics.cy) * intrinsics.inv_fy);
+        const Eigen::Vector2f ray = distortion.undistort(distorted);
+        rays[(size_t(v) * width + u) * 2] = ray.x();
+        rays[(size_t(v) * width + u) * 2 + 1] = ray.y();
+      }
+    }
+  }
+
+  const PinholeModel& pinhole() const { return intrinsics; }
+
+  Eigen::Vector3f backProject(int u, int v, float depth) const {
+    if (static_cast<unsigned>(u) >= static_cast<unsigned>(width) ||
+        static_cast<unsigned>(v) >= static_cast<unsigned>(height)) {
+      // image not matching the calibration size
+      return intrinsics.backProject(u, v, depth);
+    }
+    const float* ray = &rays[(size_t(v) * width + u) * 2];
+    return Eigen::Vector3f(ray[0] * depth, ray[1] * depth, depth);
+  }
+};
+
+typedef std::variant<PinholeModel, DistortedModel<PlumbBobDistortion>, DistortedModel<EquidistantDistortion>>
+    CameraModel;
+
+// Builds the model named by CameraInfo::distortion_model from its k (row major 3x3) and d.
+// Zero distortion gives the plain pinhole model. Unknown models fall back to pinhole and
+// report it in error.
+CameraModel makeCameraModel(const std::string& distortion_model, const double* k, const std::vector<double>& d,
+                            int width, int height, std::string& error);
+
+inline std::string_view cameraModelName(const CameraModel& model) {
+  return std::visit([](const auto& camera) { return camera.name; }, model);
+}
+
+inline const PinholeModel& cameraIntrinsics(const CameraModel& model) {
+  return std::visit([](const auto& camera) -> const PinholeModel& { return camera.pinhole(); }, model);
+}
+
+#endif  // __CAMERA_MODEL_HPP__
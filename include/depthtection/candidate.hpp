@@ -2,17 +2,21 @@
 #define __CANDIDATE_HPP__
 
 #include <Eigen/Dense>
-#include <geometry_msgs/msg/point_stamped.hpp>
-#include <geometry_msgs/msg/pose_stamped.hpp>
 #include <iostream>
+#include <limits>
 #include <memory>
-#include <rclcpp/clock.hpp>
-#include <rclcpp/logging.hpp>
-#include <rclcpp/rclcpp.hpp>
-#include <rclcpp/time.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
 
-#define N_STEPS_PREDICTION 10
-#define N_MEASURES_BEFORE_PREDICTION 2
+#include "point_history.hpp"
+#include "track_table.hpp"
+
+// Position in the tracking frame and its stamp in seconds
+struct TrackPoint {
+  Eigen::Vector3d position = Eigen::Vector3d::Zero();
+  double stamp = 0.0;
+};
 
 struct Candidate {
   typedef std::shared_ptr<Candidate> Ptr;
@@ -22,112 +26,67 @@ struct Candidate {
   int id;
   float confidence;
   std::string class_name;
-  geometry_msgs::msg::PointStamped point;
-  geometry_msgs::msg::PointStamped raw_point;
-
-  std::shared_ptr<rclcpp::Clock> clock;
-
-  Candidate(int id, float confidence, std::string_view class_name, geometry_msgs::msg::PointStamped point,
-            std::shared_ptr<rclcpp::Clock> clock)
-      : id(id), confidence(confidence), class_name(class_name), point(point), clock(clock) {
+  TrackPoint point;
+  TrackPoint raw_point;
+
+  // filter state lives in the shared table, see TrackTable
+  std::shared_ptr<TrackTable> table;
+  uint32_t slot;
+
+  // size of the last detection box in metres, 0 until one is seen
+  float extent = 0.0f;
+
+  // created from a track shared by another vehicle
+  bool remote = false;
+  // dropped from the store, fused into another candidate or expired
+  bool merged = false;
+  // recent cloud ROI points, allocated once at the first cloud update
+  std::shared_ptr<PointHistory> roi_history;
+
+  Candidate(int id, float confidence, std::string_view class_name, const TrackPoint& point,
+            std::shared_ptr<TrackTable> table)
+      : id(id), confidence(confidence), class_name(class_name), point(point), raw_point(point), table(table) {
+    slot = table->add(point.position.cast<float>(), point.stamp);
     speed = Eigen::Vector3d::Zero();
     filtered_point = point;
-    last_time = clock->now();
+    compensated_point = point;
   }
 
-  Eigen::Vector3d getEigen() const { return Eigen::Vector3d(point.point.x, point.point.y, point.point.z); }
-  Eigen::Vector3d getFilteredEigen() const {
-    return Eigen::Vector3d(filtered_point.point.x, filtered_point.point.y, filtered_point.point.z);
-  }
+  Eigen::Vector3d getEigen() const { return point.position; }
+  Eigen::Vector3d getFilteredEigen() const { return filtered_point.position; }
+  // Position extrapolated by the last TrackTable::predict
+  Eigen::Vector3d getPredictedEigen() const { return table->predicted(slot).cast<double>(); }
 
   Eigen::Vector3d speed;
-  geometry_msgs::msg::PointStamped filtered_point;
-  geometry_msgs::msg::PointStamped compensated_point;
-  double dt_cummulative = 0.0;
-  int n_speed_measures = 0;
-
-  rclcpp::Time last_time;
+  TrackPoint filtered_point;
+  TrackPoint compensated_point;
 
-  void updatePoint(geometry_msgs::msg::PointStamped point, bool filter = true) {
+  // Stages a measurement, it is applied with the rest of the frame by TrackTable::commit and
+  // seen here after syncFromTable
+  void updatePoint(const TrackPoint& point) {
     raw_point = point;
-    if (filter) {
-      const float alpha = 0.1;
-      std::cout << "point " << point.point.x << " " << point.point.y << " " << point.point.z << std::endl;
-      this->filtered_point.point.x = alpha * point.point.x + (1 - alpha) * this->filtered_point.point.x;
-      this->filtered_point.point.y = alpha * point.point.y + (1 - alpha) * this->filtered_point.point.y;
-      this->filtered_point.point.z = alpha * point.point.z + (1 - alpha) * this->filtered_point.point.z;
-      this->filtered_point.header = point.header;
-      std::cout << "filtered_point" << filtered_point.point.x << " " << filtered_point.point.y << " "
-                << filtered_point.point.z << std::endl;
-      const auto dt = getDt();
-      this->point = filtered_point;
-
-      if (dt_cummulative < 1.0) {
-        dt_cummulative += dt;
-        std::cout << "dt_cummulative " << dt_cummulative << std::endl;
-      } else {
-        estimateSpeed(dt_cummulative, this->getFilteredEigen());
-        dt_cummulative = 0.0;
-      }
-
-      if (n_speed_measures > N_MEASURES_BEFORE_PREDICTION) {
-        // if (false) {
-        std::cout << "Filtering dt: " << dt << std::endl;
-        this->compensated_point.point.x = this->filtered_point.point.x + speed.x() * N_STEPS_PREDICTION * 0.008;
-        this->compensated_point.point.y = this->filtered_point.point.y + speed.y() * N_STEPS_PREDICTION * 0.008;
-        this->compensated_point.point.z = this->filtered_point.point.z + speed.z() * N_STEPS_PREDICTION * 0.008;
-        this->compensated_point.header = this->filtered_point.header;
-      } 
-
-    } else {
-      this->point = point;
-    }
-    this->point.header = point.header;
+    table->stage(slot, point.position.cast<float>());
   }
 
-
-  double getDt() {
-    rclcpp::Time now = clock->now();
-    auto dt = (now - last_time).seconds();
-    this->last_time = now;
-    return dt;
+  // Copies the table state into the published points
+  void syncFromTable() {
+    filtered_point.position = table->filtered(slot).cast<double>();
+    compensated_point.position = table->compensated(slot).cast<double>();
+    speed = table->velocity(slot).cast<double>();
+    // a late measurement leaves the state at the newest one
+    filtered_point.stamp = table->lastUpdate(slot);
+    compensated_point.stamp = filtered_point.stamp;
+    point = filtered_point;
   }
 
-  Eigen::Vector3d last_position;
-  void estimateSpeed(double dt, Eigen::Vector3d position) {
-    if (dt <= 0) {
-      std::cerr << "dt <= 0" << std::endl;
-      return;
-    }
-    const float alpha = 0.1;
-    if (n_speed_measures== 0) {
-      last_position = position;
-      n_speed_measures++;
-      return;
-    }
-    if (n_speed_measures == 1) {
-      speed.x() = (position.x() - last_position.x()) / dt;
-      speed.y() = (position.y() - last_position.y()) / dt;
-      speed.z() = (position.z() - last_position.z()) / dt;
-    } else {
-      speed.x() = alpha * (position.x() - last_position.x()) / dt + (1 - alpha) * speed.x();
-      speed.y() = alpha * (position.y() - last_position.y()) / dt + (1 - alpha) * speed.y();
-      speed.z() = alpha * (position.z() - last_position.z()) / dt + (1 - alpha) * speed.z();
-      // speed = alpha * (position - last_position) / dt + (1 - alpha) * speed;
-    }
-    n_speed_measures++;
-    last_position = position;
-    std::cout << "speed: " << speed.transpose() << std::endl;
-  }
-  operator geometry_msgs::msg::PointStamped() & { return point; }
-  double& x() { return point.point.x; }
-  double& y() { return point.point.y; }
-  double& z() { return point.point.z; }
+  double& x() { return point.position.x(); }
+  double& y() { return point.position.y(); }
+  double& z() { return point.position.z(); }
 
   operator std::string() const {
     auto str = std::string("id: ") + std::to_string(id) + ", confidence: " + std::to_string(confidence) +
-                      ", class_name: " + std::string(class_name) + ", point: " + std::to_string(point.point.x) + ", " +
-                      std::to_string(point.point.y) + ", " + std::to_string(point.point.z);
+                      ", class_name: " + std::string(class_name) + ", point: " + std::to_string(point.position.x()) + ", " +
+                      std::to_string(point.position.y()) + ", " + std::to_string(point.position.z());
     return str;
   }
 
@@ -137,18 +96,38 @@ struct Candidate {
     os << candidate.to_string();
     return os;
   }
-
-  operator geometry_msgs::msg::PoseStamped() & {
-    geometry_msgs::msg::PoseStamped pose;
-    pose.header = point.header;
-    pose.pose.position = point.point;
-    pose.pose.orientation = geometry_msgs::msg::Quaternion();
-    return pose;
-  }
 };
 
 Candidate::Ptr match_candidate(const Candidate::Vec& candidate_list, std::string_view class_name,
-                               geometry_msgs::msg::PointStamped point,
+                               const Eigen::Vector3d& position,
                                double max_distance = std::numeric_limits<double>::max());
 
+// Fuses the state of removed into kept, weighting each track by its confidence. kept is
+// remote only if both are.
+void fuse_candidates(Candidate& kept, const Candidate& removed);
+
+// Finds same-class candidates closer than a merge radius with a sort-and-sweep over x and
+// fuses them. Work is split across calls: each call makes at most max_checks steps of the
+// sweep, pairs or anchor advances. Once a full sweep completes the order is updated and
+// re-sorted, which counts as one step per track. candidates must be in creation order, as the
+// track store keeps them.
+class CandidateMerger {
+  public:
+  CandidateMerger(double merge_radius, size_t max_checks) : merge_radius_(merge_radius), max_checks_(max_checks) {}
+
+  // Returns the number of merges done in this call. best is remapped if it was merged away.
+  int step(Candidate::Vec& candidates, Candidate::Ptr& best);
+
+  private:
+  void restart(const Candidate::Vec& candidates);
+
+  double merge_radius_;
+  size_t max_checks_;
+  Candidate::Vec sweep_order_;
+  // last track id in the sweep order, newer ones are appended at the next restart
+  int newest_id_ = 0;
+  size_t anchor_ = 0;
+  size_t next_ = 1;
+};
+
 #endif  // __CANDIDATE_HPP__
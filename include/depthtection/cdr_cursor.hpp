@@ -0,0 +1,43 @@
+/**
+ * @file cdr_cursor.hpp
+ * @brief Bounds checked reader of CDR little endian buffers, shared by the in place parsers
+ * of serialized messages.
+ */
+
+#ifndef __CDR_CURSOR_HPP__
+#define __CDR_CURSOR_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Alignment is relative to the end of the 4 byte encapsulation header. Every read fails
+// instead of going past size.
+struct CdrCursor {
+  const uint8_t* base;
+  size_t size;
+  size_t pos;
+
+  bool align(size_t n) {
+    pos = 4 + (pos - 4 + n - 1) / n * n;
+    return pos <= size;
+  }
+  template <typename T>
+  bool read(T& value) {
+    if (!align(sizeof(T)) || pos + sizeof(T) > size) return false;
+    std::memcpy(&value, base + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
+  bool readString(std::string& value) {
+    uint32_t length;
+    if (!read(length) || pos + length > size) return false;
+    // the length counts the terminating null
+    value.assign(reinterpret_cast<const char*>(base + pos), length ? length - 1 : 0);
+    pos += length;
+    return true;
+  }
+};
+
+#endif  // __CDR_CURSOR_HPP__
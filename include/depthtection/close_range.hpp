@@ -0,0 +1,51 @@
+/**
+ * @file close_range.hpp
+ * @brief Nearest surface in a small central depth ROI, for targets too close for the cloud.
+ *
+ * The ROI is subsampled to at most MAX_SAMPLES pixels and back-projected. The estimate is
+ * the centroid of the samples within near_band of a low depth percentile, so a few speckles
+ * in front of the target do not pull it. Frames with too little valid depth count as
+ * invalid, and after max_invalid_frames of them in a row the target is lost.
+ */
+
+#ifndef __CLOSE_RANGE_HPP__
+#define __CLOSE_RANGE_HPP__
+
+#include <Eigen/Dense>
+#include <vector>
+
+#include "camera_model.hpp"
+#include "depth_view.hpp"
+#include "point_estimators.hpp"
+
+struct CloseRangeParams {
+  double roi_fraction = 0.2;  // ROI side over the image side
+  double percentile = 0.05;   // of the ROI depths, taken as the nearest surface
+  double near_band = 0.03;    // metres behind the nearest surface averaged into the estimate
+  double min_fill = 0.3;      // valid fraction of the ROI samples for a usable frame
+  double min_depth = 0.05;    // closer readings are sensor noise
+  int max_invalid_frames = 5;
+};
+
+// Central rect of the image covering roi_fraction of each side
+PixelRect closeRangeRoi(int width, int height, double roi_fraction);
+
+class CloseRangeEstimator {
+  public:
+  static constexpr int MAX_SAMPLES = 1024;
+
+  // Nearest surface in the optical frame. False on an invalid frame.
+  bool estimate(const DepthView& depth, const CameraModel& camera, const CloseRangeParams& params,
+                Eigen::Vector3f& out);
+
+  void reset() { invalid_frames_ = 0; }
+  bool lost(const CloseRangeParams& params) const { return invalid_frames_ >= params.max_invalid_frames; }
+
+  size_t bytes() const { return samples_.capacity() * sizeof(Point3f); }
+
+  private:
+  std::vector<Point3f> samples_;
+  int invalid_frames_ = 0;
+};
+
+#endif  // __CLOSE_RANGE_HPP__
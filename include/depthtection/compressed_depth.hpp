@@ -0,0 +1,92 @@
+/**
+ * @file compressed_depth.hpp
+ * @brief Row restricted decoding of compressedDepth (PNG or RVL) images.
+ *
+ * Both codecs are sequential, so rows above the region still have to be parsed, but they are
+ * not written and decoding stops right after the last requested row. RVL records the decoder
+ * state at the start of every row it passes, so later requests on the same frame resume from
+ * the nearest row instead of the beginning.
+ */
+
+#ifndef __COMPRESSED_DEPTH_HPP__
+#define __COMPRESSED_DEPTH_HPP__
+
+#include <png.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Half open row intervals [first, second)
+typedef std::vector<std::pair<int, int>> RowRanges;
+
+// Clamps to [0, n_rows), sorts and merges overlapping or touching ranges
+RowRanges mergeRowRanges(RowRanges ranges, int n_rows);
+
+class CompressedDepthDecoder {
+  public:
+  CompressedDepthDecoder() = default;
+  ~CompressedDepthDecoder();
+  CompressedDepthDecoder(const CompressedDepthDecoder&) = delete;
+  CompressedDepthDecoder& operator=(const CompressedDepthDecoder&) = delete;
+
+  // Parses the headers of a compressedDepth payload. format is the CompressedImage format
+  // field, e.g. "32FC1; compressedDepth png" or "16UC1; compressedDepth rvl". The data must
+  // outlive the decodeRows calls.
+  bool reset(const std::string& format, const uint8_t* data, size_t size, std::string& error);
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  // Writes the requested rows as metres (0 when invalid) into depth, a height x width float
+  // image with stride floats per row. Other rows are not touched.
+  bool decodeRows(const RowRanges& rows, float* depth, size_t stride, std::string& error);
+
+  private:
+  struct RvlState {
+    size_t word_pos = 0;
+    uint32_t word = 0;
+    int nibbles = 0;
+    int zeros = 0;
+    int nonzeros = 0;
+    int16_t previous = 0;
+  };
+
+  bool rvlDecodeVLE(RvlState& state, int& value) const;
+  bool rvlDecodeRow(RvlState& state, float* row) const;
+  bool rvlDecodeRows(const RowRanges& rows, float* depth, size_t stride, std::string& error);
+
+  bool pngStart(std::string& error);
+  bool pngDecodeRows(const RowRanges& rows, float* depth, size_t stride, std::string& error);
+  void pngRelease();
+  static void pngRead(png_structp png, png_bytep out, png_size_t length);
+
+  float toMetres(uint16_t raw) const {
+    if (raw == 0) return 0.0f;
+    return inverse_depth_ ? depth_quant_a_ / (raw - depth_quant_b_) : raw * 0.001f;
+  }
+
+  bool rvl_ = false;
+  bool inverse_depth_ = false;
+  float depth_quant_a_ = 0.0f;
+  float depth_quant_b_ = 0.0f;
+  const uint8_t* payload_ = nullptr;
+  size_t payload_size_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+
+  // RVL: state at the start of each row reached so far
+  std::vector<RvlState> rvl_row_index_;
+
+  // PNG: rows can only be read forward, a request behind the cursor restarts the stream
+  png_structp png_ = nullptr;
+  png_infop png_info_ = nullptr;
+  size_t png_pos_ = 0;
+  int png_next_row_ = 0;
+  bool png_interlaced_ = false;
+  std::vector<uint16_t> png_row_;
+};
+
+#endif  // __COMPRESSED_DEPTH_HPP__
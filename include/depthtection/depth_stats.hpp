@@ -0,0 +1,64 @@
+/**
+ * @file depth_stats.hpp
+ * @brief Mean, variance and fill ratio of the valid depth inside a box.
+ *
+ * DepthIntegral holds summed area tables of depth, squared depth and valid pixel count over
+ * a band of rows, so a box query is four lookups per table. Each image row is added into
+ * running column sums that stay in cache, in a loop without branches that vectorizes, and
+ * the table row is their prefix sum, so the tables are only written, never zeroed or read
+ * back. depthBoxStats() scans the box instead and is cheaper when there are only a few boxes.
+ */
+
+#ifndef __DEPTH_STATS_HPP__
+#define __DEPTH_STATS_HPP__
+
+#include <cstdint>
+#include <vector>
+
+#include "depth_view.hpp"
+
+struct DepthBoxStats {
+  uint32_t valid = 0;
+  uint32_t area = 0;
+  double mean = 0.0;
+  double variance = 0.0;
+
+  double fill() const { return area ? double(valid) / area : 0.0; }
+};
+
+// Box is clipped to the image
+DepthBoxStats depthBoxStats(const DepthView& depth, PixelRect box);
+
+class DepthIntegral {
+  public:
+  // Builds the tables over rows [row_begin, row_end) of depth, reusing the buffers
+  void build(const DepthView& depth, int row_begin, int row_end);
+  void clear() { built_ = false; }
+  bool built() const { return built_; }
+  // True if the rows of box were covered by the last build
+  bool covers(const PixelRect& box) const;
+
+  DepthBoxStats stats(PixelRect box) const;
+
+  size_t bytes() const {
+    return (sum_.capacity() + sum_sq_.capacity() + col_sum_.capacity() + col_sum_sq_.capacity()) * sizeof(double) +
+           (count_.capacity() + col_count_.capacity()) * sizeof(uint32_t);
+  }
+
+  private:
+  size_t index(int row, int col) const { return size_t(row - row_begin_) * (cols_ + 1) + col; }
+
+  bool built_ = false;
+  int cols_ = 0;
+  int rows_ = 0;
+  int row_begin_ = 0;
+  int row_end_ = 0;
+  // (row_end - row_begin + 1) x (cols + 1), first row and column are zero
+  std::vector<double> sum_, sum_sq_;
+  std::vector<uint32_t> count_;
+  // per column, sums over the rows of the band reduced so far
+  std::vector<double> col_sum_, col_sum_sq_;
+  std::vector<uint32_t> col_count_;
+};
+
+#endif  // __DEPTH_STATS_HPP__
@@ -0,0 +1,43 @@
+/**
+ * @file depth_view.hpp
+ * @brief Non owning view of a float depth image and integer pixel rectangles.
+ */
+
+#ifndef __DEPTH_VIEW_HPP__
+#define __DEPTH_VIEW_HPP__
+
+#include <algorithm>
+#include <cstddef>
+
+// Row major depth in metres, 0 or non finite where invalid
+struct DepthView {
+  const float* data = nullptr;
+  int width = 0;
+  int height = 0;
+  size_t stride = 0;  // floats per row
+
+  const float* row(int v) const { return data + size_t(v) * stride; }
+  float at(int v, int u) const { return row(v)[u]; }
+  bool empty() const { return !data || width <= 0 || height <= 0; }
+};
+
+struct PixelRect {
+  int x = 0;
+  int y = 0;
+  int width = 0;
+  int height = 0;
+
+  int area() const { return width * height; }
+  bool empty() const { return width <= 0 || height <= 0; }
+
+  PixelRect clipped(int cols, int rows) const {
+    PixelRect r;
+    r.x = std::clamp(x, 0, cols);
+    r.y = std::clamp(y, 0, rows);
+    r.width = std::max(0, std::min(x + width, cols) - r.x);
+    r.height = std::max(0, std::min(y + height, rows) - r.y);
+    return r;
+  }
+};
+
+#endif  // __DEPTH_VIEW_HPP__
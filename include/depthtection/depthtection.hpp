@@ -9,6 +9,7 @@
 #define __DEPTHTECION_HPP__
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <geometry_msgs/msg/detail/pose_stamped__struct.hpp>
 #include <opencv2/calib3d/calib3d.hpp>
@@ -17,34 +18,50 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <rclcpp/logging.hpp>
+#include <mutex>
 #include <rclcpp/qos.hpp>
+#include <unordered_map>
 #include <vector>
 
 #include "as2_msgs/msg/pose_stamped_with_id.hpp"
+#include "camera_model.hpp"
 #include "candidate.hpp"
+#include "compressed_depth.hpp"
 #include "cv_bridge/cv_bridge.h"
+#include "depthtection_core.hpp"
+#include "detection_filter.hpp"
+#include "diagnostic_msgs/msg/diagnostic_array.hpp"
 #include "nav_msgs/msg/odometry.hpp"
 #include "pcl/common/common.h"
 #include "pcl_conversions/pcl_conversions.h"
 #include "pcl_ros/transforms.hpp"
+#include "point_cloud_view.hpp"
+#include "point_estimators.hpp"
+#include "priority_mutex.hpp"
 #include "rclcpp/rclcpp.hpp"
+#include "rclcpp/serialized_message.hpp"
 #include "sensor_msgs/msg/camera_info.hpp"
+#include "sensor_msgs/msg/compressed_image.hpp"
 #include "sensor_msgs/msg/fluid_pressure.hpp"
 #include "sensor_msgs/msg/image.hpp"
 #include "sensor_msgs/msg/imu.hpp"
 #include "sensor_msgs/msg/laser_scan.hpp"
+#include "serialized_image.hpp"
+#include "shm_frame_ring.hpp"
+#include "stage_metrics.hpp"
+#include "stamp_sync.hpp"
+#include "track_digest.hpp"
+#include "track_log.hpp"
 #include "tf2/LinearMath/Transform.h"
 #include "tf2/exceptions.h"
 #include "tf2_geometry_msgs/tf2_geometry_msgs.h"
 #include "tf2_msgs/msg/tf_message.hpp"
 #include "tf2_ros/buffer.h"
 #include "tf2_ros/transform_listener.h"
+#include "voxel_hash.hpp"
 #include "vision_msgs/msg/detection2_d_array.hpp"
 #include "std_msgs/msg/string.hpp"
-
-#include <message_filters/subscriber.h>
-#include <message_filters/time_synchronizer.h>
-#include <message_filters/sync_policies/approximate_time.h>
+#include "std_msgs/msg/u_int8_multi_array.hpp"
 
 class Depthtection : public rclcpp::Node {
   enum Phase {
@@ -57,8 +74,6 @@ class Depthtection : public rclcpp::Node {
 
   // Camera calibration information
   cv::Size imgSize_;
-  cv::Mat K_, D_;
-  bool haveCalibration_;
 
   // Sensor TFs
   std::string base_frame_;
@@ -70,17 +85,55 @@ class Depthtection : public rclcpp::Node {
   // flags
   bool show_detection_;
   double height_estimation_;
+  // only touched by the detection group, the other threads read their size in image_bytes_
   cv::Mat rgb_img_, depth_img_;
-  bool on_running_ = false;
+  std::atomic<size_t> image_bytes_{0};
+  std::atomic<bool> on_running_{false};
 
-  std::vector<Candidate::Ptr> candidates_;
+  // guards the track store and phase, shared by the detection, cloud and timer callbacks. The
+  // detection thread may run SCHED_FIFO, so the owner inherits its priority while it waits.
+  PriorityInheritanceMutex tracks_mutex_;
+  // depth gating, estimation and the track store, see DepthtectionCore
+  std::unique_ptr<DepthtectionCore> core_;
   Candidate::Ptr best_candidate_;
+  std::vector<BoundingBox> boxes_;
+  FrameResult frame_result_;
+  rclcpp::TimerBase::SharedPtr merge_timer_;
 
   int n_images_without_detection_ = 0;
   bool new_detection_ = false;
 
   std::string target_object_;
+
+  // cloud ROI points kept per track and fused over roi_history_window_ seconds
+  int roi_history_points_ = 4096;
+  double roi_history_window_ = 0.3;
+  int min_roi_points_ = 20;
+  std::vector<Point3f> roi_points_cloud_;
+  // fused ROI points are reduced to one per voxel of this side, 0 keeps them all
+  double roi_voxel_size_ = 0.0;
+  VoxelHash<VoxelCentroid> roi_voxels_{8192};
+  std::vector<Point3f> roi_points_voxelized_;
+
+  // cloud frames in a row without enough ROI points before the full frame scan starts, 0 never
+  int reacquisition_after_ = 10;
+  std::atomic<int> roi_misses_{0};
+  std::atomic<bool> reacquiring_{false};
+
+  // below close_range_distance_ the cloud is skipped and the track follows the nearest
+  // surface of the central depth ROI, on every depth frame, until close_range_exit_distance_
+  double close_range_distance_ = 0.2;
+  double close_range_exit_distance_ = 0.35;
+  std::atomic<bool> close_range_{false};
+  cv::Mat close_range_img_;
+
   double same_object_distance_threshold_ = 1;
+
+  // detections dropped as they arrive, frames left without any are never decoded
+  std::unique_ptr<DetectionFilter> detection_filter_;
+  std::vector<DetectionSummary> detection_summaries_;
+  std::vector<int> kept_detections_;
+  std::atomic<uint64_t> rejected_detection_frames_{0};
   // Messages
 
   vision_msgs::msg::Detection2DArray detection_msg_;
@@ -89,6 +142,10 @@ class Depthtection : public rclcpp::Node {
   geometry_msgs::msg::PoseStamped visual_detection_pose_msg_;
   geometry_msgs::msg::PoseStamped visual_depth_detection_pose_msg_;
 
+  // Callback groups
+  rclcpp::CallbackGroup::SharedPtr detection_group_;
+  rclcpp::CallbackGroup::SharedPtr cloud_group_;
+
   // Data subscribers
   // rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr rgb_img_sub_;
   // rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr depth_img_sub_;
@@ -100,14 +157,68 @@ class Depthtection : public rclcpp::Node {
 
   // Data publishers
   rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr pose_pub_;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr diagnostics_pub_;
+
+  // Pipeline metrics
+  StageMetrics metrics_;
+  std::atomic<size_t> cloud_bytes_{0};
 
-  std::shared_ptr<message_filters::Subscriber<sensor_msgs::msg::Image>> rgb_image_sub_;
-  std::shared_ptr<message_filters::Subscriber<sensor_msgs::msg::Image>> depth_img_sub_;
-  std::shared_ptr<message_filters::Subscriber<vision_msgs::msg::Detection2DArray>> detection_sub_;
+  // Track history
+  TrackLogWriter track_log_;
+
+  // Track sharing between vehicles
+  int vehicle_id_ = 0;
+  uint16_t digest_sequence_ = 0;
+  double remote_track_weight_ = 0.2;
+  double track_sharing_min_confidence_ = 0.5;
+  // remote tracks and their associations last seen longer ago are dropped
+  int64_t remote_track_timeout_ns_ = 0;
+  // reused by every publishTrackDigest, encoding keeps the capacity of the data
+  std_msgs::msg::UInt8MultiArray digest_msg_;
+  struct RemoteTrack {
+    std::weak_ptr<Candidate> candidate;
+    int64_t last_seen_ns = 0;
+  };
+  // (vehicle id << 24 | remote track id) -> local candidate
+  std::unordered_map<uint32_t, RemoteTrack> remote_tracks_;
+  rclcpp::Publisher<std_msgs::msg::UInt8MultiArray>::SharedPtr track_digest_pub_;
+  rclcpp::Subscription<std_msgs::msg::UInt8MultiArray>::SharedPtr track_digest_sub_;
+  rclcpp::TimerBase::SharedPtr track_sharing_timer_;
 
-  // typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::msg::Image, sensor_msgs::msg::Image, vision_msgs::msg::Detection2DArray> sync_policy;
-  typedef message_filters::sync_policies::ExactTime<sensor_msgs::msg::Image, sensor_msgs::msg::Image, vision_msgs::msg::Detection2DArray> sync_policy;
-  std::shared_ptr<message_filters::Synchronizer<sync_policy>> synchronizer_;
+  // Shared memory frame input from a co-located camera process
+  std::string shm_input_;
+  ShmFrameRing shm_ring_;
+  rclcpp::TimerBase::SharedPtr shm_timer_;
+  std::atomic<uint64_t> shm_dropped_frames_{0};
+  std::atomic<uint64_t> shm_torn_frames_{0};
+  rclcpp::TimerBase::SharedPtr metrics_timer_;
+
+  // rgb, depth and detections are matched by stamp, the rgb only when it is drawn
+  rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr rgb_image_sub_;
+  rclcpp::Subscription<vision_msgs::msg::Detection2DArray>::SharedPtr detection_sub_;
+  rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr depth_img_sub_;
+  typedef StampSync<sensor_msgs::msg::Image, sensor_msgs::msg::Image, vision_msgs::msg::Detection2DArray> ImageSync;
+  std::unique_ptr<ImageSync> image_sync_;
+  // counters of the synchronizer of the depth transport in use
+  const StampSyncStats* sync_stats_ = nullptr;
+
+  // compressedDepth input, only the rows used by the detections and the track are decoded
+  rclcpp::Subscription<sensor_msgs::msg::CompressedImage>::SharedPtr compressed_depth_sub_;
+  typedef StampSync<sensor_msgs::msg::Image, sensor_msgs::msg::CompressedImage, vision_msgs::msg::Detection2DArray>
+      CompressedSync;
+  std::unique_ptr<CompressedSync> compressed_sync_;
+  CompressedDepthDecoder depth_decoder_;
+
+  // serialized raw depth, the pixels are read in place from the middleware buffer
+  rclcpp::Subscription<sensor_msgs::msg::Image>::SharedPtr serialized_depth_sub_;
+  typedef StampSync<sensor_msgs::msg::Image, rclcpp::SerializedMessage, vision_msgs::msg::Detection2DArray>
+      SerializedSync;
+  std::unique_ptr<SerializedSync> serialized_sync_;
+  SerializedDepthImage serialized_depth_;
+
+  // depth image of the compressed and serialized inputs, only decoded_rows_ are valid
+  cv::Mat roi_depth_img_;
+  RowRanges decoded_rows_;
 
 
   // Methods
@@ -116,9 +227,23 @@ class Depthtection : public rclcpp::Node {
   Depthtection();
   ~Depthtection(void);
 
+  // Not added automatically to executors, see depthtection_node.cpp
+  rclcpp::CallbackGroup::SharedPtr detectionCallbackGroup() const { return detection_group_; }
+  rclcpp::CallbackGroup::SharedPtr cloudCallbackGroup() const { return cloud_group_; }
+
   private:
+  static geometry_msgs::msg::PoseStamped poseOf(const TrackPoint& point) {
+    geometry_msgs::msg::PoseStamped pose;
+    pose.header.frame_id = "earth";
+    pose.header.stamp = rclcpp::Time(std::llround(point.stamp * 1e9));
+    pose.pose.position.x = point.position.x();
+    pose.pose.position.y = point.position.y();
+    pose.pose.position.z = point.position.z();
+    return pose;
+  }
+
   void pubCandidate(Candidate::Ptr candidate) {
-    pose_pub_->publish(*candidate);
+    pose_pub_->publish(poseOf(candidate->point));
     if (has_ground_truth_) {
       Eigen::Vector3d gt_point(ground_truth_pose_msg_.pose.position.x,
                                ground_truth_pose_msg_.pose.position.y,
@@ -129,37 +254,48 @@ class Depthtection : public rclcpp::Node {
       RCLCPP_INFO(get_logger(), "Distance to ground truth: %f", distance.norm());
     }
     static auto filtered_pub_ = this->create_publisher<geometry_msgs::msg::PoseStamped>("filtered_pose", 10);
-    static auto filtered_pose_msg_ = std::make_shared<geometry_msgs::msg::PoseStamped>();
-    filtered_pose_msg_->header = candidate->filtered_point.header;
-    filtered_pose_msg_->pose.position = candidate->filtered_point.point;
-    filtered_pub_->publish(*filtered_pose_msg_);
+    filtered_pub_->publish(poseOf(candidate->filtered_point));
 
     static auto raw_pub_ = this->create_publisher<geometry_msgs::msg::PoseStamped>("raw_pose", 10);
-    static auto raw_pose_msg_ = std::make_shared<geometry_msgs::msg::PoseStamped>();
-    raw_pose_msg_->header = candidate->raw_point.header;
-    raw_pose_msg_->pose.position = candidate->raw_point.point;
-    raw_pub_->publish(*raw_pose_msg_);
+    raw_pub_->publish(poseOf(candidate->raw_point));
 
     static auto compensated_pub_ = this->create_publisher<geometry_msgs::msg::PoseStamped>("compensated_pose", 10);
-    static auto compensated_pose_msg_ = std::make_shared<geometry_msgs::msg::PoseStamped>();
-    compensated_pose_msg_->header = candidate->compensated_point.header;
-    compensated_pose_msg_->pose.position = candidate->compensated_point.point;
-    compensated_pub_->publish(*compensated_pose_msg_);
+    compensated_pub_->publish(poseOf(candidate->compensated_point));
   }
 
-  geometry_msgs::msg::PointStamped extractEstimatedPoint(const cv::Mat& depth_img,
-                                                         const vision_msgs::msg::Detection2D& msg);
   bool updateCandidateFromPointCloud(const Candidate::Ptr& candidate,
-                                     const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud);
+                                     const std::vector<Point3f>& points,
+                                     const Eigen::Vector3f& sensor,
+                                     const builtin_interfaces::msg::Time& stamp);
   // Subscribers callbacks
   void rgbImageCallback(const sensor_msgs::msg::Image::SharedPtr msg);
   void depthImageCallback(const sensor_msgs::msg::Image::SharedPtr msg);
   void cameraInfoCallback(const sensor_msgs::msg::CameraInfo::SharedPtr msg);
   void detectionCallback(const vision_msgs::msg::Detection2DArray::SharedPtr msg);
   void pointCloudCallback(const sensor_msgs::msg::PointCloud2::SharedPtr msg);
+  void serializedPointCloudCallback(const std::shared_ptr<rclcpp::SerializedMessage> msg);
+  void processPointCloud(const PointCloudView& cloud, const std_msgs::msg::Header& header);
+  void roiMissed();
+  bool opticalToEarth(const std::string& frame_id, Eigen::Isometry3d& optical_to_earth);
+  bool tooNear(const Eigen::Vector3d& target);
+  // Called with tracks_mutex_ held
+  void enterCloseRange();
+  void closeRangeFrame(const DepthView& depth, const std_msgs::msg::Header& header);
+  void closeRangeDepthCallback(const sensor_msgs::msg::Image::ConstSharedPtr& msg);
+  void closeRangeCompressedCallback(const sensor_msgs::msg::CompressedImage::ConstSharedPtr& msg);
+  void rawDepthCallback(const sensor_msgs::msg::Image::SharedPtr msg);
+  void compressedDepthCallback(const sensor_msgs::msg::CompressedImage::SharedPtr msg);
+  void syncedDetectionCallback(const vision_msgs::msg::Detection2DArray::SharedPtr msg);
+  // Drops the filtered detections from msg, false when the frame is not worth processing
+  bool prefilterDetections(vision_msgs::msg::Detection2DArray& msg);
+  void syncedRgbCallback(const sensor_msgs::msg::Image::SharedPtr msg);
+  template <typename Decoder>
+  bool decodeCloseRangeRows(Decoder& decoder, std::string& error);
+  // Guarded by tracks_mutex_, read by pubCandidate()
   bool has_ground_truth_ = false;
   geometry_msgs::msg::PoseStamped ground_truth_pose_msg_;
   void groundTruthCallback(const geometry_msgs::msg::PoseStamped::SharedPtr msg) {
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
     has_ground_truth_ = true;
     ground_truth_pose_msg_ = *msg;
   };
@@ -167,6 +303,31 @@ class Depthtection : public rclcpp::Node {
 
   void phaseCallback(const std::shared_ptr<std_msgs::msg::String> msg);
 
+  void logTrack(const Candidate& candidate, TrackSource source);
+  void mergeCandidates();
+  void shmPollCallback();
+  void tornShmFrame();
+  void publishTrackDigest();
+  void trackDigestCallback(const std_msgs::msg::UInt8MultiArray::SharedPtr msg);
+  void fuseRemoteTrack(uint8_t vehicle_id, const TrackDigestEntry& track, int64_t stamp_ns, int64_t received_ns);
+  // Called with tracks_mutex_ held
+  void expireRemoteTracks(int64_t now_ns);
+  void updateFootprint();
+  void publishImageBytes();
+  void publishMetrics();
+
+  void imagesAndCompressedDetectionCallback(const sensor_msgs::msg::Image::SharedPtr img_ptr,
+                                            const sensor_msgs::msg::CompressedImage::SharedPtr depth_ptr,
+                                            const vision_msgs::msg::Detection2DArray::SharedPtr detection);
+  bool decodeCompressedDepth(const sensor_msgs::msg::CompressedImage& msg,
+                             const vision_msgs::msg::Detection2DArray& detections);
+  void serializedDepthCallback(const std::shared_ptr<rclcpp::SerializedMessage> msg);
+  void processSerializedDepth(const sensor_msgs::msg::Image::SharedPtr img_ptr,
+                              const std::shared_ptr<rclcpp::SerializedMessage>& depth,
+                              const vision_msgs::msg::Detection2DArray::SharedPtr detection);
+  void prepareRoiDepth(int rows, int cols, const vision_msgs::msg::Detection2DArray& detections);
+  RowRanges depthRowsOfInterest(const vision_msgs::msg::Detection2DArray& detections, int n_rows);
+
   void imagesAndDetectionCallback(const sensor_msgs::msg::Image::SharedPtr img_ptr, const sensor_msgs::msg::Image::SharedPtr depth_ptr, const vision_msgs::msg::Detection2DArray::SharedPtr detection);
 };
 
@@ -0,0 +1,204 @@
+/**
+ * @file depthtection_core.hpp
+ * @brief ROS free detection pipeline: bbox depth gating, back-projection, 3D estimation,
+ * association and tracking.
+ *
+ * Inputs are plain depth views, boxes, transforms and stamps in seconds, so a detector can
+ * run it in process on its own frames. The depthtection node only converts messages and TF
+ * into these calls. Not thread safe, callers serialize the access.
+ */
+
+#ifndef __DEPTHTECTION_CORE_HPP__
+#define __DEPTHTECTION_CORE_HPP__
+
+#include <Eigen/Geometry>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "association.hpp"
+#include "camera_model.hpp"
+#include "candidate.hpp"
+#include "close_range.hpp"
+#include "depth_stats.hpp"
+#include "depth_view.hpp"
+#include "point_estimators.hpp"
+#include "reacquisition.hpp"
+#include "track_table.hpp"
+
+struct BoundingBox {
+  std::string class_id;
+  float score = 0.0f;
+  double center_x = 0.0;
+  double center_y = 0.0;
+  double size_x = 0.0;
+  double size_y = 0.0;
+
+  // Pixels covered by the box, rounded outwards
+  PixelRect rect() const;
+};
+
+struct CoreParams {
+  // association gate and default merge radius
+  double same_object_distance = 1.0;
+  // measurements or tracks of a cluster assigned exactly, larger clusters are greedy
+  int association_max_component = 32;
+  EstimatorParams estimator_params;
+  // bbox depth statistics, through integral images once a frame has this many boxes
+  int depth_stats_min_detections = 4;
+  double min_depth_fill = 0.05;
+  double min_depth = 0.1;
+  double max_depth = 50.0;
+  double max_depth_std = 0.0;  // 0 disables the spread test
+  ReacquisitionParams reacquisition;
+  CloseRangeParams close_range;
+};
+
+enum class BoxOutcome : uint8_t {
+  NEW_TRACK,
+  UPDATED_TRACK,
+  NO_DEPTH,
+  REJECTED_LOW_FILL,
+  REJECTED_DEPTH_RANGE,
+  REJECTED_DEPTH_SPREAD,
+};
+
+struct FrameResult {
+  std::vector<BoxOutcome> outcomes;  // one per box
+  std::vector<int> track_ids;        // one per box, -1 when rejected
+  Candidate::Vec created;
+  Candidate::Vec updated;
+
+  void clear() {
+    outcomes.clear();
+    track_ids.clear();
+    created.clear();
+    updated.clear();
+  }
+};
+
+class DepthtectionCore {
+  public:
+  // back-projected pixels per box, larger boxes are subsampled
+  static constexpr int MAX_ROI_SAMPLES = 1024;
+
+  explicit DepthtectionCore(const CoreParams& params = CoreParams());
+
+  const CoreParams& params() const { return params_; }
+
+  // Estimator by name for one class, or the default one when class_id is empty. False if the
+  // name is unknown.
+  bool setEstimator(std::string_view name, const std::string& class_id = "");
+  int estimatorFor(const std::string& class_id) const;
+
+  // k is the row major 3x3 intrinsic matrix, see makeCameraModel. error is set when the
+  // distortion was ignored, the camera is usable anyway.
+  void setCamera(const std::string& distortion_model, const double* k, const std::vector<double>& d, int width,
+                 int height, std::string& error);
+  void setCamera(CameraModel camera) {
+    camera_ = std::move(camera);
+    has_camera_ = true;
+  }
+  bool hasCamera() const { return has_camera_; }
+  const CameraModel& camera() const { return camera_; }
+
+  // Merging of same class tracks closer than radius, see CandidateMerger
+  void setMerger(double radius, size_t max_checks);
+
+  // Whole detection path for one frame. optical_to_earth maps the optical frame of the camera
+  // (z forward, y down) into the tracking frame. Tracks are predicted to stamp, every box
+  // passing the depth gate is estimated, the estimates are assigned to the tracks together,
+  // see Associator, then all measurements are committed.
+  void processFrame(const DepthView& depth, const std::vector<BoundingBox>& boxes,
+                    const Eigen::Isometry3d& optical_to_earth, double stamp, FrameResult& result);
+
+  // Depth statistics gate of box, boxes is the whole frame. Counts the rejections.
+  bool acceptDepthBox(const DepthView& depth, const std::vector<BoundingBox>& boxes, const BoundingBox& box,
+                      BoxOutcome& rejection);
+
+  // Estimated position of box in the optical frame, from the inner half of the box or the
+  // centre pixel when none of it has depth. False when there is no depth at all.
+  bool estimateBox(const DepthView& depth, const BoundingBox& box, const EstimatorFrame& frame,
+                   Eigen::Vector3f& out);
+
+  // Estimates from points around the track, in the tracking frame, and applies it as a
+  // measurement of the track at stamp.
+  bool updateFromPoints(const Candidate::Ptr& candidate, const std::vector<Point3f>& points,
+                        const Eigen::Vector3f& sensor, double stamp);
+
+  // Searches the whole frame for a lost track, see ReacquisitionScan. On a match the track is
+  // moved there at once instead of filtered towards it, so the ROI around it finds the target.
+  bool reacquire(const DepthView& depth, const Eigen::Isometry3d& optical_to_earth, const Candidate::Ptr& candidate,
+                 double stamp);
+
+  // Measures the track from the central depth ROI alone, for targets too close for the
+  // cloud. range is the distance to the surface when it returns true.
+  bool closeRangeUpdate(const DepthView& depth, const Eigen::Isometry3d& optical_to_earth,
+                        const Candidate::Ptr& candidate, double stamp, double& range);
+  // True after too many frames in a row without a usable ROI
+  bool closeRangeLost() const { return close_range_.lost(params_.close_range); }
+  void resetCloseRange() { close_range_.reset(); }
+
+  Candidate::Ptr match(std::string_view class_id, const Eigen::Vector3d& position) const {
+    return match_candidate(candidates_, class_id, position, params_.same_object_distance);
+  }
+  Candidate::Ptr addTrack(float confidence, std::string_view class_id, const TrackPoint& point);
+  // Returns the merges done, best is remapped if it was merged away
+  int merge(Candidate::Ptr& best);
+  // Drops a track from the store, it is left marked as merged
+  void removeTrack(const Candidate::Ptr& candidate);
+
+  Candidate::Vec& tracks() { return candidates_; }
+  const Candidate::Vec& tracks() const { return candidates_; }
+  TrackTable& table() { return *table_; }
+
+  uint64_t rejectedLowFill() const { return rejected_low_fill_; }
+  uint64_t rejectedDepthRange() const { return rejected_depth_range_; }
+  uint64_t rejectedDepthSpread() const { return rejected_depth_spread_; }
+  uint64_t reacquisitions() const { return reacquisitions_; }
+  // Largest measurement or track count of an association cluster so far, and the clusters
+  // too large to be solved exactly
+  uint64_t maxAssociationComponent() const { return max_association_component_; }
+  uint64_t greedyAssociations() const { return greedy_associations_; }
+
+  // Heap held by the track store, not counting the ROI histories
+  size_t trackBytes() const;
+
+  private:
+  CoreParams params_;
+  int default_estimator_;
+  std::unordered_map<std::string, int> class_estimators_;
+
+  CameraModel camera_;
+  bool has_camera_ = false;
+
+  std::shared_ptr<TrackTable> table_ = std::make_shared<TrackTable>();
+  Candidate::Vec candidates_;
+  int next_id_ = 1;
+  std::unique_ptr<CandidateMerger> merger_;
+
+  DepthIntegral depth_integral_;
+  std::vector<Point3f> roi_points_;
+  // boxes of the frame with an estimate, and their association inputs
+  std::vector<size_t> measured_boxes_;
+  std::vector<float> measured_extents_;
+  std::vector<Eigen::Vector3d> measurements_, track_positions_;
+  std::vector<int> measurement_classes_, track_classes_, assignment_;
+  std::vector<std::string_view> frame_classes_;
+  Associator associator_;
+  ReacquisitionScan reacquisition_;
+  CloseRangeEstimator close_range_;
+  std::atomic<uint64_t> rejected_low_fill_{0};
+  std::atomic<uint64_t> rejected_depth_range_{0};
+  std::atomic<uint64_t> rejected_depth_spread_{0};
+  std::atomic<uint64_t> reacquisitions_{0};
+  std::atomic<uint64_t> max_association_component_{0};
+  std::atomic<uint64_t> greedy_associations_{0};
+};
+
+#endif  // __DEPTHTECTION_CORE_HPP__
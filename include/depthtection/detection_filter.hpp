@@ -0,0 +1,74 @@
+/**
+ * @file detection_filter.hpp
+ * @brief Prefilter of the detector output, applied when a detection array arrives.
+ *
+ * Detections below the score threshold, of a class outside the allowlist or with a box
+ * outside the size limits are dropped, and of the rest only the max_detections best scores
+ * are kept. Every drop is counted by reason. A frame left without detections never reaches
+ * the depth decoding.
+ */
+
+#ifndef __DETECTION_FILTER_HPP__
+#define __DETECTION_FILTER_HPP__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct DetectionFilterParams {
+  float min_score = 0.0f;
+  // accepted classes, every class when empty
+  std::vector<std::string> classes;
+  double min_size = 0.0;   // pixels, of the shorter box side
+  double max_size = 0.0;   // pixels, of the longer box side, 0 without limit
+  int max_detections = 0;  // per frame, 0 without limit
+};
+
+enum class DetectionRejection {
+  NO_HYPOTHESIS,
+  LOW_SCORE,
+  CLASS,
+  TOO_SMALL,
+  TOO_LARGE,
+  OVER_LIMIT,
+  N_REJECTIONS
+};
+
+inline const char* detectionRejectionName(DetectionRejection rejection) {
+  static const char* names[] = {"no_hypothesis", "low_score", "class", "too_small", "too_large", "over_limit"};
+  return names[static_cast<int>(rejection)];
+}
+
+// The fields of one detection the filter looks at, class_id only valid with has_hypothesis
+struct DetectionSummary {
+  bool has_hypothesis = false;
+  std::string_view class_id;
+  float score = 0.0f;
+  double size_x = 0.0;
+  double size_y = 0.0;
+};
+
+class DetectionFilter {
+  public:
+  static constexpr int N = static_cast<int>(DetectionRejection::N_REJECTIONS);
+
+  explicit DetectionFilter(const DetectionFilterParams& params = DetectionFilterParams()) : params_(params) {}
+
+  const DetectionFilterParams& params() const { return params_; }
+
+  // Indices of the kept detections, in input order
+  void select(const std::vector<DetectionSummary>& detections, std::vector<int>& kept);
+
+  uint64_t rejected(DetectionRejection rejection) const { return rejected_[static_cast<int>(rejection)]; }
+
+  private:
+  bool accept(const DetectionSummary& detection);
+
+  DetectionFilterParams params_;
+  std::array<std::atomic<uint64_t>, N> rejected_{};
+};
+
+#endif  // __DETECTION_FILTER_HPP__
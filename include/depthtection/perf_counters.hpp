@@ -0,0 +1,50 @@
+/**
+ * @file perf_counters.hpp
+ * @brief Hardware performance counters of the calling thread through perf_event_open.
+ */
+
+#ifndef __PERF_COUNTERS_HPP__
+#define __PERF_COUNTERS_HPP__
+
+#include <cstdint>
+
+struct PerfSample {
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t l1d_misses = 0;
+  uint64_t llc_misses = 0;
+  uint64_t branch_misses = 0;
+
+  PerfSample operator-(const PerfSample& other) const {
+    PerfSample diff;
+    diff.cycles = cycles - other.cycles;
+    diff.instructions = instructions - other.instructions;
+    diff.l1d_misses = l1d_misses - other.l1d_misses;
+    diff.llc_misses = llc_misses - other.llc_misses;
+    diff.branch_misses = branch_misses - other.branch_misses;
+    return diff;
+  }
+};
+
+// Counter group bound to the thread that opened it. Counters run freely once opened, a stage
+// is measured as the difference between two reads.
+class PerfCounters {
+  public:
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  // False when the kernel refused the group (e.g. perf_event_paranoid too strict).
+  bool valid() const { return fds_[0] >= 0; }
+  bool read(PerfSample& sample) const;
+
+  // Counters of the calling thread, opened on first use.
+  static PerfCounters& forThisThread();
+
+  private:
+  static constexpr int N_COUNTERS = 5;
+  int fds_[N_COUNTERS];
+};
+
+#endif  // __PERF_COUNTERS_HPP__
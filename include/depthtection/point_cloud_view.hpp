@@ -0,0 +1,72 @@
+/**
+ * @file point_cloud_view.hpp
+ * @brief Zero copy access to the xyz fields of a PointCloud2 payload, and the ROI filter
+ * that reads through it.
+ *
+ * The view can point into a deserialized message or straight into its serialized CDR
+ * buffer, only the points that pass the filter are copied out.
+ */
+
+#ifndef __POINT_CLOUD_VIEW_HPP__
+#define __POINT_CLOUD_VIEW_HPP__
+
+#include <Eigen/Geometry>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// sensor_msgs/PointField datatype of the xyz fields
+constexpr uint8_t POINT_FIELD_FLOAT32 = 7;
+
+struct PointCloudView {
+  const uint8_t* data = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t point_step = 0;
+  uint32_t row_step = 0;
+  uint32_t offset[3] = {0, 0, 0};  // x, y, z
+  int64_t stamp_ns = 0;
+  std::string frame_id;
+
+  size_t size() const { return size_t(width) * height; }
+};
+
+// Checks the layout once fields offsets, point_step, row_step, width and height are set
+bool validatePointCloudView(const PointCloudView& view, size_t data_size, std::string& error);
+
+// Parses a CDR little endian serialized sensor_msgs/PointCloud2. The buffer must outlive
+// the view.
+bool parseSerializedPointCloud(const uint8_t* buffer, size_t size, PointCloudView& view, std::string& error);
+
+// Appends to out, in the target frame, the points within radius of center. The distance
+// test is done in the cloud frame so only the kept points are transformed. NaN points
+// never pass it.
+template <typename PointT, typename Alloc>
+void filterPointCloudSphere(const PointCloudView& cloud, const Eigen::Affine3f& to_target,
+                            const Eigen::Vector3f& center, float radius, std::vector<PointT, Alloc>& out) {
+  const Eigen::Vector3f local_center = to_target.inverse() * center;
+  const float radius_sq = radius * radius;
+  for (uint32_t v = 0; v < cloud.height; v++) {
+    const uint8_t* row = cloud.data + size_t(v) * cloud.row_step;
+    for (uint32_t u = 0; u < cloud.width; u++) {
+      const uint8_t* point = row + size_t(u) * cloud.point_step;
+      Eigen::Vector3f p;
+      std::memcpy(&p.x(), point + cloud.offset[0], sizeof(float));
+      std::memcpy(&p.y(), point + cloud.offset[1], sizeof(float));
+      std::memcpy(&p.z(), point + cloud.offset[2], sizeof(float));
+      if (!((p - local_center).squaredNorm() <= radius_sq)) {
+        continue;
+      }
+      p = to_target * p;
+      PointT kept;
+      kept.x = p.x();
+      kept.y = p.y();
+      kept.z = p.z();
+      out.push_back(kept);
+    }
+  }
+}
+
+#endif  // __POINT_CLOUD_VIEW_HPP__
@@ -0,0 +1,286 @@
+/**
+ * @file point_estimators.hpp
+ * @brief 3D position estimators over the points of a target, as compile-time policies.
+ *
+ * Every policy exposes a name and a static estimate() templated on the point type (anything
+ * with x, y, z members, e.g. pcl::PointXYZ), so the inner loops are inlined for each input.
+ * EstimatorSet picks the policy by index once per call, never per point.
+ */
+
+#ifndef __POINT_ESTIMATORS_HPP__
+#define __POINT_ESTIMATORS_HPP__
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "voxel_hash.hpp"
+
+struct Point3f {
+  float x, y, z;
+};
+
+// Frame the points are expressed in
+struct EstimatorFrame {
+  Eigen::Vector3f up = Eigen::Vector3f::UnitZ();
+  Eigen::Vector3f sensor = Eigen::Vector3f::Zero();
+};
+
+struct EstimatorParams {
+  float slab_thickness = 0.1f;   // top_slab, plane_top
+  float depth_band = 0.05f;      // median_depth
+  float mode_bin = 0.05f;        // nearest_mode
+  float mode_min_fraction = 0.3f;
+  float cluster_radius = 0.05f;  // cluster_centroid
+};
+
+// Values the estimators divide by or search with, false and the reason when one is out of range
+inline bool validEstimatorParams(const EstimatorParams& params, std::string& error) {
+  if (!(params.mode_bin > 0.0f)) {
+    error = "mode_bin must be positive";
+  } else if (!(params.mode_min_fraction > 0.0f && params.mode_min_fraction <= 1.0f)) {
+    error = "mode_min_fraction must be in (0, 1]";
+  } else if (!(params.cluster_radius > 0.0f)) {
+    error = "cluster_radius must be positive";
+  } else {
+    return true;
+  }
+  return false;
+}
+
+template <typename PointT>
+inline Eigen::Vector3f toEigen(const PointT& p) {
+  return Eigen::Vector3f(p.x, p.y, p.z);
+}
+
+// Centroid of the points within slab_thickness of the highest one
+struct TopSlabEstimator {
+  static constexpr std::string_view name = "top_slab";
+
+  template <typename PointT>
+  static bool estimate(const PointT* points, size_t n, const EstimatorFrame& frame, const EstimatorParams& params,
+                       Eigen::Vector3f& out) {
+    if (!n) return false;
+    float max_h = -std::numeric_limits<float>::max();
+    for (size_t i = 0; i < n; i++) max_h = std::max(max_h, frame.up.dot(toEigen(points[i])));
+    Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+      const Eigen::Vector3f p = toEigen(points[i]);
+      if (frame.up.dot(p) >= max_h - params.slab_thickness) {
+        sum += p;
+        count++;
+      }
+    }
+    out = sum / count;
+    return true;
+  }
+};
+
+// Centroid of the points whose range is within depth_band of the median range
+struct MedianDepthEstimator {
+  static constexpr std::string_view name = "median_depth";
+
+  template <typename PointT>
+  static bool estimate(const PointT* points, size_t n, const EstimatorFrame& frame, const EstimatorParams& params,
+                       Eigen::Vector3f& out) {
+    if (!n) return false;
+    thread_local std::vector<float> ranges, sorted;
+    ranges.resize(n);
+    for (size_t i = 0; i < n; i++) ranges[i] = (toEigen(points[i]) - frame.sensor).norm();
+    sorted.assign(ranges.begin(), ranges.end());
+    std::nth_element(sorted.begin(), sorted.begin() + n / 2, sorted.end());
+    const float median = sorted[n / 2];
+    Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (std::abs(ranges[i] - median) <= params.depth_band) {
+        sum += toEigen(points[i]);
+        count++;
+      }
+    }
+    out = sum / count;
+    return true;
+  }
+};
+
+// Centroid of the nearest range histogram bin holding at least mode_min_fraction of the
+// fullest one: the closest well supported surface, robust to a few stray near points
+struct NearestModeEstimator {
+  static constexpr std::string_view name = "nearest_mode";
+  static constexpr int N_BINS = 256;
+
+  template <typename PointT>
+  static bool estimate(const PointT* points, size_t n, const EstimatorFrame& frame, const EstimatorParams& params,
+                       Eigen::Vector3f& out) {
+    if (!n) return false;
+    float min_range = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < n; i++) min_range = std::min(min_range, (toEigen(points[i]) - frame.sensor).norm());
+    uint32_t histogram[N_BINS] = {0};
+    const auto bin_of = [&](const Eigen::Vector3f& p) {
+      return std::min<int>(((p - frame.sensor).norm() - min_range) / params.mode_bin, N_BINS - 1);
+    };
+    for (size_t i = 0; i < n; i++) histogram[bin_of(toEigen(points[i]))]++;
+    const uint32_t max_count = *std::max_element(histogram, histogram + N_BINS);
+    int mode = 0;
+    while (mode < N_BINS - 1 && histogram[mode] < params.mode_min_fraction * max_count) mode++;
+    Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+      const Eigen::Vector3f p = toEigen(points[i]);
+      if (bin_of(p) == mode) {
+        sum += p;
+        count++;
+      }
+    }
+    out = sum / count;
+    return true;
+  }
+};
+
+// Centroid of the largest cluster of voxels of side cluster_radius connected by their 26
+// neighbours, rejects background fragments that entered the ROI
+struct ClusterCentroidEstimator {
+  static constexpr std::string_view name = "cluster_centroid";
+  // points falling in voxels past the ceiling are ignored
+  static constexpr size_t MAX_VOXELS = 1 << 15;
+
+  template <typename PointT>
+  static bool estimate(const PointT* points, size_t n, const EstimatorFrame&, const EstimatorParams& params,
+                       Eigen::Vector3f& out) {
+    if (!n) return false;
+    struct Voxel {
+      Eigen::Vector3f sum;
+      uint32_t count;
+      uint32_t parent;
+    };
+    thread_local std::vector<Voxel> voxels;
+    thread_local VoxelHash<uint32_t> index(MAX_VOXELS);
+    voxels.clear();
+    index.clear();
+    const float inv = 1.0f / params.cluster_radius;
+    for (size_t i = 0; i < n; i++) {
+      const Eigen::Vector3f p = toEigen(points[i]);
+      uint32_t* v = index.findOrInsert(voxelKey(p.x(), p.y(), p.z(), inv));
+      if (!v) continue;
+      if (index.size() > voxels.size()) {
+        *v = voxels.size();
+        voxels.push_back({Eigen::Vector3f::Zero(), 0, *v});
+      }
+      voxels[*v].sum += p;
+      voxels[*v].count++;
+    }
+    if (voxels.empty()) return false;
+
+    const auto find = [](uint32_t v) {
+      while (voxels[v].parent != v) v = voxels[v].parent = voxels[voxels[v].parent].parent;
+      return v;
+    };
+    index.forEach([&](uint64_t key, uint32_t v) {
+      for (int dx = -1; dx <= 1; dx++)
+        for (int dy = -1; dy <= 1; dy++)
+          for (int dz = -1; dz <= 1; dz++) {
+            const uint32_t* neighbour = index.find(voxelNeighbour(key, dx, dy, dz));
+            if (neighbour) voxels[find(*neighbour)].parent = find(v);
+          }
+    });
+
+    thread_local std::vector<std::pair<Eigen::Vector3f, uint32_t>> clusters;
+    clusters.assign(voxels.size(), {Eigen::Vector3f::Zero(), 0});
+    uint32_t best = 0;
+    for (uint32_t v = 0; v < voxels.size(); v++) {
+      auto& cluster = clusters[find(v)];
+      cluster.first += voxels[v].sum;
+      cluster.second += voxels[v].count;
+      if (cluster.second > clusters[best].second) best = find(v);
+    }
+    out = clusters[best].first / clusters[best].second;
+    return true;
+  }
+};
+
+// Least squares plane through the top slab, evaluated above the centre of the footprint of
+// all the points. Slab points on one side of a sloped or partly seen top no longer pull the
+// estimate towards that side, as the slab centroid does.
+struct PlaneTopEstimator {
+  static constexpr std::string_view name = "plane_top";
+
+  template <typename PointT>
+  static bool estimate(const PointT* points, size_t n, const EstimatorFrame& frame, const EstimatorParams& params,
+                       Eigen::Vector3f& out) {
+    Eigen::Vector3f centroid;
+    if (!TopSlabEstimator::estimate(points, n, frame, params, centroid)) return false;
+    // h = a u + b v + c in a basis orthogonal to up, centred on the slab centroid
+    const Eigen::Vector3f u = frame.up.unitOrthogonal();
+    const Eigen::Vector3f v = frame.up.cross(u);
+    const float top = frame.up.dot(centroid);
+    Eigen::Matrix3f A = Eigen::Matrix3f::Zero();
+    Eigen::Vector3f b = Eigen::Vector3f::Zero();
+    Eigen::Vector3f footprint = Eigen::Vector3f::Zero();
+    float max_h = -std::numeric_limits<float>::max();
+    for (size_t i = 0; i < n; i++) {
+      const Eigen::Vector3f p = toEigen(points[i]);
+      max_h = std::max(max_h, frame.up.dot(p));
+      footprint += p;
+    }
+    for (size_t i = 0; i < n; i++) {
+      const Eigen::Vector3f p = toEigen(points[i]) - centroid;
+      const float h = frame.up.dot(p);
+      if (h + top < max_h - params.slab_thickness) continue;
+      const Eigen::Vector3f row(u.dot(p), v.dot(p), 1.0f);
+      A += row * row.transpose();
+      b += row * h;
+    }
+    const Eigen::LDLT<Eigen::Matrix3f> ldlt(A);
+    const Eigen::Vector3f plane = ldlt.solve(b);
+    // a slab along a line or a single point leaves the slope undetermined
+    const Eigen::Vector3f pivots = ldlt.vectorD().cwiseAbs();
+    if (!plane.allFinite() || pivots.minCoeff() <= 1e-6f * pivots.maxCoeff()) {
+      out = centroid;
+      return true;
+    }
+    const Eigen::Vector3f d = footprint / n - centroid;
+    const float du = u.dot(d), dv = v.dot(d);
+    out = centroid + u * du + v * dv + frame.up * (plane.x() * du + plane.y() * dv + plane.z());
+    return true;
+  }
+};
+
+template <typename... Policies>
+struct EstimatorSet {
+  static constexpr int size = sizeof...(Policies);
+
+  static int index(std::string_view name) {
+    int i = 0, found = -1;
+    ((Policies::name == name ? found = i : 0, i++), ...);
+    return found;
+  }
+
+  static std::string_view name(int index) {
+    std::string_view found;
+    int i = 0;
+    ((i++ == index ? found = Policies::name : found), ...);
+    return found;
+  }
+
+  template <typename PointT>
+  static bool estimate(int index, const PointT* points, size_t n, const EstimatorFrame& frame,
+                       const EstimatorParams& params, Eigen::Vector3f& out) {
+    bool ok = false;
+    int i = 0;
+    ((i++ == index && (ok = Policies::template estimate<PointT>(points, n, frame, params, out), true)) || ...);
+    return ok;
+  }
+};
+
+typedef EstimatorSet<TopSlabEstimator, MedianDepthEstimator, NearestModeEstimator, ClusterCentroidEstimator,
+                     PlaneTopEstimator>
+    PointEstimators;
+
+#endif  // __POINT_ESTIMATORS_HPP__
@@ -0,0 +1,79 @@
+/**
+ * @file point_history.hpp
+ * @brief Fixed capacity ring of the recent earth frame ROI points of a track.
+ *
+ * Points are stored per frame with its stamp. Once full, the oldest points are overwritten,
+ * nothing is allocated after construction. Being in the earth frame the points are already
+ * free of the ego motion. gather() also shifts each frame by the track velocity times its
+ * age so a moving target does not smear.
+ */
+
+#ifndef __POINT_HISTORY_HPP__
+#define __POINT_HISTORY_HPP__
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "point_estimators.hpp"
+
+class PointHistory {
+  public:
+  PointHistory(size_t capacity, size_t max_frames = 64) : points_(capacity), frames_(max_frames) {}
+
+  // Appends one frame. If it holds more points than the capacity only the last ones are kept.
+  template <typename PointT>
+  void push(const PointT* points, size_t n, double stamp) {
+    const size_t capacity = points_.size();
+    if (!capacity) return;
+    if (n > capacity) {
+      points += n - capacity;
+      n = capacity;
+    }
+    for (size_t i = 0; i < n; i++) {
+      points_[(head_ + i) % capacity] = {points[i].x, points[i].y, points[i].z};
+    }
+    frames_[next_frame_ % frames_.size()] = {head_, static_cast<uint32_t>(n), stamp};
+    next_frame_++;
+    head_ += n;
+  }
+
+  // Replaces out with the points of the frames at most window seconds older than stamp,
+  // moved to stamp with velocity. Newest frames first.
+  void gather(double stamp, double window, const Eigen::Vector3f& velocity, std::vector<Point3f>& out) const {
+    out.clear();
+    const size_t capacity = points_.size();
+    const uint64_t oldest = head_ > capacity ? head_ - capacity : 0;
+    const size_t n_frames = std::min<uint64_t>(next_frame_, frames_.size());
+    for (size_t k = 1; k <= n_frames; k++) {
+      const Frame& frame = frames_[(next_frame_ - k) % frames_.size()];
+      const double age = stamp - frame.stamp;
+      if (age > window || frame.begin + frame.count <= oldest) break;
+      const Eigen::Vector3f shift = velocity * static_cast<float>(age);
+      for (uint64_t i = std::max(frame.begin, oldest); i < frame.begin + frame.count; i++) {
+        const Point3f& p = points_[i % capacity];
+        out.push_back({p.x + shift.x(), p.y + shift.y(), p.z + shift.z()});
+      }
+    }
+  }
+
+  size_t capacity() const { return points_.size(); }
+  size_t bytes() const { return points_.capacity() * sizeof(Point3f) + frames_.capacity() * sizeof(Frame); }
+
+  private:
+  struct Frame {
+    uint64_t begin = 0;
+    uint32_t count = 0;
+    double stamp = 0.0;
+  };
+
+  std::vector<Point3f> points_;
+  std::vector<Frame> frames_;
+  // total number of points and frames ever pushed
+  uint64_t head_ = 0;
+  uint64_t next_frame_ = 0;
+};
+
+#endif  // __POINT_HISTORY_HPP__
@@ -0,0 +1,43 @@
+/**
+ * @file priority_mutex.hpp
+ * @brief Mutex with priority inheritance, for the locks a real-time thread shares.
+ *
+ * A SCHED_FIFO thread blocked on a plain std::mutex waits for the owner to run at its own,
+ * lower priority, so any thread in between can delay it without bound. The owner of a
+ * PTHREAD_PRIO_INHERIT mutex runs at the priority of its highest waiter until it unlocks.
+ */
+
+#ifndef __PRIORITY_MUTEX_HPP__
+#define __PRIORITY_MUTEX_HPP__
+
+#include <pthread.h>
+
+#include <system_error>
+
+// Drop-in for std::mutex with std::lock_guard and std::unique_lock
+class PriorityInheritanceMutex {
+  public:
+  PriorityInheritanceMutex() {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    const int err = pthread_mutex_init(&mutex_, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (err != 0) throw std::system_error(err, std::generic_category(), "pthread_mutex_init");
+  }
+  ~PriorityInheritanceMutex() { pthread_mutex_destroy(&mutex_); }
+  PriorityInheritanceMutex(const PriorityInheritanceMutex&) = delete;
+  PriorityInheritanceMutex& operator=(const PriorityInheritanceMutex&) = delete;
+
+  void lock() {
+    const int err = pthread_mutex_lock(&mutex_);
+    if (err != 0) throw std::system_error(err, std::generic_category(), "pthread_mutex_lock");
+  }
+  bool try_lock() { return pthread_mutex_trylock(&mutex_) == 0; }
+  void unlock() { pthread_mutex_unlock(&mutex_); }
+
+  private:
+  pthread_mutex_t mutex_;
+};
+
+#endif  // __PRIORITY_MUTEX_HPP__
@@ -0,0 +1,47 @@
+/**
+ * @file reacquisition.hpp
+ * @brief Full frame search of a lost track on a coarse grid of depth samples.
+ *
+ * The depth image is sampled once per grid cell, cells near the expected height of the
+ * target are grouped into blobs of continuous depth and the blobs of about the target size
+ * are candidates. The grid never exceeds max_cells, so a scan costs the same on every frame
+ * whatever the resolution or the scene.
+ */
+
+#ifndef __REACQUISITION_HPP__
+#define __REACQUISITION_HPP__
+
+#include <Eigen/Geometry>
+#include <cstdint>
+#include <vector>
+
+#include "camera_model.hpp"
+#include "depth_view.hpp"
+
+struct ReacquisitionParams {
+  int max_cells = 4800;           // depth samples per scan
+  double height_tolerance = 0.3;  // around the last height of the track, in the tracking frame
+  double size_tolerance = 1.0;    // blob extent within extent * (1 + tol) and extent / (1 + tol)
+  double depth_jump = 0.1;        // neighbour cells differing more than this fraction are split
+  double default_extent = 0.5;    // tracks never sized by a detection
+};
+
+class ReacquisitionScan {
+  public:
+  // Centroid of the blob of depth best matching a target of size extent last seen at
+  // last_position, in the tracking frame. Among matching blobs the closest one wins.
+  bool scan(const DepthView& depth, const CameraModel& camera, const Eigen::Isometry3d& optical_to_earth,
+            const Eigen::Vector3d& last_position, double extent, const ReacquisitionParams& params,
+            Eigen::Vector3d& found);
+
+  size_t bytes() const;
+
+  private:
+  // per cell, depth is 0 for cells left out of the height band
+  std::vector<float> depth_;
+  std::vector<Eigen::Vector3f> points_;
+  std::vector<uint8_t> visited_;
+  std::vector<int> stack_;
+};
+
+#endif  // __REACQUISITION_HPP__
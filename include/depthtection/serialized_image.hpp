@@ -0,0 +1,44 @@
+/**
+ * @file serialized_image.hpp
+ * @brief Reads a depth sensor_msgs/Image straight from its serialized CDR buffer.
+ *
+ * Only the header, the dimensions and the encoding are parsed, the pixels stay in the
+ * buffer and only the requested rows are converted, so no full frame copy is made.
+ */
+
+#ifndef __SERIALIZED_IMAGE_HPP__
+#define __SERIALIZED_IMAGE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "compressed_depth.hpp"
+
+class SerializedDepthImage {
+  public:
+  // Parses a CDR little endian serialized sensor_msgs/Image. The buffer must outlive the
+  // decodeRows calls.
+  bool reset(const uint8_t* data, size_t size, std::string& error);
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  int64_t stampNs() const { return stamp_ns_; }
+  const std::string& frameId() const { return frame_id_; }
+
+  // Writes the requested rows as metres (0 when invalid) into depth, a height x width float
+  // image with stride floats per row. Other rows are not touched.
+  bool decodeRows(const RowRanges& rows, float* depth, size_t stride, std::string& error) const;
+
+  private:
+  const uint8_t* pixels_ = nullptr;
+  int64_t stamp_ns_ = 0;
+  std::string frame_id_;
+  int width_ = 0;
+  int height_ = 0;
+  uint32_t step_ = 0;
+  bool millimetres_ = false;
+  bool swap_ = false;
+};
+
+#endif  // __SERIALIZED_IMAGE_HPP__
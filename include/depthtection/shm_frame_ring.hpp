@@ -0,0 +1,102 @@
+/**
+ * @file shm_frame_ring.hpp
+ * @brief Lock-free single producer ring of depth frames and detections in POSIX shared memory.
+ *
+ * Every slot is guarded by a sequence counter (seqlock): odd while the producer writes it,
+ * even once complete. Readers get views pointing straight into the mapping and check the
+ * counter again after using them to detect that the producer lapped them.
+ */
+
+#ifndef __SHM_FRAME_RING_HPP__
+#define __SHM_FRAME_RING_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define SHM_FRAME_RING_MAGIC "DTFRAMES"
+#define SHM_FRAME_RING_VERSION 1
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory counters must be lock free");
+
+struct ShmDetection {
+  char class_id[32];
+  float score;
+  float center_x;
+  float center_y;
+  float size_x;
+  float size_y;
+};
+
+struct ShmRingHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t n_slots;
+  uint32_t max_width;
+  uint32_t max_height;
+  uint32_t max_detections;
+  uint32_t reserved;
+  uint64_t slot_size;
+  // frames published so far, the last one lives in slot (write_index - 1) % n_slots
+  std::atomic<uint64_t> write_index;
+};
+
+struct alignas(64) ShmSlotHeader {
+  std::atomic<uint64_t> sequence;
+  int64_t stamp_ns;
+  uint32_t width;
+  uint32_t height;
+  uint32_t n_detections;
+  uint32_t reserved;
+  char frame_id[64];
+};
+
+// Zero-copy view of one frame, valid while ShmFrameRing::stillValid() returns true
+struct ShmFrameView {
+  uint64_t sequence = 0;
+  uint64_t frame_index = 0;
+  int64_t stamp_ns = 0;
+  const char* frame_id = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  const float* depth = nullptr;  // rows of width floats, densely packed
+  uint32_t n_detections = 0;
+  const ShmDetection* detections = nullptr;
+};
+
+class ShmFrameRing {
+  public:
+  ShmFrameRing() = default;
+  ~ShmFrameRing();
+  ShmFrameRing(const ShmFrameRing&) = delete;
+  ShmFrameRing& operator=(const ShmFrameRing&) = delete;
+
+  // Producer side: creates (or recreates) the shared memory object
+  bool create(const std::string& name, uint32_t n_slots, uint32_t max_width, uint32_t max_height,
+              uint32_t max_detections, std::string& error);
+  bool publish(int64_t stamp_ns, const std::string& frame_id, const float* depth, uint32_t width, uint32_t height,
+               size_t step_bytes, const ShmDetection* detections, uint32_t n_detections);
+
+  // Consumer side
+  bool open(const std::string& name, std::string& error);
+  // Latest complete frame newer than the last one returned. dropped counts the frames skipped.
+  bool latest(ShmFrameView& view, uint64_t& dropped);
+  bool stillValid(const ShmFrameView& view) const;
+
+  bool isOpen() const { return header_ != nullptr; }
+
+  private:
+  char* slot(uint64_t index) const;
+  ShmDetection* slotDetections(char* slot) const;
+  float* slotDepth(char* slot) const;
+  void close();
+
+  ShmRingHeader* header_ = nullptr;
+  size_t size_ = 0;
+  std::string name_;
+  bool owner_ = false;
+  uint64_t last_read_ = 0;
+};
+
+#endif  // __SHM_FRAME_RING_HPP__
@@ -0,0 +1,155 @@
+/**
+ * @file stage_metrics.hpp
+ * @brief Per pipeline stage latency and heap allocation accounting.
+ */
+
+#ifndef __STAGE_METRICS_HPP__
+#define __STAGE_METRICS_HPP__
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "perf_counters.hpp"
+#include "priority_mutex.hpp"
+
+// Heap allocations made by the calling thread since it started. Incremented by the malloc and
+// operator new replacements in alloc_hooks.cpp.
+struct AllocCounters {
+  uint64_t allocs = 0;
+  uint64_t bytes = 0;
+};
+AllocCounters threadAllocCounters();
+
+enum class Stage : int {
+  IMAGES_DECODE,
+  DETECTION,
+  CLOUD_CONVERSION,
+  CLOUD_FILTER,
+  CLOUD_ESTIMATION,
+  CLOUD_PUBLISH,
+  REACQUISITION,
+  CLOSE_RANGE,
+  N_STAGES
+};
+
+inline const char* stageName(Stage stage) {
+  static const char* names[] = {"images_decode",    "detection",        "cloud_conversion",
+                                "cloud_filter",     "cloud_estimation", "cloud_publish",
+                                "reacquisition",    "close_range"};
+  return names[static_cast<int>(stage)];
+}
+
+struct StageStats {
+  uint64_t calls = 0;
+  double total_ms = 0.0;
+  double max_ms = 0.0;
+  uint64_t allocs = 0;
+  uint64_t bytes = 0;
+  // work units (pixels, points, ...) of the calls, from ScopedStage::setItems, 0 for the stages
+  // that do not set them
+  uint64_t items = 0;
+  PerfSample perf;
+};
+
+// Resident size of the long lived buffers, refreshed by the node on every callback.
+struct MemoryFootprint {
+  size_t track_store_bytes = 0;
+  size_t n_tracks = 0;
+  size_t cloud_bytes = 0;
+  size_t image_bytes = 0;
+};
+
+class StageMetrics {
+  public:
+  static constexpr int N = static_cast<int>(Stage::N_STAGES);
+  typedef std::array<StageStats, N> Snapshot;
+
+  void record(Stage stage, double elapsed_ms, const AllocCounters& allocated, uint64_t items,
+              const PerfSample& perf) {
+    std::lock_guard<PriorityInheritanceMutex> lock(mutex_);
+    auto& stats = stats_[static_cast<int>(stage)];
+    stats.calls++;
+    stats.total_ms += elapsed_ms;
+    stats.max_ms = std::max(stats.max_ms, elapsed_ms);
+    stats.allocs += allocated.allocs;
+    stats.bytes += allocated.bytes;
+    stats.items += items;
+    stats.perf.cycles += perf.cycles;
+    stats.perf.instructions += perf.instructions;
+    stats.perf.l1d_misses += perf.l1d_misses;
+    stats.perf.llc_misses += perf.llc_misses;
+    stats.perf.branch_misses += perf.branch_misses;
+  }
+
+  // Benchmark mode: also sample the hardware counters of the thread running each stage
+  void enablePerfCounters(bool enable) { perf_enabled_ = enable; }
+  bool perfEnabled() const { return perf_enabled_; }
+
+  void setFootprint(const MemoryFootprint& footprint) {
+    std::lock_guard<PriorityInheritanceMutex> lock(mutex_);
+    footprint_ = footprint;
+  }
+
+  // Returns the stats accumulated since the previous call and starts a new window.
+  Snapshot takeSnapshot(MemoryFootprint& footprint) {
+    std::lock_guard<PriorityInheritanceMutex> lock(mutex_);
+    Snapshot snapshot = stats_;
+    stats_ = Snapshot();
+    footprint = footprint_;
+    return snapshot;
+  }
+
+  private:
+  // also taken by the real-time detection thread
+  PriorityInheritanceMutex mutex_;
+  Snapshot stats_;
+  MemoryFootprint footprint_;
+  bool perf_enabled_ = false;
+};
+
+// Measures wall time and allocations of the enclosing scope and adds them to a stage.
+class ScopedStage {
+  public:
+  ScopedStage(StageMetrics& metrics, Stage stage)
+      : metrics_(metrics), stage_(stage), perf_(metrics.perfEnabled()), start_allocs_(threadAllocCounters()) {
+    if (perf_) perf_ = PerfCounters::forThisThread().read(start_perf_);
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  ~ScopedStage() {
+    const auto end = std::chrono::steady_clock::now();
+    PerfSample perf;
+    if (perf_ && PerfCounters::forThisThread().read(perf)) {
+      perf = perf - start_perf_;
+    } else {
+      perf = PerfSample();
+    }
+    const AllocCounters end_allocs = threadAllocCounters();
+    AllocCounters allocated;
+    allocated.allocs = end_allocs.allocs - start_allocs_.allocs;
+    allocated.bytes = end_allocs.bytes - start_allocs_.bytes;
+    metrics_.record(stage_, std::chrono::duration<double, std::milli>(end - start_).count(), allocated, items_,
+                    perf);
+  }
+
+  // Number of elements (points, pixels) processed, used to normalize the counters
+  void setItems(uint64_t items) { items_ = items; }
+
+  ScopedStage(const ScopedStage&) = delete;
+  ScopedStage& operator=(const ScopedStage&) = delete;
+
+  private:
+  StageMetrics& metrics_;
+  Stage stage_;
+  bool perf_;
+  uint64_t items_ = 0;
+  AllocCounters start_allocs_;
+  PerfSample start_perf_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#endif  // __STAGE_METRICS_HPP__
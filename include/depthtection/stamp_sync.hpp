@@ -0,0 +1,235 @@
+/**
+ * @file stamp_sync.hpp
+ * @brief Matching of the messages of several topics by stamp, in constant time per message.
+ *
+ * Each topic keeps its unmatched messages in a fixed table of SLOTS entries, set associative
+ * with WAYS entries per bucket and indexed by a hash of the stamp quantized to the tolerance.
+ * An arriving message looks for its partners in the buckets of the neighbouring bins of the
+ * other tables, so a set is emitted as soon as its last member arrives, in any order, and a
+ * topic published at a lower rate still finds the frames of the faster ones waiting. Messages
+ * leave a table matched, when a newer one needs the bucket, which is when incomplete sets are
+ * counted, or once they are more than the window older than the newest stamp, so a slow
+ * detector does not keep up to SLOTS images of every topic alive.
+ */
+
+#ifndef __STAMP_SYNC_HPP__
+#define __STAMP_SYNC_HPP__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+// Counters of a StampSync, read from any thread
+struct StampSyncStats {
+  static constexpr size_t MAX_TOPICS = 4;
+  // complete sets handed to the callback
+  std::atomic<uint64_t> matched{0};
+  // sets evicted with more than one but not all of their required messages
+  std::atomic<uint64_t> partial{0};
+  // messages evicted with no partner on any other topic or expired, per topic
+  std::array<std::atomic<uint64_t>, MAX_TOPICS> dropped{};
+};
+
+// Not thread safe, add() is meant to be called from callbacks of one mutually exclusive group.
+// Topics that are not required are attached to a set when present and passed as nullptr
+// otherwise. A window of 0 keeps the messages until they are matched or evicted.
+template <typename... Ts>
+class StampSync {
+  public:
+  static constexpr size_t N = sizeof...(Ts);
+  static constexpr size_t WAYS = 4;
+  static constexpr size_t BUCKET_BITS = 5;
+  static constexpr size_t SLOTS = WAYS << BUCKET_BITS;
+  static_assert(N >= 2 && N <= StampSyncStats::MAX_TOPICS, "2 to 4 topics");
+
+  template <size_t I>
+  using Message = std::tuple_element_t<I, std::tuple<Ts...>>;
+  using Callback = std::function<void(const std::shared_ptr<Ts>&...)>;
+
+  StampSync(int64_t tolerance_ns, int64_t window_ns, const std::array<bool, N>& required, Callback callback)
+      : tolerance_(tolerance_ns > 0 ? tolerance_ns : 0),
+        window_(window_ns > 0 ? std::max(window_ns, tolerance_) : 0),
+        required_(required),
+        callback_(std::move(callback)) {}
+
+  template <size_t I>
+  void add(int64_t stamp_ns, std::shared_ptr<Message<I>> msg) {
+    if (window_ && expire(stamp_ns)) {
+      stats_.dropped[I]++;
+      return;
+    }
+    std::tuple<std::shared_ptr<Ts>...> set;
+    std::get<I>(set) = std::move(msg);
+    if (collect<I>(stamp_ns, set, std::index_sequence_for<Ts...>{})) {
+      release<I>(stamp_ns, std::index_sequence_for<Ts...>{});
+      stats_.matched++;
+      std::apply(callback_, set);
+      return;
+    }
+    insert<I>(stamp_ns, std::move(std::get<I>(set)));
+  }
+
+  // Forgets the messages waiting for a set that will not be processed, without counting them
+  void discard(int64_t stamp_ns) { release<N>(stamp_ns, std::index_sequence_for<Ts...>{}); }
+
+  const StampSyncStats& stats() const { return stats_; }
+  int64_t tolerance() const { return tolerance_; }
+  int64_t window() const { return window_; }
+
+  private:
+  template <typename T>
+  struct Slot {
+    int64_t stamp = 0;
+    std::shared_ptr<T> msg;
+  };
+  template <typename T>
+  using Table = std::array<Slot<T>, SLOTS>;
+
+  int64_t bin(int64_t stamp) const {
+    if (tolerance_ == 0) return stamp;
+    const int64_t q = stamp / tolerance_;
+    return q - (stamp % tolerance_ < 0);
+  }
+  static size_t bucket(int64_t bin) { return ((uint64_t(bin) * 0x9e3779b97f4a7c15ull) >> (64 - BUCKET_BITS)) * WAYS; }
+
+  // closest message of topic J within the tolerance, a partner is at most one bin away
+  template <size_t J>
+  Slot<Message<J>>* find(int64_t stamp) {
+    auto& table = std::get<J>(tables_);
+    Slot<Message<J>>* best = nullptr;
+    uint64_t best_dt = uint64_t(tolerance_) + 1;
+    const int64_t b = bin(stamp), reach = tolerance_ > 0;
+    for (int64_t k = b - reach; k <= b + reach; k++) {
+      const size_t first = bucket(k);
+      for (size_t w = first; w < first + WAYS; w++) {
+        if (!table[w].msg) continue;
+        const int64_t d = table[w].stamp - stamp;
+        const uint64_t dt = d < 0 ? -uint64_t(d) : uint64_t(d);
+        if (dt < best_dt) {
+          best_dt = dt;
+          best = &table[w];
+        }
+      }
+    }
+    return best;
+  }
+
+  template <size_t I, size_t... J>
+  bool collect(int64_t stamp, std::tuple<std::shared_ptr<Ts>...>& set, std::index_sequence<J...>) {
+    bool complete = true;
+    (
+        [&] {
+          if constexpr (J != I) {
+            if (auto* slot = find<J>(stamp)) {
+              std::get<J>(set) = slot->msg;
+            } else if (required_[J]) {
+              complete = false;
+            }
+          }
+        }(),
+        ...);
+    return complete;
+  }
+
+  // empties the slots of the partners of a message of topic I, returns how many there were
+  template <size_t I, size_t... J>
+  int release(int64_t stamp, std::index_sequence<J...>) {
+    int released = 0;
+    (
+        [&] {
+          if constexpr (J != I) {
+            if (auto* slot = find<J>(stamp)) {
+              slot->msg.reset();
+              released++;
+            }
+          }
+        }(),
+        ...);
+    return released;
+  }
+
+  // the set of a required message can no longer complete once it is evicted
+  template <size_t I>
+  void evict(int64_t stamp) {
+    if (required_[I] && release<I>(stamp, std::index_sequence_for<Ts...>{}) > 0) {
+      stats_.partial++;
+    } else {
+      stats_.dropped[I]++;
+    }
+  }
+
+  // empties the slots out of the window of the newest stamp, returns whether stamp is out of it.
+  // The tables are only swept once the oldest message they may hold is an eighth of the window
+  // past it, so a message is kept at most 9 / 8 of the window and the sweeps are amortized.
+  bool expire(int64_t stamp) {
+    newest_ = std::max(newest_, stamp);
+    const int64_t limit = newest_ - window_;
+    if (oldest_ < limit - window_ / 8) {
+      oldest_ = std::numeric_limits<int64_t>::max();
+      sweep(limit, std::index_sequence_for<Ts...>{});
+    }
+    return stamp < limit;
+  }
+
+  template <size_t... J>
+  void sweep(int64_t limit, std::index_sequence<J...>) {
+    (
+        [&] {
+          for (auto& slot : std::get<J>(tables_)) {
+            if (!slot.msg) continue;
+            if (slot.stamp < limit) {
+              slot.msg.reset();
+              stats_.dropped[J]++;
+            } else {
+              oldest_ = std::min(oldest_, slot.stamp);
+            }
+          }
+        }(),
+        ...);
+  }
+
+  // the message takes a free way of its bucket or the oldest one, unless it is older than all
+  template <size_t I>
+  void insert(int64_t stamp, std::shared_ptr<Message<I>> msg) {
+    auto& table = std::get<I>(tables_);
+    const size_t first = bucket(bin(stamp));
+    Slot<Message<I>>* victim = &table[first];
+    for (size_t w = first; w < first + WAYS; w++) {
+      if (!table[w].msg) {
+        victim = &table[w];
+        break;
+      }
+      if (table[w].stamp < victim->stamp) victim = &table[w];
+    }
+    if (victim->msg) {
+      if (victim->stamp > stamp) {
+        evict<I>(stamp);
+        return;
+      }
+      victim->msg.reset();
+      evict<I>(victim->stamp);
+    }
+    victim->stamp = stamp;
+    victim->msg = std::move(msg);
+    oldest_ = std::min(oldest_, stamp);
+  }
+
+  const int64_t tolerance_;
+  const int64_t window_;
+  const std::array<bool, N> required_;
+  Callback callback_;
+  std::tuple<Table<Ts>...> tables_;
+  // newest stamp added, and a lower bound of the stamps in the tables
+  int64_t newest_ = std::numeric_limits<int64_t>::min();
+  int64_t oldest_ = std::numeric_limits<int64_t>::max();
+  StampSyncStats stats_;
+};
+
+#endif  // __STAMP_SYNC_HPP__
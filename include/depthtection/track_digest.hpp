@@ -0,0 +1,42 @@
+/**
+ * @file track_digest.hpp
+ * @brief Compact wire format to share confirmed tracks between vehicles.
+ *
+ * Layout: version (u8), vehicle id (u8), sequence (u16), stamp in ns (i64), number of class
+ * names (u8) followed by each name (u8 length + bytes), number of tracks (varint). Tracks are
+ * sorted by id and each one stores the id delta, the class index, the position as a delta from
+ * the previous track in centimetres, the velocity in cm/s (zigzag varints) and the confidence
+ * quantized to u8. A handful of tracks fits in a few tens of bytes.
+ */
+
+#ifndef __TRACK_DIGEST_HPP__
+#define __TRACK_DIGEST_HPP__
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define TRACK_DIGEST_VERSION 1
+
+struct TrackDigestEntry {
+  int id;
+  std::string class_name;
+  Eigen::Vector3d position;
+  Eigen::Vector3d velocity;
+  float confidence;
+};
+
+struct TrackDigest {
+  uint8_t vehicle_id = 0;
+  uint16_t sequence = 0;
+  int64_t stamp_ns = 0;
+  std::vector<TrackDigestEntry> tracks;
+};
+
+void encode_track_digest(const TrackDigest& digest, std::vector<uint8_t>& buffer);
+
+// Returns false on truncated or unknown buffers
+bool decode_track_digest(const std::vector<uint8_t>& buffer, TrackDigest& digest);
+
+#endif  // __TRACK_DIGEST_HPP__
@@ -0,0 +1,87 @@
+/**
+ * @file track_log.hpp
+ * @brief Append-only track history log over a ring of preallocated memory-mapped files.
+ */
+
+#ifndef __TRACK_LOG_HPP__
+#define __TRACK_LOG_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define TRACK_LOG_MAGIC "DTTRKLOG"
+#define TRACK_LOG_VERSION 1
+
+enum class TrackSource : uint8_t {
+  DETECTION = 0,
+  POINT_CLOUD = 1,
+  REACQUISITION = 2,
+  CLOSE_RANGE = 3,
+};
+
+struct TrackRecord {
+  int64_t stamp_ns;
+  int32_t track_id;
+  float confidence;
+  uint8_t phase;
+  uint8_t source;
+  uint16_t reserved = 0;
+  float raw[3];
+  float filtered[3];
+  float predicted[3];
+  float velocity[3];
+  uint32_t padding = 0;
+};
+static_assert(sizeof(TrackRecord) == 72, "TrackRecord layout is part of the file format");
+
+struct TrackLogHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t capacity;
+  // rotation counter, orders the files of the ring
+  uint64_t sequence;
+  // records written, updated after each record is copied
+  uint64_t count;
+  uint8_t padding[24];
+};
+static_assert(sizeof(TrackLogHeader) == 64, "TrackLogHeader layout is part of the file format");
+
+class TrackLogWriter {
+  public:
+  TrackLogWriter() = default;
+  ~TrackLogWriter();
+  TrackLogWriter(const TrackLogWriter&) = delete;
+  TrackLogWriter& operator=(const TrackLogWriter&) = delete;
+
+  // Creates and maps n_files files of records_per_file records named <prefix>_<i>.bin.
+  // All the space is allocated here, append never touches the file system.
+  bool open(const std::string& prefix, uint64_t records_per_file, int n_files, std::string& error);
+  bool isOpen() const { return !files_.empty(); }
+
+  void append(const TrackRecord& record) {
+    MappedFile* file = &files_[current_];
+    if (file->header->count == file->header->capacity) file = rotate();
+    std::memcpy(file->records + file->header->count, &record, sizeof(TrackRecord));
+    file->header->count++;
+  }
+
+  private:
+  struct MappedFile {
+    void* addr = nullptr;
+    size_t size = 0;
+    TrackLogHeader* header = nullptr;
+    TrackRecord* records = nullptr;
+  };
+
+  MappedFile* rotate();
+  void close();
+
+  std::vector<MappedFile> files_;
+  size_t current_ = 0;
+  uint64_t sequence_ = 0;
+};
+
+#endif  // __TRACK_LOG_HPP__
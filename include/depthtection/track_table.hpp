@@ -0,0 +1,111 @@
+/**
+ * @file track_table.hpp
+ * @brief Filter state of every track in structure of arrays form.
+ *
+ * Measurements are staged per track and applied by one commit() over the whole table for
+ * all tracks sharing the stamp, and predict() extrapolates every track at once. Both loops
+ * are branch free over contiguous float arrays so the compiler vectorizes them.
+ *
+ * Each track also keeps its last HISTORY measurements with the state they were applied to.
+ * A measurement older than the track state (a slow cloud after a newer detection) is applied
+ * at its own stamp: the state before the first newer measurement is restored and the newer
+ * ones are applied again after it, at most HISTORY steps.
+ */
+
+#ifndef __TRACK_TABLE_HPP__
+#define __TRACK_TABLE_HPP__
+
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class TrackTable {
+  public:
+  // EMA weight of a new measurement in the filtered position and of a new speed sample
+  static constexpr float ALPHA = 0.1f;
+  // Minimum time between speed samples
+  static constexpr double SPEED_PERIOD = 1.0;
+  // Speed samples needed before the compensated position is extrapolated
+  static constexpr int SPEED_SAMPLES_BEFORE_PREDICTION = 2;
+  // Latency compensated by the compensated position
+  static constexpr float COMPENSATION_HORIZON = 0.08f;
+  // Measurements kept per track to re-apply after a late one
+  static constexpr int HISTORY = 8;
+
+  // Returns the slot of a new track, slots of removed tracks are reused
+  uint32_t add(const Eigen::Vector3f& position, double stamp);
+  void remove(uint32_t slot);
+
+  // Measurement to apply in the next commit, a later one for the same slot replaces it
+  void stage(uint32_t slot, const Eigen::Vector3f& measurement);
+  // Applies every staged measurement with the given stamp, late ones through the history
+  void commit(double stamp);
+  // Extrapolates every track to stamp
+  void predict(double stamp);
+
+  // Moves the state of slot towards position and velocity by weight w in [0, 1]. Like fuse,
+  // it drops the measurement history of the slot.
+  void blend(uint32_t slot, const Eigen::Vector3f& position, const Eigen::Vector3f& velocity, float w);
+  // Fuses the state of removed into kept with the given weights, removed is left untouched
+  void fuse(uint32_t kept, uint32_t removed, float w_kept, float w_removed);
+
+  Eigen::Vector3f filtered(uint32_t slot) const { return Eigen::Vector3f(fx_[slot], fy_[slot], fz_[slot]); }
+  Eigen::Vector3f velocity(uint32_t slot) const { return Eigen::Vector3f(vx_[slot], vy_[slot], vz_[slot]); }
+  Eigen::Vector3f compensated(uint32_t slot) const { return Eigen::Vector3f(cx_[slot], cy_[slot], cz_[slot]); }
+  Eigen::Vector3f predicted(uint32_t slot) const { return Eigen::Vector3f(px_[slot], py_[slot], pz_[slot]); }
+  bool hasCompensation(uint32_t slot) const { return speed_samples_[slot] > SPEED_SAMPLES_BEFORE_PREDICTION; }
+  // Stamp of the commit that last updated slot
+  double lastUpdate(uint32_t slot) const { return last_t_[slot]; }
+
+  // Late measurements applied through the history, and those older than it that were dropped
+  uint64_t lateMeasurements() const { return late_measurements_; }
+  uint64_t droppedLateMeasurements() const { return dropped_late_measurements_; }
+
+  size_t size() const { return fx_.size() - free_.size(); }
+  size_t capacity() const { return fx_.size(); }
+  size_t bytes() const;
+
+  private:
+  // A measurement and the state it was applied to
+  struct HistoryEntry {
+    double stamp;
+    float mx, my, mz;
+    float fx, fy, fz, vx, vy, vz, ax, ay, az;
+    int32_t speed_samples;
+    double anchor_t, last_t;
+  };
+
+  // The commit loop over slots [begin, end)
+  void apply(size_t begin, size_t end, double stamp);
+  void record(uint32_t slot, double stamp);
+  void replay(uint32_t slot, double stamp);
+  // Applies one measurement to slot alone, recording it
+  void step(uint32_t slot, const Eigen::Vector3f& measurement, double stamp);
+  HistoryEntry& entry(uint32_t slot, int k) { return history_[slot * HISTORY + (history_begin_[slot] + k) % HISTORY]; }
+
+  // filtered position, velocity, compensated and predicted positions
+  std::vector<float> fx_, fy_, fz_;
+  std::vector<float> vx_, vy_, vz_;
+  std::vector<float> cx_, cy_, cz_;
+  std::vector<float> px_, py_, pz_;
+  // position and stamp of the last speed sample, number of samples taken (+1 for the first anchor)
+  std::vector<float> ax_, ay_, az_;
+  std::vector<double> anchor_t_;
+  std::vector<int32_t> speed_samples_;
+  // staged measurement, staged_ is 1 for the slots updated by the next commit
+  std::vector<float> mx_, my_, mz_;
+  std::vector<float> staged_;
+  std::vector<uint32_t> staged_slots_;
+  std::vector<double> last_t_;
+  std::vector<uint32_t> free_;
+
+  // HISTORY entries per slot, a ring starting at history_begin_
+  std::vector<HistoryEntry> history_;
+  std::vector<uint8_t> history_begin_, history_size_;
+  std::vector<HistoryEntry> replayed_;
+  uint64_t late_measurements_ = 0;
+  uint64_t dropped_late_measurements_ = 0;
+};
+
+#endif  // __TRACK_TABLE_HPP__
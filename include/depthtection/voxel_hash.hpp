@@ -0,0 +1,192 @@
+/**
+ * @file voxel_hash.hpp
+ * @brief Fixed capacity voxel key to value hash shared by the spatial stages.
+ *
+ * Keys are Morton codes of the integer voxel coordinates (21 bits per axis), so nearby
+ * voxels get nearby keys and hash buckets. The table uses open addressing with linear
+ * probing over a power of two array sized once from the voxel ceiling given at
+ * construction; inserting past the ceiling fails instead of growing. clear() only bumps a
+ * generation counter, nothing is freed or rewritten between frames.
+ */
+
+#ifndef __VOXEL_HASH_HPP__
+#define __VOXEL_HASH_HPP__
+
+#include <Eigen/Dense>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Voxel coordinates are offset by 2^20 so [-2^20, 2^20) maps onto 21 unsigned bits
+constexpr int64_t VOXEL_COORD_OFFSET = int64_t(1) << 20;
+
+inline uint64_t mortonSplit3(uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffff;
+  v = (v | v << 16) & 0x1f0000ff0000ff;
+  v = (v | v << 8) & 0x100f00f00f00f00f;
+  v = (v | v << 4) & 0x10c30c30c30c30c3;
+  v = (v | v << 2) & 0x1249249249249249;
+  return v;
+}
+
+inline uint64_t mortonCompact3(uint64_t v) {
+  v &= 0x1249249249249249;
+  v = (v ^ v >> 2) & 0x10c30c30c30c30c3;
+  v = (v ^ v >> 4) & 0x100f00f00f00f00f;
+  v = (v ^ v >> 8) & 0x1f0000ff0000ff;
+  v = (v ^ v >> 16) & 0x1f00000000ffff;
+  v = (v ^ v >> 32) & 0x1fffff;
+  return v;
+}
+
+inline uint64_t mortonEncode(int64_t x, int64_t y, int64_t z) {
+  return mortonSplit3(x + VOXEL_COORD_OFFSET) | mortonSplit3(y + VOXEL_COORD_OFFSET) << 1 |
+         mortonSplit3(z + VOXEL_COORD_OFFSET) << 2;
+}
+
+inline Eigen::Matrix<int64_t, 3, 1> mortonDecode(uint64_t key) {
+  return Eigen::Matrix<int64_t, 3, 1>(int64_t(mortonCompact3(key)) - VOXEL_COORD_OFFSET,
+                                      int64_t(mortonCompact3(key >> 1)) - VOXEL_COORD_OFFSET,
+                                      int64_t(mortonCompact3(key >> 2)) - VOXEL_COORD_OFFSET);
+}
+
+// Key of the voxel of side 1 / inv_voxel_size holding p
+inline uint64_t voxelKey(float x, float y, float z, float inv_voxel_size) {
+  return mortonEncode(static_cast<int64_t>(std::floor(x * inv_voxel_size)),
+                      static_cast<int64_t>(std::floor(y * inv_voxel_size)),
+                      static_cast<int64_t>(std::floor(z * inv_voxel_size)));
+}
+
+// Adds d in {-1, 0, 1} to one axis directly on the interleaved bits
+inline uint64_t mortonStep(uint64_t key, int axis, int d) {
+  const uint64_t mask = uint64_t(0x1249249249249249) << axis;
+  uint64_t bits = key & mask;
+  if (d > 0) {
+    // carries ripple through the bits of the other axes set to one
+    bits = ((bits | ~mask) + (uint64_t(1) << axis)) & mask;
+  } else if (d < 0) {
+    bits = (bits - (uint64_t(1) << axis)) & mask;
+  }
+  return (key & ~mask) | bits;
+}
+
+inline uint64_t voxelNeighbour(uint64_t key, int dx, int dy, int dz) {
+  return mortonStep(mortonStep(mortonStep(key, 0, dx), 1, dy), 2, dz);
+}
+
+template <typename Value>
+class VoxelHash {
+  public:
+  explicit VoxelHash(size_t max_voxels) : max_voxels_(max_voxels) {
+    size_t capacity = 16;
+    // load factor stays under one half
+    while (capacity < 2 * max_voxels) capacity <<= 1;
+    slots_.resize(capacity);
+    mask_ = capacity - 1;
+    occupied_.reserve(max_voxels);
+  }
+
+  // Empties the table in O(1), values of the previous generation are never read again
+  void clear() {
+    generation_++;
+    occupied_.clear();
+    if (generation_ == 0) {
+      // wrapped around, stale slots could look live
+      for (auto& slot : slots_) slot.generation = 0;
+      generation_ = 1;
+    }
+  }
+
+  // Returns the value of key, inserting a value initialized one if missing. nullptr once
+  // max_voxels are stored.
+  Value* findOrInsert(uint64_t key) {
+    for (size_t i = hash(key);; i = (i + 1) & mask_) {
+      Slot& slot = slots_[i];
+      if (slot.generation != generation_) {
+        if (occupied_.size() >= max_voxels_) return nullptr;
+        slot.generation = generation_;
+        slot.key = key;
+        slot.value = Value();
+        occupied_.push_back(static_cast<uint32_t>(i));
+        return &slot.value;
+      }
+      if (slot.key == key) return &slot.value;
+    }
+  }
+
+  const Value* find(uint64_t key) const {
+    for (size_t i = hash(key);; i = (i + 1) & mask_) {
+      const Slot& slot = slots_[i];
+      if (slot.generation != generation_) return nullptr;
+      if (slot.key == key) return &slot.value;
+    }
+  }
+  Value* find(uint64_t key) { return const_cast<Value*>(static_cast<const VoxelHash*>(this)->find(key)); }
+
+  // Calls f(key, value) for every voxel in insertion order
+  template <typename F>
+  void forEach(F&& f) {
+    for (uint32_t i : occupied_) f(slots_[i].key, slots_[i].value);
+  }
+  template <typename F>
+  void forEach(F&& f) const {
+    for (uint32_t i : occupied_) f(slots_[i].key, static_cast<const Value&>(slots_[i].value));
+  }
+
+  size_t size() const { return occupied_.size(); }
+  size_t maxVoxels() const { return max_voxels_; }
+  bool full() const { return occupied_.size() >= max_voxels_; }
+  size_t bytes() const { return slots_.capacity() * sizeof(Slot) + occupied_.capacity() * sizeof(uint32_t); }
+
+  private:
+  struct Slot {
+    uint64_t key = 0;
+    uint32_t generation = 0;
+    Value value = Value();
+  };
+
+  size_t hash(uint64_t key) const {
+    // Fibonacci hashing spreads the low Morton bits, neighbours stay a few probes apart
+    return static_cast<size_t>((key * 0x9e3779b97f4a7c15ull) >> 32) & mask_;
+  }
+
+  size_t max_voxels_;
+  size_t mask_ = 0;
+  uint32_t generation_ = 1;
+  std::vector<Slot> slots_;
+  // slot of every live voxel, for iteration without scanning the table
+  std::vector<uint32_t> occupied_;
+};
+
+struct VoxelCentroid {
+  Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+  uint32_t count = 0;
+};
+
+// Keeps the centroid of the points of each voxel, out is replaced. Voxels past the table
+// ceiling are dropped.
+template <typename PointT, typename OutT>
+void voxelDownsample(const PointT* points, size_t n, float voxel_size, VoxelHash<VoxelCentroid>& voxels,
+                     std::vector<OutT>& out) {
+  voxels.clear();
+  const float inv = 1.0f / voxel_size;
+  for (size_t i = 0; i < n; i++) {
+    VoxelCentroid* voxel = voxels.findOrInsert(voxelKey(points[i].x, points[i].y, points[i].z, inv));
+    if (!voxel) continue;
+    voxel->sum += Eigen::Vector3f(points[i].x, points[i].y, points[i].z);
+    voxel->count++;
+  }
+  out.clear();
+  voxels.forEach([&out](uint64_t, const VoxelCentroid& voxel) {
+    const Eigen::Vector3f c = voxel.sum / voxel.count;
+    OutT p;
+    p.x = c.x();
+    p.y = c.y();
+    p.z = c.z();
+    out.push_back(p);
+  });
+}
+
+#endif  // __VOXEL_HASH_HPP__
@@ -16,6 +16,8 @@ def generate_launch_description():
         DeclareLaunchArgument('computed_pose_topic', default_value='pose_computed'),
         DeclareLaunchArgument('same_object_distance_threshold', default_value='1.0'),
         DeclareLaunchArgument('phase_topic', default_value='/phase'),
+        DeclareLaunchArgument('track_sharing', default_value='false'),
+        DeclareLaunchArgument('vehicle_id', default_value='0'),
         Node(
             package='depthtection',
             executable='depthtection_node',
@@ -29,6 +31,8 @@ def generate_launch_description():
                         {'target_object': LaunchConfiguration('target_object')},
                         {'computed_pose_topic': LaunchConfiguration('computed_pose_topic')},
                         {'phase_topic': LaunchConfiguration('phase_topic')},
+                        {'track_sharing': LaunchConfiguration('track_sharing')},
+                        {'vehicle_id': LaunchConfiguration('vehicle_id')},
                         {'same_object_distance_threshold': LaunchConfiguration('same_object_distance_threshold')}],
             output='screen',
             emulate_tty=True
@@ -0,0 +1,174 @@
+/**
+ * @file depthtection_py.cpp
+ * @brief NumPy bindings of BatchEvaluator.
+ *
+ * Depth stacks and box tables are read through the buffer protocol in place, any strides are
+ * accepted as long as the element type matches. The GIL is released while C++ runs.
+ *
+ *   ev = depthtection_py.BatchEvaluator(k=K, width=640, height=480, classes=["drone"])
+ *   xyz, valid = ev.estimate(depth, boxes, poses=None, n_threads=0)
+ *   outcome, track_id, xyz = ev.track(depth, boxes, stamps, poses=None)
+ */
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include "batch_evaluation.hpp"
+
+namespace py = pybind11;
+
+static DepthBatch depthBatch(const py::array &depth) {
+  if (!py::isinstance<py::array_t<float>>(depth) || depth.ndim() != 3) {
+    throw py::value_error("depth must be a float32 array of shape (frames, height, width)");
+  }
+  if (depth.strides(2) != sizeof(float)) {
+    throw py::value_error("depth rows must be contiguous");
+  }
+  DepthBatch batch;
+  batch.data = static_cast<const float *>(depth.data());
+  batch.n_frames = static_cast<int>(depth.shape(0));
+  batch.height = static_cast<int>(depth.shape(1));
+  batch.width = static_cast<int>(depth.shape(2));
+  batch.frame_stride = depth.strides(0) / static_cast<ptrdiff_t>(sizeof(float));
+  batch.row_stride = depth.strides(1) / static_cast<ptrdiff_t>(sizeof(float));
+  return batch;
+}
+
+static BoxBatch boxBatch(const py::array &boxes) {
+  if (!py::isinstance<py::array_t<double>>(boxes) || boxes.ndim() != 2 || boxes.shape(1) != BoxBatch::COLUMNS) {
+    throw py::value_error("boxes must be a float64 array of shape (n, 7): frame, cx, cy, sx, sy, score, class");
+  }
+  if (boxes.strides(1) != sizeof(double)) {
+    throw py::value_error("box rows must be contiguous");
+  }
+  BoxBatch batch;
+  batch.data = static_cast<const double *>(boxes.data());
+  batch.n = static_cast<size_t>(boxes.shape(0));
+  batch.stride = boxes.strides(0) / static_cast<ptrdiff_t>(sizeof(double));
+  return batch;
+}
+
+// n_frames row major 4x4 poses, the only inputs that are copied when not C contiguous
+static py::array_t<double, py::array::c_style> posesOf(const py::object &poses, int n_frames) {
+  if (poses.is_none()) {
+    return py::array_t<double, py::array::c_style>();
+  }
+  auto array = py::array_t<double, py::array::c_style | py::array::forcecast>::ensure(poses);
+  if (!array || array.ndim() != 3 || array.shape(0) != n_frames || array.shape(1) != 4 || array.shape(2) != 4) {
+    throw py::value_error("poses must have shape (frames, 4, 4)");
+  }
+  return array;
+}
+
+static BatchEvaluator *makeEvaluator(const py::array_t<double, py::array::c_style | py::array::forcecast> &k,
+                                     int width, int height, const std::vector<std::string> &classes,
+                                     const std::string &estimator,
+                                     const std::vector<std::pair<std::string, std::string>> &class_estimators,
+                                     const std::string &distortion_model, const std::vector<double> &d,
+                                     double same_object_distance, double min_depth_fill, double min_depth,
+                                     double max_depth, double max_depth_std) {
+  if (k.size() != 9) {
+    throw py::value_error("k must hold the 9 values of the intrinsic matrix");
+  }
+  BatchConfig config;
+  std::copy(k.data(), k.data() + 9, config.k);
+  config.width = width;
+  config.height = height;
+  config.classes = classes;
+  config.estimator = estimator;
+  config.class_estimators = class_estimators;
+  config.distortion_model = distortion_model;
+  config.d = d;
+  config.params.same_object_distance = same_object_distance;
+  config.params.min_depth_fill = min_depth_fill;
+  config.params.min_depth = min_depth;
+  config.params.max_depth = max_depth;
+  config.params.max_depth_std = max_depth_std;
+
+  std::string error;
+  auto evaluator = std::make_unique<BatchEvaluator>(config, error);
+  if (!evaluator->valid()) {
+    throw py::value_error(error);
+  }
+  return evaluator.release();
+}
+
+static py::tuple estimate(const BatchEvaluator &evaluator, const py::array &depth, const py::array &boxes,
+                          const py::object &poses, int n_threads) {
+  const DepthBatch depths = depthBatch(depth);
+  const BoxBatch box_batch = boxBatch(boxes);
+  const auto pose_array = posesOf(poses, depths.n_frames);
+  const double *pose_data = poses.is_none() ? nullptr : pose_array.data();
+
+  py::array_t<float> xyz({static_cast<py::ssize_t>(box_batch.n), py::ssize_t(3)});
+  py::array_t<uint8_t> valid(static_cast<py::ssize_t>(box_batch.n));
+  float *xyz_data = xyz.mutable_data();
+  uint8_t *valid_data = valid.mutable_data();
+  std::string error;
+  bool ok;
+  {
+    py::gil_scoped_release release;
+    ok = evaluator.estimate(depths, box_batch, pose_data, n_threads, xyz_data, valid_data, error);
+  }
+  if (!ok) {
+    throw py::value_error(error);
+  }
+  return py::make_tuple(xyz, valid.attr("astype")("bool"));
+}
+
+static py::tuple track(const BatchEvaluator &evaluator, const py::array &depth, const py::array &boxes,
+                       const py::array_t<double, py::array::c_style | py::array::forcecast> &stamps,
+                       const py::object &poses) {
+  const DepthBatch depths = depthBatch(depth);
+  const BoxBatch box_batch = boxBatch(boxes);
+  if (stamps.ndim() != 1 || stamps.shape(0) != depths.n_frames) {
+    throw py::value_error("stamps must have shape (frames,)");
+  }
+  const auto pose_array = posesOf(poses, depths.n_frames);
+  const double *pose_data = poses.is_none() ? nullptr : pose_array.data();
+
+  const auto n = static_cast<py::ssize_t>(box_batch.n);
+  py::array_t<uint8_t> outcome(n);
+  py::array_t<int32_t> track_id(n);
+  py::array_t<float> xyz({n, py::ssize_t(3)});
+  uint8_t *outcome_data = outcome.mutable_data();
+  int32_t *track_id_data = track_id.mutable_data();
+  float *xyz_data = xyz.mutable_data();
+  const double *stamp_data = stamps.data();
+  std::string error;
+  bool ok;
+  {
+    py::gil_scoped_release release;
+    ok = evaluator.track(depths, box_batch, pose_data, stamp_data, outcome_data, track_id_data, xyz_data, error);
+  }
+  if (!ok) {
+    throw py::value_error(error);
+  }
+  return py::make_tuple(outcome, track_id, xyz);
+}
+
+PYBIND11_MODULE(depthtection_py, m) {
+  m.doc() = "Offline batch evaluation of the depthtection core on NumPy arrays";
+
+  py::enum_<BoxOutcome>(m, "BoxOutcome")
+      .value("NEW_TRACK", BoxOutcome::NEW_TRACK)
+      .value("UPDATED_TRACK", BoxOutcome::UPDATED_TRACK)
+      .value("NO_DEPTH", BoxOutcome::NO_DEPTH)
+      .value("REJECTED_LOW_FILL", BoxOutcome::REJECTED_LOW_FILL)
+      .value("REJECTED_DEPTH_RANGE", BoxOutcome::REJECTED_DEPTH_RANGE)
+      .value("REJECTED_DEPTH_SPREAD", BoxOutcome::REJECTED_DEPTH_SPREAD);
+
+  py::class_<BatchEvaluator>(m, "BatchEvaluator")
+      .def(py::init(&makeEvaluator), py::arg("k"), py::arg("width"), py::arg("height"), py::arg("classes"),
+           py::arg("estimator") = "top_slab",
+           py::arg("class_estimators") = std::vector<std::pair<std::string, std::string>>(),
+           py::arg("distortion_model") = "plumb_bob", py::arg("d") = std::vector<double>(),
+           py::arg("same_object_distance") = 1.0, py::arg("min_depth_fill") = 0.05, py::arg("min_depth") = 0.1,
+           py::arg("max_depth") = 50.0, py::arg("max_depth_std") = 0.0)
+      .def("estimate", &estimate, py::arg("depth"), py::arg("boxes"), py::arg("poses") = py::none(),
+           py::arg("n_threads") = 0,
+           "Position of every box, optical frame or tracking frame with poses. Returns (xyz, valid).")
+      .def("track", &track, py::arg("depth"), py::arg("boxes"), py::arg("stamps"), py::arg("poses") = py::none(),
+           "Tracks the frames in order, boxes sorted by frame. Returns (outcome, track_id, xyz).");
+}
@@ -0,0 +1,96 @@
+// Replacement of the allocation functions that counts allocations per thread.
+// Only linked into the node executable, so libraries stay untouched.
+//
+// The C functions are interposed too, forwarding to the glibc allocator, so the heap used
+// outside operator new is counted: cv::fastMalloc goes through posix_memalign, PCL and Eigen
+// through malloc and aligned_alloc. Every operator new below forwards to them and is counted
+// there once.
+
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#include "stage_metrics.hpp"
+
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t n, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void *ptr);
+}
+
+static thread_local AllocCounters thread_alloc_counters;
+
+AllocCounters threadAllocCounters() { return thread_alloc_counters; }
+
+static inline void countAlloc(std::size_t size) {
+  thread_alloc_counters.allocs++;
+  thread_alloc_counters.bytes += size;
+}
+
+extern "C" {
+void *malloc(std::size_t size) noexcept {
+  countAlloc(size);
+  return __libc_malloc(size);
+}
+void *calloc(std::size_t n, std::size_t size) noexcept {
+  countAlloc(n * size);
+  return __libc_calloc(n, size);
+}
+void *realloc(void *ptr, std::size_t size) noexcept {
+  countAlloc(size);
+  return __libc_realloc(ptr, size);
+}
+void free(void *ptr) noexcept { __libc_free(ptr); }
+void *memalign(std::size_t alignment, std::size_t size) noexcept {
+  countAlloc(size);
+  return __libc_memalign(alignment, size);
+}
+void *aligned_alloc(std::size_t alignment, std::size_t size) noexcept { return memalign(alignment, size); }
+int posix_memalign(void **ptr, std::size_t alignment, std::size_t size) noexcept {
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+  void *allocated = memalign(alignment, size);
+  if (!allocated) return ENOMEM;
+  *ptr = allocated;
+  return 0;
+}
+}
+
+static void *newAlloc(std::size_t size) {
+  void *ptr = std::malloc(size ? size : 1);
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+
+static void *newAlignedAlloc(std::size_t size, std::align_val_t alignment) {
+  void *ptr = memalign(static_cast<std::size_t>(alignment), size ? size : 1);
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new(std::size_t size) { return newAlloc(size); }
+void *operator new[](std::size_t size) { return newAlloc(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return std::malloc(size ? size : 1); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return std::malloc(size ? size : 1); }
+void *operator new(std::size_t size, std::align_val_t alignment) { return newAlignedAlloc(size, alignment); }
+void *operator new[](std::size_t size, std::align_val_t alignment) { return newAlignedAlloc(size, alignment); }
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+  return memalign(static_cast<std::size_t>(alignment), size ? size : 1);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+  return memalign(static_cast<std::size_t>(alignment), size ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept { std::free(ptr); }
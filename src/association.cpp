@@ -0,0 +1,226 @@
+#include "association.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+void Associator::solve(const std::vector<Eigen::Vector3d> &measurements, const std::vector<int> &measurement_classes,
+                       const std::vector<Eigen::Vector3d> &tracks, const std::vector<int> &track_classes,
+                       double gate, int max_component, std::vector<int> &assignment) {
+  const int n_measurements = static_cast<int>(measurements.size());
+  const int n_tracks = static_cast<int>(tracks.size());
+  n_measurements_ = n_measurements;
+  assignment.assign(n_measurements, -1);
+  components_ = 0;
+  largest_component_ = 0;
+  greedy_components_ = 0;
+  if (n_measurements == 0 || n_tracks == 0 || !(gate > 0)) {
+    return;
+  }
+
+  // measurements by gate sized cell, a pair within the gate is in neighbouring cells. Each
+  // track is one probe of the cells next to a measurement, only the close ones go further.
+  const float inv_cell = static_cast<float>(1.0 / gate);
+  cells_.clear();
+  Eigen::Vector3d lo = measurements[0], hi = measurements[0];
+  for (int m = 0; m < n_measurements; m++) {
+    const Eigen::Vector3d &p = measurements[m];
+    cells_.emplace_back(voxelKey(p.x(), p.y(), p.z(), inv_cell), m);
+    lo = lo.cwiseMin(p);
+    hi = hi.cwiseMax(p);
+  }
+  lo.array() -= gate;
+  hi.array() += gate;
+  std::sort(cells_.begin(), cells_.end());
+  if (27 * cells_.size() > near_.maxVoxels()) {
+    near_ = VoxelHash<uint8_t>(27 * cells_.size());
+  }
+  near_.clear();
+  for (const auto &cell : cells_) {
+    for (int dz = -1; dz <= 1; dz++) {
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) near_.findOrInsert(voxelNeighbour(cell.first, dx, dy, dz));
+      }
+    }
+  }
+
+  const double gate_sq = gate * gate;
+  edges_.clear();
+  track_nodes_.clear();
+  for (int t = 0; t < n_tracks; t++) {
+    const Eigen::Vector3d &p = tracks[t];
+    // the measurements of a frame are seen by one camera, most tracks are far from all of them
+    if ((p.x() < lo.x()) | (p.x() > hi.x()) | (p.y() < lo.y()) | (p.y() > hi.y()) | (p.z() < lo.z()) |
+        (p.z() > hi.z()) | (track_classes[t] < 0)) {
+      continue;
+    }
+    const uint64_t key = voxelKey(p.x(), p.y(), p.z(), inv_cell);
+    if (!near_.find(key)) continue;
+    const size_t first_edge = edges_.size();
+    const int node = n_measurements + static_cast<int>(track_nodes_.size());
+    for (int dz = -1; dz <= 1; dz++) {
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+          const uint64_t neighbour = voxelNeighbour(key, dx, dy, dz);
+          auto it = std::lower_bound(cells_.begin(), cells_.end(), std::make_pair(neighbour, -1));
+          for (; it != cells_.end() && it->first == neighbour; ++it) {
+            const int m = it->second;
+            if (track_classes[t] != measurement_classes[m]) continue;
+            const double cost = (measurements[m] - p).squaredNorm();
+            if (cost < gate_sq) edges_.push_back({m, t, node, cost, 0});
+          }
+        }
+      }
+    }
+    if (edges_.size() > first_edge) track_nodes_.push_back(t);
+  }
+  if (edges_.empty()) {
+    return;
+  }
+
+  // connected components of the gated pairs, the gated tracks follow the measurements
+  const int n_nodes = n_measurements + static_cast<int>(track_nodes_.size());
+  parent_.resize(n_nodes);
+  std::iota(parent_.begin(), parent_.end(), 0);
+  for (const auto &e : edges_) {
+    const int a = find(e.measurement), b = find(e.track_node);
+    if (a != b) parent_[a] = b;
+  }
+  for (auto &e : edges_) e.component = find(e.measurement);
+  std::sort(edges_.begin(), edges_.end(), [](const Edge &a, const Edge &b) {
+    if (a.component != b.component) return a.component < b.component;
+    return a.measurement != b.measurement ? a.measurement < b.measurement : a.track < b.track;
+  });
+
+  local_.assign(n_nodes, -1);
+  used_.assign(n_nodes, 0);
+  for (size_t begin = 0; begin < edges_.size();) {
+    size_t end = begin;
+    rows_.clear();
+    cols_.clear();
+    for (; end < edges_.size() && edges_[end].component == edges_[begin].component; end++) {
+      const Edge &e = edges_[end];
+      if (local_[e.measurement] < 0) {
+        local_[e.measurement] = static_cast<int>(rows_.size());
+        rows_.push_back(e.measurement);
+      }
+      if (local_[e.track_node] < 0) {
+        local_[e.track_node] = static_cast<int>(cols_.size());
+        cols_.push_back(e.track_node);
+      }
+    }
+
+    const int rows = static_cast<int>(rows_.size()), cols = static_cast<int>(cols_.size());
+    components_++;
+    largest_component_ = std::max(largest_component_, std::max(rows, cols));
+    if (rows == 1 && cols == 1) {
+      assignment[edges_[begin].measurement] = edges_[begin].track;
+    } else if (std::max(rows, cols) > max_component) {
+      greedy_components_++;
+      greedy(&edges_[begin], end - begin, assignment);
+    } else {
+      hungarian(&edges_[begin], end - begin, rows, cols, gate_sq, assignment);
+    }
+
+    for (int m : rows_) local_[m] = -1;
+    for (int node : cols_) local_[node] = -1;
+    begin = end;
+  }
+}
+
+int Associator::find(int node) {
+  while (parent_[node] != node) {
+    parent_[node] = parent_[parent_[node]];
+    node = parent_[node];
+  }
+  return node;
+}
+
+void Associator::hungarian(const Edge *edges, size_t n_edges, int rows, int cols, double gate_cost,
+                           std::vector<int> &assignment) {
+  // a row may take its own extra column at the gate cost, so a solution never needs a pair
+  // outside the gate and those cost more than leaving every row out
+  const int n_cols = cols + rows;
+  const double forbidden = 2.0 * (rows + 1) * gate_cost;
+  cost_.assign(size_t(rows) * n_cols, forbidden);
+  for (size_t k = 0; k < n_edges; k++) {
+    const Edge &e = edges[k];
+    cost_[size_t(local_[e.measurement]) * n_cols + local_[e.track_node]] = e.cost;
+  }
+  for (int i = 0; i < rows; i++) cost_[size_t(i) * n_cols + cols + i] = gate_cost;
+
+  // shortest augmenting paths with potentials, rows and columns are 1 based, column 0 and
+  // row 0 are the path roots
+  constexpr double inf = std::numeric_limits<double>::infinity();
+  u_.assign(rows + 1, 0.0);
+  v_.assign(n_cols + 1, 0.0);
+  match_.assign(n_cols + 1, 0);
+  way_.assign(n_cols + 1, 0);
+  for (int i = 1; i <= rows; i++) {
+    match_[0] = i;
+    int j0 = 0;
+    min_v_.assign(n_cols + 1, inf);
+    visited_.assign(n_cols + 1, 0);
+    do {
+      visited_[j0] = 1;
+      const int i0 = match_[j0];
+      const double *row = &cost_[size_t(i0 - 1) * n_cols];
+      double delta = inf;
+      int j1 = 0;
+      for (int j = 1; j <= n_cols; j++) {
+        if (visited_[j]) continue;
+        const double reduced = row[j - 1] - u_[i0] - v_[j];
+        if (reduced < min_v_[j]) {
+          min_v_[j] = reduced;
+          way_[j] = j0;
+        }
+        if (min_v_[j] < delta) {
+          delta = min_v_[j];
+          j1 = j;
+        }
+      }
+      for (int j = 0; j <= n_cols; j++) {
+        if (visited_[j]) {
+          u_[match_[j]] += delta;
+          v_[j] -= delta;
+        } else {
+          min_v_[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (match_[j0] != 0);
+    do {
+      const int j1 = way_[j0];
+      match_[j0] = match_[j1];
+      j0 = j1;
+    } while (j0);
+  }
+
+  for (int j = 1; j <= cols; j++) {
+    const int i = match_[j];
+    if (i && cost_[size_t(i - 1) * n_cols + j - 1] < forbidden) assignment[rows_[i - 1]] = trackOf(cols_[j - 1]);
+  }
+}
+
+void Associator::greedy(Edge *edges, size_t n_edges, std::vector<int> &assignment) {
+  std::sort(edges, edges + n_edges, [](const Edge &a, const Edge &b) {
+    if (a.cost != b.cost) return a.cost < b.cost;
+    return a.measurement != b.measurement ? a.measurement < b.measurement : a.track < b.track;
+  });
+  for (size_t k = 0; k < n_edges; k++) {
+    const Edge &e = edges[k];
+    if (used_[e.measurement] || used_[e.track_node]) continue;
+    used_[e.measurement] = 1;
+    used_[e.track_node] = 1;
+    assignment[e.measurement] = e.track;
+  }
+}
+
+size_t Associator::bytes() const {
+  return cells_.capacity() * sizeof(std::pair<uint64_t, int>) + near_.bytes() + edges_.capacity() * sizeof(Edge) +
+         (track_nodes_.capacity() + parent_.capacity() + local_.capacity() + rows_.capacity() + cols_.capacity() +
+          match_.capacity() + way_.capacity()) *
+             sizeof(int) +
+         used_.capacity() + visited_.capacity() +
+         (cost_.capacity() + u_.capacity() + v_.capacity() + min_v_.capacity()) * sizeof(double);
+}
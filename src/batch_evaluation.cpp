@@ -0,0 +1,165 @@
+#include "batch_evaluation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+static Eigen::Isometry3d poseAt(const double *poses, int frame) {
+  Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+  if (poses) {
+    pose.matrix() = Eigen::Map<const Eigen::Matrix<double, 4, 4, Eigen::RowMajor>>(poses + 16 * frame);
+  }
+  return pose;
+}
+
+BatchEvaluator::BatchEvaluator(const BatchConfig &config, std::string &error) : config_(config) {
+  if (config.width <= 0 || config.height <= 0 || config.k[0] <= 0 || config.k[4] <= 0) {
+    error = "camera intrinsics and size are required";
+    return;
+  }
+  std::string camera_error;
+  camera_ = makeCameraModel(config.distortion_model, config.k, config.d, config.width, config.height, camera_error);
+  if (camera_error != "") {
+    error = camera_error;
+    return;
+  }
+  // validated once here, every worker core is configured the same way
+  DepthtectionCore probe;
+  if (!probe.setEstimator(config.estimator)) {
+    error = "unknown estimator '" + config.estimator + "'";
+    return;
+  }
+  for (const auto &[class_name, estimator] : config.class_estimators) {
+    if (!probe.setEstimator(estimator, class_name)) {
+      error = "unknown estimator '" + estimator + "' for class '" + class_name + "'";
+      return;
+    }
+  }
+  valid_ = true;
+}
+
+std::unique_ptr<DepthtectionCore> BatchEvaluator::makeCore() const {
+  auto core = std::make_unique<DepthtectionCore>(config_.params);
+  core->setEstimator(config_.estimator);
+  for (const auto &[class_name, estimator] : config_.class_estimators) core->setEstimator(estimator, class_name);
+  core->setCamera(camera_);
+  return core;
+}
+
+bool BatchEvaluator::checkBoxes(const DepthBatch &depths, const BoxBatch &boxes, std::string &error) const {
+  if (!valid_) {
+    error = "evaluator not configured";
+    return false;
+  }
+  for (size_t i = 0; i < boxes.n; i++) {
+    const double *row = boxes.row(i);
+    // negated so NaN fails too, the indices must be whole
+    if (!(row[0] >= 0 && row[0] < depths.n_frames) || row[0] != std::floor(row[0])) {
+      error = "box " + std::to_string(i) + " refers to frame " + std::to_string(row[0]);
+      return false;
+    }
+    if (!(row[6] >= 0 && row[6] < static_cast<double>(config_.classes.size())) || row[6] != std::floor(row[6])) {
+      error = "box " + std::to_string(i) + " has class index " + std::to_string(row[6]);
+      return false;
+    }
+  }
+  return true;
+}
+
+BoundingBox BatchEvaluator::boxAt(const BoxBatch &boxes, size_t i) const {
+  const double *row = boxes.row(i);
+  BoundingBox box;
+  box.center_x = row[1];
+  box.center_y = row[2];
+  box.size_x = row[3];
+  box.size_y = row[4];
+  box.score = static_cast<float>(row[5]);
+  box.class_id = config_.classes[static_cast<size_t>(row[6])];
+  return box;
+}
+
+bool BatchEvaluator::estimate(const DepthBatch &depths, const BoxBatch &boxes, const double *poses, int n_threads,
+                              float *out_xyz, uint8_t *out_valid, std::string &error) const {
+  if (!checkBoxes(depths, boxes, error)) {
+    return false;
+  }
+  if (n_threads <= 0) {
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  n_threads = static_cast<int>(std::min<size_t>(n_threads, std::max<size_t>(boxes.n / 64, 1)));
+
+  // contiguous ranges, consecutive boxes usually share a frame and stay in cache
+  const auto work = [&](size_t begin, size_t end) {
+    auto core = makeCore();
+    for (size_t i = begin; i < end; i++) {
+      const int frame = boxes.frame(i);
+      const Eigen::Isometry3d pose = poseAt(poses, frame);
+      EstimatorFrame estimator_frame;
+      // a level camera without poses, its optical y axis points down
+      estimator_frame.up = poses ? (pose.linear().transpose() * Eigen::Vector3d::UnitZ()).cast<float>()
+                                 : Eigen::Vector3f(0.0f, -1.0f, 0.0f);
+      Eigen::Vector3f p;
+      out_valid[i] = core->estimateBox(depths.frame(frame), boxAt(boxes, i), estimator_frame, p);
+      if (!out_valid[i]) {
+        p.setConstant(std::numeric_limits<float>::quiet_NaN());
+      } else if (poses) {
+        p = (pose * p.cast<double>()).cast<float>();
+      }
+      out_xyz[3 * i] = p.x();
+      out_xyz[3 * i + 1] = p.y();
+      out_xyz[3 * i + 2] = p.z();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  const size_t chunk = (boxes.n + n_threads - 1) / n_threads;
+  for (int t = 1; t < n_threads; t++) {
+    const size_t begin = std::min(boxes.n, t * chunk);
+    workers.emplace_back(work, begin, std::min(boxes.n, begin + chunk));
+  }
+  work(0, std::min(boxes.n, chunk));
+  for (auto &worker : workers) worker.join();
+  return true;
+}
+
+bool BatchEvaluator::track(const DepthBatch &depths, const BoxBatch &boxes, const double *poses, const double *stamps,
+                           uint8_t *out_outcome, int32_t *out_track_id, float *out_xyz, std::string &error) const {
+  if (!checkBoxes(depths, boxes, error)) {
+    return false;
+  }
+  for (size_t i = 1; i < boxes.n; i++) {
+    if (boxes.frame(i) < boxes.frame(i - 1)) {
+      error = "boxes must be sorted by frame";
+      return false;
+    }
+  }
+
+  auto core = makeCore();
+  std::vector<BoundingBox> frame_boxes;
+  FrameResult result;
+  size_t first = 0;
+  for (int frame = 0; frame < depths.n_frames; frame++) {
+    size_t last = first;
+    frame_boxes.clear();
+    for (; last < boxes.n && boxes.frame(last) == frame; last++) frame_boxes.emplace_back(boxAt(boxes, last));
+    // frames without boxes still advance the prediction
+    core->processFrame(depths.frame(frame), frame_boxes, poseAt(poses, frame), stamps[frame], result);
+    for (size_t i = first; i < last; i++) {
+      const size_t j = i - first;
+      out_outcome[i] = static_cast<uint8_t>(result.outcomes[j]);
+      out_track_id[i] = result.track_ids[j];
+      Eigen::Vector3d p = Eigen::Vector3d::Constant(std::numeric_limits<double>::quiet_NaN());
+      for (const auto &candidates : {&result.created, &result.updated}) {
+        for (const auto &candidate : *candidates) {
+          if (candidate->id == result.track_ids[j]) p = candidate->point.position;
+        }
+      }
+      out_xyz[3 * i] = p.x();
+      out_xyz[3 * i + 1] = p.y();
+      out_xyz[3 * i + 2] = p.z();
+    }
+    first = last;
+  }
+  return true;
+}
@@ -0,0 +1,31 @@
+#include "camera_model.hpp"
+
+#include <algorithm>
+
+CameraModel makeCameraModel(const std::string &distortion_model, const double *k, const std::vector<double> &d,
+                            int width, int height, std::string &error) {
+  const PinholeModel intrinsics(k[0], k[4], k[2], k[5]);
+  if (std::all_of(d.begin(), d.end(), [](double c) { return c == 0.0; })) {
+    return intrinsics;
+  }
+  const auto coefficient = [&](size_t i) { return i < d.size() ? static_cast<float>(d[i]) : 0.0f; };
+  if (distortion_model == PlumbBobDistortion::name) {
+    PlumbBobDistortion distortion;
+    distortion.k1 = coefficient(0);
+    distortion.k2 = coefficient(1);
+    distortion.p1 = coefficient(2);
+    distortion.p2 = coefficient(3);
+    distortion.k3 = coefficient(4);
+    return DistortedModel<PlumbBobDistortion>(intrinsics, distortion, width, height);
+  }
+  if (distortion_model == EquidistantDistortion::name) {
+    EquidistantDistortion distortion;
+    distortion.k1 = coefficient(0);
+    distortion.k2 = coefficient(1);
+    distortion.k3 = coefficient(2);
+    distortion.k4 = coefficient(3);
+    return DistortedModel<EquidistantDistortion>(intrinsics, distortion, width, height);
+  }
+  error = "unsupported distortion model '" + distortion_model + "', ignoring distortion";
+  return intrinsics;
+}
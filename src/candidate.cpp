@@ -1,13 +1,14 @@
 #include <candidate.hpp>
 
+#include <algorithm>
+#include <iterator>
+
 Candidate::Ptr match_candidate(const Candidate::Vec &candidate_list, std::string_view class_name,
-                               geometry_msgs::msg::PointStamped point, double max_distance) {
+                               const Eigen::Vector3d &position, double max_distance) {
   double min_distance = std::numeric_limits<double>::max();
   for (auto &candidate : candidate_list) {
     if (candidate->class_name == class_name) {
-      double distance = std::sqrt(std::pow(point.point.x - candidate->point.point.x, 2) +
-                                  std::pow(point.point.y - candidate->point.point.y, 2) +
-                                  std::pow(point.point.z - candidate->point.point.z, 2));
+      const double distance = (position - candidate->getPredictedEigen()).norm();
       if (distance < min_distance && distance < max_distance) {
         min_distance = distance;
         return candidate;
@@ -17,3 +18,73 @@ Candidate::Ptr match_candidate(const Candidate::Vec &candidate_list, std::string
   return nullptr;
 };
 
+
+void fuse_candidates(Candidate &kept, const Candidate &removed) {
+  const double total = std::max(kept.confidence + removed.confidence, 1e-6f);
+  const double w_kept = kept.confidence / total;
+  const double w_removed = removed.confidence / total;
+  kept.table->fuse(kept.slot, removed.slot, w_kept, w_removed);
+  kept.syncFromTable();
+  kept.confidence = std::max(kept.confidence, removed.confidence);
+  // a track this vehicle measured is its own, and shared again, whichever side is kept
+  kept.remote = kept.remote && removed.remote;
+}
+
+int CandidateMerger::step(Candidate::Vec &candidates, Candidate::Ptr &best) {
+  int n_merges = 0;
+  size_t checks = 0;
+  if (anchor_ + 1 >= sweep_order_.size()) {
+    // full sweep done, start again over the current positions. The sort is charged to this
+    // call, which leaves the sweep to the next ones when it takes the whole budget.
+    restart(candidates);
+    checks = sweep_order_.size();
+  }
+  while (checks < max_checks_ && anchor_ + 1 < sweep_order_.size()) {
+    checks++;
+    auto &a = sweep_order_[anchor_];
+    if (next_ >= sweep_order_.size() || a->merged ||
+        sweep_order_[next_]->point.position.x() - a->point.position.x() > merge_radius_) {
+      anchor_++;
+      next_ = anchor_ + 1;
+      continue;
+    }
+    auto &b = sweep_order_[next_++];
+    if (b->merged || a->class_name != b->class_name || (a->getEigen() - b->getEigen()).norm() > merge_radius_) {
+      continue;
+    }
+
+    Candidate::Ptr kept = a->confidence >= b->confidence ? a : b;
+    Candidate::Ptr removed = kept == a ? b : a;
+    fuse_candidates(*kept, *removed);
+    removed->merged = true;
+    removed->table->remove(removed->slot);
+    if (best == removed) {
+      best = kept;
+    }
+    n_merges++;
+  }
+  if (n_merges) {
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                    [](const Candidate::Ptr &c) { return c->merged; }),
+                     candidates.end());
+  }
+  return n_merges;
+}
+
+void CandidateMerger::restart(const Candidate::Vec &candidates) {
+  // tracks dropped since the last sweep leave the order, the ones created since join it
+  sweep_order_.erase(std::remove_if(sweep_order_.begin(), sweep_order_.end(),
+                                    [](const Candidate::Ptr &c) { return c->merged; }),
+                     sweep_order_.end());
+  auto first_new = candidates.end();
+  while (first_new != candidates.begin() && (*(first_new - 1))->id > newest_id_) --first_new;
+  if (first_new != candidates.end()) {
+    newest_id_ = candidates.back()->id;
+    sweep_order_.insert(sweep_order_.end(), first_new, candidates.end());
+  }
+  std::sort(sweep_order_.begin(), sweep_order_.end(), [](const Candidate::Ptr &a, const Candidate::Ptr &b) {
+    return a->point.position.x() < b->point.position.x();
+  });
+  anchor_ = 0;
+  next_ = 1;
+}
@@ -0,0 +1,56 @@
+#include "close_range.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+PixelRect closeRangeRoi(int width, int height, double roi_fraction) {
+  PixelRect r;
+  r.width = std::max(1, static_cast<int>(width * roi_fraction));
+  r.height = std::max(1, static_cast<int>(height * roi_fraction));
+  r.x = (width - r.width) / 2;
+  r.y = (height - r.height) / 2;
+  return r.clipped(width, height);
+}
+
+bool CloseRangeEstimator::estimate(const DepthView &depth, const CameraModel &camera,
+                                   const CloseRangeParams &params, Eigen::Vector3f &out) {
+  const PixelRect roi = closeRangeRoi(depth.width, depth.height, params.roi_fraction);
+  const int step = std::max(1, static_cast<int>(std::sqrt(double(roi.area()) / MAX_SAMPLES)));
+  size_t n_pixels = 0;
+  samples_.clear();
+  std::visit(
+      [&](const auto &model) {
+        for (int v = roi.y; v < roi.y + roi.height; v += step) {
+          const float *row = depth.row(v);
+          for (int u = roi.x; u < roi.x + roi.width; u += step) {
+            n_pixels++;
+            if (row[u] >= params.min_depth && std::isfinite(row[u])) {
+              const Eigen::Vector3f p = model.backProject(u, v, row[u]);
+              samples_.push_back({p.x(), p.y(), p.z()});
+            }
+          }
+        }
+      },
+      camera);
+
+  if (samples_.empty() || samples_.size() < params.min_fill * n_pixels) {
+    invalid_frames_++;
+    return false;
+  }
+
+  const auto nearest = samples_.begin() + static_cast<size_t>(params.percentile * (samples_.size() - 1));
+  std::nth_element(samples_.begin(), nearest, samples_.end(),
+                   [](const Point3f &a, const Point3f &b) { return a.z < b.z; });
+  const float limit = nearest->z + params.near_band;
+  Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+  int n = 0;
+  for (const auto &p : samples_) {
+    if (p.z <= limit) {
+      sum += Eigen::Vector3f(p.x, p.y, p.z);
+      n++;
+    }
+  }
+  out = sum / n;
+  invalid_frames_ = 0;
+  return true;
+}
@@ -0,0 +1,260 @@
+#include "compressed_depth.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// compressed_depth_image_transport ConfigHeader
+struct CompressedDepthConfig {
+  int32_t format;
+  float depth_quant_a;
+  float depth_quant_b;
+};
+
+// Longest image side accepted, the dimensions come from the stream
+static constexpr uint32_t MAX_IMAGE_SIDE = 1 << 15;
+
+RowRanges mergeRowRanges(RowRanges ranges, int n_rows) {
+  for (auto &range : ranges) {
+    range.first = std::clamp(range.first, 0, n_rows);
+    range.second = std::clamp(range.second, 0, n_rows);
+  }
+  ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [](const auto &r) { return r.first >= r.second; }),
+               ranges.end());
+  std::sort(ranges.begin(), ranges.end());
+  RowRanges merged;
+  for (const auto &range : ranges) {
+    if (!merged.empty() && range.first <= merged.back().second) {
+      merged.back().second = std::max(merged.back().second, range.second);
+    } else {
+      merged.emplace_back(range);
+    }
+  }
+  return merged;
+}
+
+CompressedDepthDecoder::~CompressedDepthDecoder() { pngRelease(); }
+
+bool CompressedDepthDecoder::reset(const std::string &format, const uint8_t *data, size_t size, std::string &error) {
+  pngRelease();
+  rvl_row_index_.clear();
+
+  const auto encoding = format.substr(0, format.find(';'));
+  if (encoding == "32FC1") {
+    inverse_depth_ = true;
+  } else if (encoding == "16UC1") {
+    inverse_depth_ = false;
+  } else {
+    error = "unsupported compressed depth encoding '" + encoding + "'";
+    return false;
+  }
+  if (format.find("compressedDepth") == std::string::npos) {
+    error = "not a compressedDepth image: '" + format + "'";
+    return false;
+  }
+  rvl_ = format.find("rvl") != std::string::npos;
+
+  CompressedDepthConfig config;
+  if (size < sizeof(config)) {
+    error = "truncated compressedDepth header";
+    return false;
+  }
+  std::memcpy(&config, data, sizeof(config));
+  depth_quant_a_ = config.depth_quant_a;
+  depth_quant_b_ = config.depth_quant_b;
+  payload_ = data + sizeof(config);
+  payload_size_ = size - sizeof(config);
+
+  if (rvl_) {
+    uint32_t dims[2];
+    if (payload_size_ < sizeof(dims)) {
+      error = "truncated RVL header";
+      return false;
+    }
+    std::memcpy(dims, payload_, sizeof(dims));
+    if (dims[0] == 0 || dims[1] == 0 || dims[0] > MAX_IMAGE_SIDE || dims[1] > MAX_IMAGE_SIDE) {
+      error = "invalid RVL image size";
+      return false;
+    }
+    width_ = dims[0];
+    height_ = dims[1];
+    rvl_row_index_.reserve(height_ + 1);
+    RvlState start;
+    start.word_pos = sizeof(dims);
+    rvl_row_index_.emplace_back(start);
+    return true;
+  }
+  return pngStart(error);
+}
+
+bool CompressedDepthDecoder::decodeRows(const RowRanges &rows, float *depth, size_t stride, std::string &error) {
+  if (!payload_) {
+    error = "no image";
+    return false;
+  }
+  const auto merged = mergeRowRanges(rows, height_);
+  if (merged.empty()) {
+    return true;
+  }
+  return rvl_ ? rvlDecodeRows(merged, depth, stride, error) : pngDecodeRows(merged, depth, stride, error);
+}
+
+/* RVL (A. Wilson, "Fast Lossless Depth Image Compression", 2017): runs of zeros and non zeros,
+   non zero values as zigzag deltas, all counts and deltas as variable length 3 bit nibbles
+   packed in 32 bit words. */
+
+bool CompressedDepthDecoder::rvlDecodeVLE(RvlState &state, int &value) const {
+  uint32_t nibble;
+  int bits = 29;
+  value = 0;
+  do {
+    if (!state.nibbles) {
+      if (state.word_pos + 4 > payload_size_) return false;
+      std::memcpy(&state.word, payload_ + state.word_pos, 4);
+      state.word_pos += 4;
+      state.nibbles = 8;
+    }
+    nibble = state.word & 0xf0000000;
+    value |= (nibble << 1) >> bits;
+    state.word <<= 4;
+    state.nibbles--;
+    bits -= 3;
+  } while ((nibble & 0x80000000) && bits >= 0);
+  return true;
+}
+
+// Advances one row. row may be null to only parse it.
+bool CompressedDepthDecoder::rvlDecodeRow(RvlState &state, float *row) const {
+  int u = 0;
+  while (u < width_) {
+    if (state.zeros) {
+      const int n = std::min(state.zeros, width_ - u);
+      if (row) std::fill(row + u, row + u + n, 0.0f);
+      state.zeros -= n;
+      u += n;
+    } else if (state.nonzeros) {
+      int positive;
+      if (!rvlDecodeVLE(state, positive)) return false;
+      const int delta = (positive >> 1) ^ -(positive & 1);
+      state.previous = static_cast<int16_t>(state.previous + delta);
+      if (row) row[u] = toMetres(static_cast<uint16_t>(state.previous));
+      state.nonzeros--;
+      u++;
+    } else {
+      if (!rvlDecodeVLE(state, state.zeros) || !rvlDecodeVLE(state, state.nonzeros)) return false;
+      if (state.zeros < 0 || state.nonzeros < 0) return false;
+    }
+  }
+  return true;
+}
+
+bool CompressedDepthDecoder::rvlDecodeRows(const RowRanges &rows, float *depth, size_t stride, std::string &error) {
+  for (const auto &range : rows) {
+    // resume from the furthest known row not past the start of the range
+    int v = std::min<int>(range.first, rvl_row_index_.size() - 1);
+    RvlState state = rvl_row_index_[v];
+    for (; v < range.second; v++) {
+      float *row = v >= range.first ? depth + v * stride : nullptr;
+      if (!rvlDecodeRow(state, row)) {
+        error = "truncated RVL stream at row " + std::to_string(v);
+        return false;
+      }
+      if (v + 1 == static_cast<int>(rvl_row_index_.size())) rvl_row_index_.emplace_back(state);
+    }
+  }
+  return true;
+}
+
+void CompressedDepthDecoder::pngRead(png_structp png, png_bytep out, png_size_t length) {
+  auto *self = static_cast<CompressedDepthDecoder *>(png_get_io_ptr(png));
+  if (self->png_pos_ + length > self->payload_size_) {
+    png_error(png, "truncated PNG stream");
+  }
+  std::memcpy(out, self->payload_ + self->png_pos_, length);
+  self->png_pos_ += length;
+}
+
+bool CompressedDepthDecoder::pngStart(std::string &error) {
+  png_ = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  png_info_ = png_ ? png_create_info_struct(png_) : nullptr;
+  if (!png_info_) {
+    error = "could not create the PNG decoder";
+    pngRelease();
+    return false;
+  }
+  if (setjmp(png_jmpbuf(png_))) {
+    error = "invalid PNG header";
+    pngRelease();
+    return false;
+  }
+  png_pos_ = 0;
+  png_next_row_ = 0;
+  png_set_read_fn(png_, this, &CompressedDepthDecoder::pngRead);
+  png_set_user_limits(png_, MAX_IMAGE_SIDE, MAX_IMAGE_SIDE);
+  png_read_info(png_, png_info_);
+  if (png_get_bit_depth(png_, png_info_) != 16 || png_get_color_type(png_, png_info_) != PNG_COLOR_TYPE_GRAY) {
+    error = "compressedDepth PNG must be 16 bit grayscale";
+    pngRelease();
+    return false;
+  }
+  width_ = png_get_image_width(png_, png_info_);
+  height_ = png_get_image_height(png_, png_info_);
+  png_interlaced_ = png_get_interlace_type(png_, png_info_) != PNG_INTERLACE_NONE;
+  // PNG stores big endian samples
+  const uint16_t one = 1;
+  if (*reinterpret_cast<const uint8_t *>(&one) == 1) png_set_swap(png_);
+  if (png_interlaced_) png_set_interlace_handling(png_);
+  png_read_update_info(png_, png_info_);
+  png_row_.resize(width_);
+  return true;
+}
+
+bool CompressedDepthDecoder::pngDecodeRows(const RowRanges &rows, float *depth, size_t stride, std::string &error) {
+  if (rows.front().first < png_next_row_ || (png_interlaced_ && png_next_row_ > 0)) {
+    // deflate cannot seek back
+    pngRelease();
+    if (!pngStart(error)) {
+      return false;
+    }
+  }
+  // Adam7 spreads every row over the whole stream, interlaced images are decoded whole
+  std::vector<uint16_t> image(png_interlaced_ ? size_t(width_) * height_ : 0);
+  std::vector<png_bytep> pointers(png_interlaced_ ? height_ : 0);
+  for (size_t v = 0; v < pointers.size(); v++) pointers[v] = reinterpret_cast<png_bytep>(&image[v * width_]);
+
+  if (setjmp(png_jmpbuf(png_))) {
+    error = "corrupted PNG stream";
+    pngRelease();
+    return false;
+  }
+
+  if (png_interlaced_) {
+    const int passes = png_set_interlace_handling(png_);
+    for (int pass = 0; pass < passes; pass++) {
+      for (int v = 0; v < height_; v++) png_read_row(png_, pointers[v], nullptr);
+    }
+    for (const auto &range : rows) {
+      for (int v = range.first; v < range.second; v++) {
+        for (int u = 0; u < width_; u++) depth[v * stride + u] = toMetres(image[size_t(v) * width_ + u]);
+      }
+    }
+    png_next_row_ = height_;
+    return true;
+  }
+
+  for (const auto &range : rows) {
+    for (; png_next_row_ < range.second; png_next_row_++) {
+      png_read_row(png_, reinterpret_cast<png_bytep>(png_row_.data()), nullptr);
+      if (png_next_row_ < range.first) continue;
+      float *row = depth + png_next_row_ * stride;
+      for (int u = 0; u < width_; u++) row[u] = toMetres(png_row_[u]);
+    }
+  }
+  // the rest of the stream is never inflated
+  return true;
+}
+
+void CompressedDepthDecoder::pngRelease() {
+  if (png_) png_destroy_read_struct(&png_, png_info_ ? &png_info_ : nullptr, nullptr);
+  png_ = nullptr;
+  png_info_ = nullptr;
+}
@@ -0,0 +1,113 @@
+#include "depth_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static DepthBoxStats finishStats(uint32_t valid, uint32_t area, double sum, double sum_sq) {
+  DepthBoxStats stats;
+  stats.valid = valid;
+  stats.area = area;
+  if (valid) {
+    stats.mean = sum / valid;
+    stats.variance = std::max(0.0, sum_sq / valid - stats.mean * stats.mean);
+  }
+  return stats;
+}
+
+// d if it is positive and finite, else 0. Tested on the bits, float compares may trap and
+// keep the loop from vectorizing.
+static inline float maskedDepth(float d, uint32_t &valid) {
+  uint32_t bits;
+  std::memcpy(&bits, &d, sizeof(bits));
+  valid = bits - 1 < 0x7f7fffffu;
+  bits &= 0u - valid;
+  std::memcpy(&d, &bits, sizeof(d));
+  return d;
+}
+
+DepthBoxStats depthBoxStats(const DepthView &depth, PixelRect box) {
+  box = box.clipped(depth.width, depth.height);
+  double sum = 0.0, sum_sq = 0.0;
+  uint32_t valid = 0;
+  for (int v = box.y; v < box.y + box.height; v++) {
+    const float *row = depth.row(v);
+    for (int u = box.x; u < box.x + box.width; u++) {
+      const float d = row[u];
+      if (d > 0 && std::isfinite(d)) {
+        sum += d;
+        sum_sq += double(d) * d;
+        valid++;
+      }
+    }
+  }
+  return finishStats(valid, box.area(), sum, sum_sq);
+}
+
+void DepthIntegral::build(const DepthView &depth, int row_begin, int row_end) {
+  cols_ = depth.width;
+  rows_ = depth.height;
+  row_begin_ = std::clamp(row_begin, 0, depth.height);
+  row_end_ = std::clamp(row_end, row_begin_, depth.height);
+  const size_t size = size_t(row_end_ - row_begin_ + 1) * (cols_ + 1);
+  sum_.resize(size);
+  sum_sq_.resize(size);
+  count_.resize(size);
+  std::fill_n(sum_.begin(), cols_ + 1, 0.0);
+  std::fill_n(sum_sq_.begin(), cols_ + 1, 0.0);
+  std::fill_n(count_.begin(), cols_ + 1, 0);
+  col_sum_.assign(cols_, 0.0);
+  col_sum_sq_.assign(cols_, 0.0);
+  col_count_.assign(cols_, 0);
+
+  // locals, the table stores could otherwise alias cols_ and the column sums
+  const int cols = cols_;
+  double *col_sum = col_sum_.data(), *col_sum_sq = col_sum_sq_.data();
+  uint32_t *col_count = col_count_.data();
+  double *sum = sum_.data(), *sum_sq = sum_sq_.data();
+  uint32_t *count = count_.data();
+  for (int v = row_begin_; v < row_end_; v++) {
+    const float *row = depth.row(v);
+    // element wise into the column sums, vectorizes
+    for (int u = 0; u < cols; u++) {
+      uint32_t valid;
+      const double x = maskedDepth(row[u], valid);
+      col_sum[u] += x;
+      col_sum_sq[u] += x * x;
+      col_count[u] += valid;
+    }
+
+    const size_t here = index(v + 1, 0);
+    double line_sum = 0.0, line_sum_sq = 0.0;
+    uint32_t line_count = 0;
+    sum[here] = 0.0;
+    sum_sq[here] = 0.0;
+    count[here] = 0;
+    for (int u = 0; u < cols; u++) {
+      line_sum += col_sum[u];
+      line_sum_sq += col_sum_sq[u];
+      line_count += col_count[u];
+      sum[here + u + 1] = line_sum;
+      sum_sq[here + u + 1] = line_sum_sq;
+      count[here + u + 1] = line_count;
+    }
+  }
+  built_ = true;
+}
+
+bool DepthIntegral::covers(const PixelRect &box) const {
+  const PixelRect clipped = box.clipped(cols_, rows_);
+  return built_ && clipped.y >= row_begin_ && clipped.y + clipped.height <= row_end_;
+}
+
+DepthBoxStats DepthIntegral::stats(PixelRect box) const {
+  box = box.clipped(cols_, rows_);
+  if (box.empty()) {
+    return DepthBoxStats();
+  }
+  const int v0 = box.y, v1 = box.y + box.height, u0 = box.x, u1 = box.x + box.width;
+  const auto area_sum = [&](const auto &table) {
+    return table[index(v1, u1)] - table[index(v0, u1)] - table[index(v1, u0)] + table[index(v0, u0)];
+  };
+  return finishStats(area_sum(count_), box.area(), area_sum(sum_), area_sum(sum_sq_));
+}
@@ -1,5 +1,7 @@
 #include "depthtection.hpp"
 
+#include <cmath>
+#include <cstring>
 #include <rclcpp/logging.hpp>
 
 static void showImage(const std::string &title, const cv::Mat &img) {
@@ -13,11 +15,32 @@ static void showImage(const std::string &title, const cv::Mat &img) {
   cv::waitKey(1);
 }
 
-static pcl::PointCloud<pcl::PointXYZ>::Ptr obtainPointCloudFromDepthCrop(const cv::Mat &depth, const cv::Mat &K,
-                                                                         const cv::Mat &D);
-
-static cv::Vec3f get_point_from_depth(const cv::Mat &depth_img, const cv::Point &point, const cv::Mat &K,
-                                      const cv::Mat &D);
+static bool pointCloudViewOf(const sensor_msgs::msg::PointCloud2 &msg, PointCloudView &view, std::string &error) {
+  int found = 0;
+  for (const auto &field : msg.fields) {
+    if (field.name.size() != 1 || field.name[0] < 'x' || field.name[0] > 'z') continue;
+    if (field.datatype != sensor_msgs::msg::PointField::FLOAT32) {
+      error = "xyz fields must be FLOAT32";
+      return false;
+    }
+    view.offset[field.name[0] - 'x'] = field.offset;
+    found |= 1 << (field.name[0] - 'x');
+  }
+  if (found != 7) {
+    error = "cloud without xyz fields";
+    return false;
+  }
+  if (msg.is_bigendian) {
+    error = "big endian clouds are not supported";
+    return false;
+  }
+  view.width = msg.width;
+  view.height = msg.height;
+  view.point_step = msg.point_step;
+  view.row_step = msg.row_step;
+  view.data = msg.data.data();
+  return validatePointCloudView(view, msg.data.size(), error);
+}
 
 Depthtection::Depthtection() : Node("depthtection") {
   // Declare node parameters
@@ -29,7 +52,67 @@ Depthtection::Depthtection() : Node("depthtection") {
   this->declare_parameter<bool>("show_detection", false);
   this->declare_parameter<std::string>("target_object", "small_blue_box");
   this->declare_parameter<double>("same_object_distance_threshold", 0.6);
+  this->declare_parameter<int>("association_max_component", 32);
   this->declare_parameter<std::string>("phase_topic", "/phase");
+  this->declare_parameter<std::string>("depth_transport", "raw");
+  this->declare_parameter<double>("detection_filter.min_score", 0.0);
+  this->declare_parameter<std::vector<std::string>>("detection_filter.classes", std::vector<std::string>());
+  this->declare_parameter<double>("detection_filter.min_size", 0.0);
+  this->declare_parameter<double>("detection_filter.max_size", 0.0);
+  this->declare_parameter<int>("detection_filter.max_detections", 0);
+  this->declare_parameter<double>("sync_tolerance", 0.0);
+  this->declare_parameter<double>("sync_window", 1.0);
+  this->declare_parameter<bool>("sync_depth_only", false);
+  this->declare_parameter<std::string>("cloud_transport", "raw");
+  this->declare_parameter<std::string>("estimator", "top_slab");
+  this->declare_parameter<std::vector<std::string>>("class_estimators", std::vector<std::string>());
+  const EstimatorParams estimator_defaults;
+  this->declare_parameter<double>("estimator_params.slab_thickness", estimator_defaults.slab_thickness);
+  this->declare_parameter<double>("estimator_params.depth_band", estimator_defaults.depth_band);
+  this->declare_parameter<double>("estimator_params.mode_bin", estimator_defaults.mode_bin);
+  this->declare_parameter<double>("estimator_params.mode_min_fraction", estimator_defaults.mode_min_fraction);
+  this->declare_parameter<double>("estimator_params.cluster_radius", estimator_defaults.cluster_radius);
+  this->declare_parameter<int>("roi_history_points", 4096);
+  this->declare_parameter<double>("roi_history_window", 0.3);
+  this->declare_parameter<int>("min_roi_points", 20);
+  this->declare_parameter<double>("roi_voxel_size", 0.0);
+  this->declare_parameter<int>("depth_stats_min_detections", 4);
+  this->declare_parameter<double>("detection_min_depth_fill", 0.05);
+  this->declare_parameter<double>("detection_min_depth", 0.1);
+  this->declare_parameter<double>("detection_max_depth", 50.0);
+  this->declare_parameter<double>("detection_max_depth_std", 0.0);
+  const ReacquisitionParams reacquisition_defaults;
+  this->declare_parameter<int>("reacquisition_after", 10);
+  this->declare_parameter<int>("reacquisition.max_cells", reacquisition_defaults.max_cells);
+  this->declare_parameter<double>("reacquisition.height_tolerance", reacquisition_defaults.height_tolerance);
+  this->declare_parameter<double>("reacquisition.size_tolerance", reacquisition_defaults.size_tolerance);
+  this->declare_parameter<double>("reacquisition.depth_jump", reacquisition_defaults.depth_jump);
+  this->declare_parameter<double>("reacquisition.default_extent", reacquisition_defaults.default_extent);
+  const CloseRangeParams close_range_defaults;
+  this->declare_parameter<double>("close_range_distance", 0.2);
+  this->declare_parameter<double>("close_range_exit_distance", 0.35);
+  this->declare_parameter<double>("close_range.roi_fraction", close_range_defaults.roi_fraction);
+  this->declare_parameter<double>("close_range.percentile", close_range_defaults.percentile);
+  this->declare_parameter<double>("close_range.near_band", close_range_defaults.near_band);
+  this->declare_parameter<double>("close_range.min_fill", close_range_defaults.min_fill);
+  this->declare_parameter<int>("close_range.max_invalid_frames", close_range_defaults.max_invalid_frames);
+  this->declare_parameter<double>("metrics_period", 1.0);
+  this->declare_parameter<bool>("benchmark_mode", false);
+  this->declare_parameter<std::string>("track_log_path", "");
+  this->declare_parameter<int>("track_log_records_per_file", 1000000);
+  this->declare_parameter<int>("track_log_files", 4);
+  this->declare_parameter<double>("merge_radius", 0.5);
+  this->declare_parameter<double>("merge_period", 0.2);
+  this->declare_parameter<int>("merge_max_checks", 64);
+  this->declare_parameter<bool>("track_sharing", false);
+  this->declare_parameter<int>("vehicle_id", 0);
+  this->declare_parameter<std::string>("track_sharing_topic", "/depthtection/track_digest");
+  this->declare_parameter<double>("track_sharing_period", 1.0);
+  this->declare_parameter<double>("track_sharing_min_confidence", 0.5);
+  this->declare_parameter<double>("remote_track_weight", 0.2);
+  this->declare_parameter<double>("remote_track_timeout", 5.0);
+  this->declare_parameter<std::string>("shm_input", "");
+  this->declare_parameter<double>("shm_poll_period", 0.002);
 
   // Read parameters
   std::string camera_topic, detection_topic, computed_pose_topic, ground_truth_topic, phase_topic;
@@ -45,11 +128,88 @@ Depthtection::Depthtection() : Node("depthtection") {
   this->get_parameter("same_object_distance_threshold", same_object_distance_threshold_);
 
   this->get_parameter("phase_topic", phase_topic);
+  double metrics_period;
+  bool benchmark_mode;
+  this->get_parameter("metrics_period", metrics_period);
+  this->get_parameter("benchmark_mode", benchmark_mode);
 
   RCLCPP_WARN(this->get_logger(), "TARGET OBJECT: %s", target_object_.c_str());
   RCLCPP_WARN(this->get_logger(), "SAME OBJECT DISTANCE THRESHOLD: %f", same_object_distance_threshold_);
 
 
+  // Detection pipeline, the ROS free part of the node
+  CoreParams core_params;
+  core_params.same_object_distance = same_object_distance_threshold_;
+  this->get_parameter("association_max_component", core_params.association_max_component);
+  auto &estimator_params = core_params.estimator_params;
+  estimator_params.slab_thickness = this->get_parameter("estimator_params.slab_thickness").as_double();
+  estimator_params.depth_band = this->get_parameter("estimator_params.depth_band").as_double();
+  estimator_params.mode_bin = this->get_parameter("estimator_params.mode_bin").as_double();
+  estimator_params.mode_min_fraction = this->get_parameter("estimator_params.mode_min_fraction").as_double();
+  estimator_params.cluster_radius = this->get_parameter("estimator_params.cluster_radius").as_double();
+  std::string estimator_error;
+  if (!validEstimatorParams(estimator_params, estimator_error)) {
+    RCLCPP_ERROR(this->get_logger(), "Invalid estimator_params, %s, using the defaults", estimator_error.c_str());
+    estimator_params = EstimatorParams();
+  }
+  this->get_parameter("depth_stats_min_detections", core_params.depth_stats_min_detections);
+  this->get_parameter("detection_min_depth_fill", core_params.min_depth_fill);
+  this->get_parameter("detection_min_depth", core_params.min_depth);
+  this->get_parameter("detection_max_depth", core_params.max_depth);
+  this->get_parameter("detection_max_depth_std", core_params.max_depth_std);
+  auto &reacquisition = core_params.reacquisition;
+  this->get_parameter("reacquisition_after", reacquisition_after_);
+  this->get_parameter("reacquisition.max_cells", reacquisition.max_cells);
+  this->get_parameter("reacquisition.height_tolerance", reacquisition.height_tolerance);
+  this->get_parameter("reacquisition.size_tolerance", reacquisition.size_tolerance);
+  this->get_parameter("reacquisition.depth_jump", reacquisition.depth_jump);
+  this->get_parameter("reacquisition.default_extent", reacquisition.default_extent);
+  auto &close_range = core_params.close_range;
+  this->get_parameter("close_range_distance", close_range_distance_);
+  this->get_parameter("close_range_exit_distance", close_range_exit_distance_);
+  this->get_parameter("close_range.roi_fraction", close_range.roi_fraction);
+  this->get_parameter("close_range.percentile", close_range.percentile);
+  this->get_parameter("close_range.near_band", close_range.near_band);
+  this->get_parameter("close_range.min_fill", close_range.min_fill);
+  this->get_parameter("close_range.max_invalid_frames", close_range.max_invalid_frames);
+  core_ = std::make_unique<DepthtectionCore>(core_params);
+
+  // without an allowlist only the target class is tracked
+  DetectionFilterParams filter_params;
+  double min_score;
+  this->get_parameter("detection_filter.min_score", min_score);
+  filter_params.min_score = static_cast<float>(min_score);
+  this->get_parameter("detection_filter.classes", filter_params.classes);
+  if (filter_params.classes.empty()) {
+    filter_params.classes.push_back(target_object_);
+  }
+  this->get_parameter("detection_filter.min_size", filter_params.min_size);
+  this->get_parameter("detection_filter.max_size", filter_params.max_size);
+  this->get_parameter("detection_filter.max_detections", filter_params.max_detections);
+  detection_filter_ = std::make_unique<DetectionFilter>(filter_params);
+
+  // 3D estimators, resolved to compile-time policies once here
+  std::string estimator;
+  std::vector<std::string> class_estimators;
+  this->get_parameter("estimator", estimator);
+  this->get_parameter("class_estimators", class_estimators);
+  if (!core_->setEstimator(estimator)) {
+    RCLCPP_ERROR(this->get_logger(), "Unknown estimator %s, using top_slab", estimator.c_str());
+  }
+  // entries as "class_name:estimator"
+  for (const auto &entry : class_estimators) {
+    const auto sep = entry.rfind(':');
+    if (sep == std::string::npos || !core_->setEstimator(entry.substr(sep + 1), entry.substr(0, sep))) {
+      RCLCPP_ERROR(this->get_logger(), "Ignoring class estimator '%s'", entry.c_str());
+    }
+  }
+  RCLCPP_INFO(this->get_logger(), "ESTIMATOR: %s",
+              std::string(PointEstimators::name(core_->estimatorFor(""))).c_str());
+  this->get_parameter("roi_history_points", roi_history_points_);
+  this->get_parameter("roi_history_window", roi_history_window_);
+  this->get_parameter("min_roi_points", min_roi_points_);
+  this->get_parameter("roi_voxel_size", roi_voxel_size_);
+
   // Check topic name format
   if (camera_topic.back() == '/') camera_topic.pop_back();
 
@@ -60,17 +220,78 @@ Depthtection::Depthtection() : Node("depthtection") {
         camera_topic + "/image_raw", 10, std::bind(&Depthtection::rgbImageCallback, this, std::placeholders::_1));
   } */
 
-  rgb_image_sub_ = std::make_shared<message_filters::Subscriber<sensor_msgs::msg::Image>>(
-      this, camera_topic + "/image_raw", rclcpp::QoS(10).get_rmw_qos_profile());
-
-  depth_img_sub_ = std::make_shared<message_filters::Subscriber<sensor_msgs::msg::Image>>(
-      this, camera_topic + "/depth", rclcpp::QoS(10).get_rmw_qos_profile());
-  detection_sub_ = std::make_shared<message_filters::Subscriber<vision_msgs::msg::Detection2DArray>>(
-      this, detection_topic, rclcpp::QoS(10).get_rmw_qos_profile());
-
-  synchronizer_ = std::make_shared<message_filters::Synchronizer<sync_policy>>(
-      sync_policy(1), *(rgb_image_sub_.get()), *(depth_img_sub_.get()), *(detection_sub_.get()));
-  synchronizer_->registerCallback(&Depthtection::imagesAndDetectionCallback, this);
+  // Detection path and cloud refinement get their own callback groups so the executor setup in
+  // depthtection_node.cpp can give them different threads and priorities
+  detection_group_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+  cloud_group_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+  rclcpp::SubscriptionOptions detection_options;
+  detection_options.callback_group = detection_group_;
+  rclcpp::SubscriptionOptions cloud_options;
+  cloud_options.callback_group = cloud_group_;
+
+  // depth and detections are matched by stamp, in any arrival order and with the detector
+  // behind the camera by up to sync_window. The rgb is only needed to draw the detections.
+  double sync_tolerance, sync_window;
+  bool depth_only;
+  this->get_parameter("sync_tolerance", sync_tolerance);
+  this->get_parameter("sync_window", sync_window);
+  this->get_parameter("sync_depth_only", depth_only);
+  if (depth_only && show_detection_) {
+    RCLCPP_WARN(this->get_logger(), "show_detection needs the rgb image, ignoring sync_depth_only");
+    depth_only = false;
+  }
+  const int64_t tolerance_ns = std::llround(sync_tolerance * 1e9);
+  const int64_t window_ns = std::llround(sync_window * 1e9);
+  const std::array<bool, 3> required = {!depth_only, true, true};
+
+  std::string depth_transport;
+  this->get_parameter("depth_transport", depth_transport);
+  if (depth_transport == "compressedDepth") {
+    RCLCPP_INFO(this->get_logger(), "Decoding compressed depth from %s/depth/compressedDepth", camera_topic.c_str());
+    compressed_sync_ = std::make_unique<CompressedSync>(
+        tolerance_ns, window_ns, required,
+        [this](const sensor_msgs::msg::Image::SharedPtr &rgb, const sensor_msgs::msg::CompressedImage::SharedPtr &depth,
+               const vision_msgs::msg::Detection2DArray::SharedPtr &detections) {
+          imagesAndCompressedDetectionCallback(rgb, depth, detections);
+        });
+    sync_stats_ = &compressed_sync_->stats();
+    compressed_depth_sub_ = this->create_subscription<sensor_msgs::msg::CompressedImage>(
+        camera_topic + "/depth/compressedDepth", rclcpp::QoS(10),
+        std::bind(&Depthtection::compressedDepthCallback, this, std::placeholders::_1), detection_options);
+  } else if (depth_transport == "serialized") {
+    RCLCPP_INFO(this->get_logger(), "Reading serialized depth from %s/depth in place", camera_topic.c_str());
+    serialized_sync_ = std::make_unique<SerializedSync>(
+        tolerance_ns, window_ns, required,
+        [this](const sensor_msgs::msg::Image::SharedPtr &rgb, const std::shared_ptr<rclcpp::SerializedMessage> &depth,
+               const vision_msgs::msg::Detection2DArray::SharedPtr &detections) {
+          processSerializedDepth(rgb, depth, detections);
+        });
+    sync_stats_ = &serialized_sync_->stats();
+    serialized_depth_sub_ = this->create_subscription<sensor_msgs::msg::Image>(
+        camera_topic + "/depth", rclcpp::QoS(10),
+        std::bind(&Depthtection::serializedDepthCallback, this, std::placeholders::_1), detection_options);
+  } else {
+    image_sync_ = std::make_unique<ImageSync>(
+        tolerance_ns, window_ns, required,
+        [this](const sensor_msgs::msg::Image::SharedPtr &rgb, const sensor_msgs::msg::Image::SharedPtr &depth,
+               const vision_msgs::msg::Detection2DArray::SharedPtr &detections) {
+          imagesAndDetectionCallback(rgb, depth, detections);
+        });
+    sync_stats_ = &image_sync_->stats();
+    depth_img_sub_ = this->create_subscription<sensor_msgs::msg::Image>(
+        camera_topic + "/depth", rclcpp::QoS(10),
+        std::bind(&Depthtection::rawDepthCallback, this, std::placeholders::_1), detection_options);
+  }
+  if (!depth_only) {
+    rgb_image_sub_ = this->create_subscription<sensor_msgs::msg::Image>(
+        camera_topic + "/image_raw", rclcpp::QoS(10),
+        std::bind(&Depthtection::syncedRgbCallback, this, std::placeholders::_1), detection_options);
+  } else {
+    RCLCPP_INFO(this->get_logger(), "Matching depth and detections only, without the rgb image");
+  }
+  detection_sub_ = this->create_subscription<vision_msgs::msg::Detection2DArray>(
+      detection_topic, rclcpp::QoS(10),
+      std::bind(&Depthtection::syncedDetectionCallback, this, std::placeholders::_1), detection_options);
 
   /* depth_img_sub_ = this->create_subscription<sensor_msgs::msg::Image>(
       camera_topic + "/depth", 10, std::bind(&Depthtection::depthImageCallback, this, std::placeholders::_1)); */
@@ -81,9 +302,29 @@ Depthtection::Depthtection() : Node("depthtection") {
       detection_topic, rclcpp::SensorDataQoS(),
       std::bind(&Depthtection::detectionCallback, this, std::placeholders::_1));
  */
-  point_cloud_sub_ = this->create_subscription<sensor_msgs::msg::PointCloud2>(
-      camera_topic + "/points", rclcpp::SensorDataQoS(),
-      std::bind(&Depthtection::pointCloudCallback, this, std::placeholders::_1));
+  std::string cloud_transport;
+  this->get_parameter("cloud_transport", cloud_transport);
+  if (cloud_transport == "serialized") {
+    // the cloud is filtered straight from the middleware buffer, never deserialized
+    RCLCPP_INFO(this->get_logger(), "Reading serialized point cloud from %s/points in place", camera_topic.c_str());
+    point_cloud_sub_ = this->create_subscription<sensor_msgs::msg::PointCloud2>(
+        camera_topic + "/points", rclcpp::SensorDataQoS(),
+        std::bind(&Depthtection::serializedPointCloudCallback, this, std::placeholders::_1), cloud_options);
+  } else {
+    point_cloud_sub_ = this->create_subscription<sensor_msgs::msg::PointCloud2>(
+        camera_topic + "/points", rclcpp::SensorDataQoS(),
+        std::bind(&Depthtection::pointCloudCallback, this, std::placeholders::_1), cloud_options);
+  }
+
+  // Frames written to shared memory by a local producer skip the middleware entirely
+  this->get_parameter("shm_input", shm_input_);
+  if (shm_input_ != "") {
+    double shm_poll_period;
+    this->get_parameter("shm_poll_period", shm_poll_period);
+    RCLCPP_INFO(this->get_logger(), "Reading depth frames and detections from shared memory %s", shm_input_.c_str());
+    shm_timer_ = this->create_wall_timer(std::chrono::duration<double>(shm_poll_period),
+                                         std::bind(&Depthtection::shmPollCallback, this), detection_group_);
+  }
 
   if (ground_truth_topic != "") {
     RCLCPP_INFO(this->get_logger(), "GT PROVIDED Subscribing to %s", ground_truth_topic.c_str());
@@ -95,6 +336,71 @@ Depthtection::Depthtection() : Node("depthtection") {
   // Topic publication
   pose_pub_ = this->create_publisher<geometry_msgs::msg::PoseStamped>(computed_pose_topic, rclcpp::QoS(10));
 
+  // Pipeline metrics, published along the rest of the diagnostics
+  if (benchmark_mode) {
+    if (PerfCounters::forThisThread().valid()) {
+      RCLCPP_WARN(this->get_logger(), "BENCHMARK MODE: sampling hardware counters per stage");
+      metrics_.enablePerfCounters(true);
+    } else {
+      RCLCPP_WARN(this->get_logger(), "BENCHMARK MODE: perf_event_open not permitted, check perf_event_paranoid");
+    }
+  }
+  if (metrics_period > 0.0) {
+    diagnostics_pub_ = this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("/diagnostics", 10);
+    metrics_timer_ = this->create_wall_timer(std::chrono::duration<double>(metrics_period),
+                                             std::bind(&Depthtection::publishMetrics, this));
+  }
+
+  // Duplicate track merging
+  double merge_radius, merge_period;
+  int merge_max_checks;
+  this->get_parameter("merge_radius", merge_radius);
+  this->get_parameter("merge_period", merge_period);
+  this->get_parameter("merge_max_checks", merge_max_checks);
+  if (merge_period > 0.0 && merge_radius > 0.0) {
+    core_->setMerger(merge_radius, merge_max_checks);
+    merge_timer_ = this->create_wall_timer(std::chrono::duration<double>(merge_period),
+                                           std::bind(&Depthtection::mergeCandidates, this));
+  }
+
+  // Track sharing between vehicles
+  bool track_sharing;
+  this->get_parameter("track_sharing", track_sharing);
+  if (track_sharing) {
+    std::string track_sharing_topic;
+    double track_sharing_period;
+    this->get_parameter("vehicle_id", vehicle_id_);
+    this->get_parameter("track_sharing_topic", track_sharing_topic);
+    this->get_parameter("track_sharing_period", track_sharing_period);
+    this->get_parameter("track_sharing_min_confidence", track_sharing_min_confidence_);
+    this->get_parameter("remote_track_weight", remote_track_weight_);
+    double remote_track_timeout;
+    this->get_parameter("remote_track_timeout", remote_track_timeout);
+    remote_track_timeout_ns_ = std::llround(remote_track_timeout * 1e9);
+    RCLCPP_INFO(this->get_logger(), "Sharing tracks as vehicle %d on %s", vehicle_id_, track_sharing_topic.c_str());
+    track_digest_pub_ = this->create_publisher<std_msgs::msg::UInt8MultiArray>(track_sharing_topic, rclcpp::QoS(1));
+    track_digest_sub_ = this->create_subscription<std_msgs::msg::UInt8MultiArray>(
+        track_sharing_topic, rclcpp::QoS(10),
+        std::bind(&Depthtection::trackDigestCallback, this, std::placeholders::_1));
+    track_sharing_timer_ = this->create_wall_timer(std::chrono::duration<double>(track_sharing_period),
+                                                   std::bind(&Depthtection::publishTrackDigest, this));
+  }
+
+  // Track history log
+  std::string track_log_path;
+  this->get_parameter("track_log_path", track_log_path);
+  if (track_log_path != "") {
+    int records_per_file, n_files;
+    this->get_parameter("track_log_records_per_file", records_per_file);
+    this->get_parameter("track_log_files", n_files);
+    std::string error;
+    if (track_log_.open(track_log_path, records_per_file, n_files, error)) {
+      RCLCPP_INFO(this->get_logger(), "Logging track history to %s_*.bin", track_log_path.c_str());
+    } else {
+      RCLCPP_ERROR(this->get_logger(), "Track history disabled: %s", error.c_str());
+    }
+  }
+
   // TF listening
   tfCamCatched_ = false;
   tfImuCatched_ = false;
@@ -109,34 +415,52 @@ Depthtection::Depthtection() : Node("depthtection") {
 Depthtection::~Depthtection(void) { cv::destroyAllWindows(); }
 
 void Depthtection::rgbImageCallback(const sensor_msgs::msg::Image::SharedPtr msg) {
+  // not synchronized in depth-only mode
+  if (!msg) {
+    return;
+  }
   // convert to cv::Mat
   cv_bridge::CvImagePtr cv_ptr = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::BGR8);
   rgb_img_ = cv_ptr->image;
+  publishImageBytes();
 }
 
 void Depthtection::depthImageCallback(const sensor_msgs::msg::Image::SharedPtr msg) {
   // convert to cv::Mat
   cv_bridge::CvImagePtr cv_ptr = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::TYPE_32FC1);
   depth_img_ = cv_ptr->image;
+  publishImageBytes();
 }
 
 void Depthtection::cameraInfoCallback(const sensor_msgs::msg::CameraInfo::SharedPtr msg) {
-  if (!haveCalibration_) {
-    K_ = cv::Mat(3, 3, CV_64FC1, (void *)msg->k.data()).clone();
-    D_ = cv::Mat(msg->d.size(), 1, CV_64FC1, (void *)msg->d.data()).clone();
-    imgSize_.width = msg->width;
-    imgSize_.height = msg->height;
-    haveCalibration_ = true;
+  // the default group runs beside the detection and cloud ones, which read the camera under the lock
+  {
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+    if (core_->hasCamera()) {
+      return;
+    }
   }
+  // the ray table of the distorted models takes a few hundred ms to build, done outside the lock
+  std::string error;
+  CameraModel camera = makeCameraModel(msg->distortion_model, msg->k.data(), msg->d, msg->width, msg->height, error);
+  if (error != "") {
+    RCLCPP_WARN(this->get_logger(), "Camera model: %s", error.c_str());
+  }
+  RCLCPP_INFO(this->get_logger(), "CAMERA MODEL: %s", std::string(cameraModelName(camera)).c_str());
+  std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+  core_->setCamera(std::move(camera));
+  imgSize_.width = msg->width;
+  imgSize_.height = msg->height;
 }
 
 void Depthtection::detectionCallback(const vision_msgs::msg::Detection2DArray::SharedPtr msg) {
-  // check if image is available
-  if (rgb_img_.empty()) {
+  // check if image is available, only needed for drawing
+  if (show_detection_ && rgb_img_.empty()) {
     RCLCPP_WARN(this->get_logger(), "No RGB image available");
     return;
   }
 
+  boxes_.clear();
   for (auto &detection : msg->detections) {
     if (show_detection_) {
       auto center = detection.bbox.center;
@@ -148,73 +472,68 @@ void Depthtection::detectionCallback(const vision_msgs::msg::Detection2DArray::S
       cv::putText(rgb_img_, std::string(detection.id), cv::Point(center.x - width / 2, center.y - height / 2),
                   cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 1);
     }
-    if (detection.results[0].hypothesis.class_id != target_object_) {
+    if (detection.results.empty()) {
       continue;
     }
+    BoundingBox box;
+    box.class_id = detection.results[0].hypothesis.class_id;
+    box.score = detection.results[0].hypothesis.score;
+    box.center_x = detection.bbox.center.x;
+    box.center_y = detection.bbox.center.y;
+    box.size_x = detection.bbox.size_x;
+    box.size_y = detection.bbox.size_y;
+    boxes_.emplace_back(box);
+  }
 
-    if (depth_img_.empty() || !haveCalibration_) {
+  if (!boxes_.empty()) {
+    if (depth_img_.empty() || !core_->hasCamera()) {
       RCLCPP_WARN(this->get_logger(), "No camera calibration available");
       current_phase_ = Phase::VISUAL_DETECTION_WITHOUT_DEPTH;
-      return;
+      boxes_.clear();
+    } else {
+      current_phase_ = Phase::VISUAL_DETECTION_WITH_DEPTH;
     }
-    current_phase_ = Phase::VISUAL_DETECTION_WITH_DEPTH;
-    const auto &hypothesis = detection.results[0].hypothesis;
-    auto point = extractEstimatedPoint(depth_img_, detection);
-    try {
-      tf2::Stamped<tf2::Transform> transform;
-      geometry_msgs::msg::TransformStamped tf;
-      tf = tfBuffer_->lookupTransform("earth", msg->header.frame_id, tf2::TimePointZero);
-      tf2::fromMsg(tf, transform);
-      tf2::Vector3 v(point.point.x, point.point.y, point.point.z);
-
-      tf2::Matrix3x3 R(0, 0, 1, -1, 0, 0, 0, -1, 0);
-      tf2::Transform camLink, aux;
-      camLink.setIdentity();
-      camLink.setBasis(R);
-      aux = transform * camLink;
-
-      transform.setData(aux);
-      v = transform * v;
-      point.header.frame_id = "earth";
-      point.header.stamp = msg->header.stamp;
-      point.point.x = v.x();
-      point.point.y = v.y();
-      point.point.z = v.z();
-    } catch (tf2::TransformException &ex) {
-      RCLCPP_WARN(this->get_logger(), "TF exception: %s", ex.what());
-      return;
+  }
+
+  // a track the cloud lost is searched for in the whole frame until something finds it again
+  bool reacquire = reacquiring_ && best_candidate_ && !depth_img_.empty() && core_->hasCamera();
+
+  Eigen::Isometry3d optical_to_earth = Eigen::Isometry3d::Identity();
+  if ((!boxes_.empty() || reacquire) && !opticalToEarth(msg->header.frame_id, optical_to_earth)) {
+    boxes_.clear();
+    reacquire = false;
+  }
+
+  const DepthView depth{depth_img_.ptr<float>(), depth_img_.cols, depth_img_.rows, depth_img_.step1()};
+  core_->processFrame(depth, boxes_, optical_to_earth, rclcpp::Time(msg->header.stamp).seconds(), frame_result_);
+  for (const auto &candidate : frame_result_.created) {
+    RCLCPP_INFO(this->get_logger(), "New candidate %d", candidate->id);
+    logTrack(*candidate, TrackSource::DETECTION);
+  }
+  for (const auto &candidate : frame_result_.updated) {
+    logTrack(*candidate, TrackSource::DETECTION);
+    if (candidate == best_candidate_) {
+      new_detection_ = true;
+      reacquire = false;
+      reacquiring_ = false;
+      roi_misses_ = 0;
+      pubCandidate(best_candidate_);
     }
-    auto candidate = match_candidate(candidates_, hypothesis.class_id, point,same_object_distance_threshold_);
-    /* static int n_detections = 0;
-    if (n_detections < 5 ) {
-      n_detections += 1;
-      return;
-    } */
+  }
 
-    // auto candidate = match_candidate(candidates_, hypothesis.class_id, point);
-    if (!candidate) {
-      candidates_.emplace_back(std::make_shared<Candidate>(candidates_.size() + 1, hypothesis.score,
-                                                           hypothesis.class_id, point, this->get_clock()));
-      RCLCPP_INFO(this->get_logger(), "New candidate %s", detection.id.c_str());
-    } else {
-      candidate->confidence = (candidate->confidence + hypothesis.score) / 2;
-      candidate->updatePoint(point);
-
-      // candidate->point = point;
-      /* RCLCPP_INFO(this->get_logger(), "Update candidate %s", detection.id.c_str());
-      RCLCPP_INFO(this->get_logger(), "Candidate %s", candidate->class_name.c_str());
-      RCLCPP_INFO(this->get_logger(), "Candidate point %f %f %f", candidate->point.point.x,
-                  candidate->point.point.y, candidate->point.point.z); */
-
-      if (candidate == best_candidate_) {
-        new_detection_ = true;
-        pubCandidate(best_candidate_);
-      }
+  if (reacquire) {
+    ScopedStage stage(metrics_, Stage::REACQUISITION);
+    if (core_->reacquire(depth, optical_to_earth, best_candidate_, rclcpp::Time(msg->header.stamp).seconds())) {
+      RCLCPP_INFO(this->get_logger(), "Re-acquired candidate %d", best_candidate_->id);
+      reacquiring_ = false;
+      roi_misses_ = 0;
+      logTrack(*best_candidate_, TrackSource::REACQUISITION);
+      pubCandidate(best_candidate_);
     }
   }
 
-  if (!best_candidate_ && candidates_.size()) {
-    best_candidate_ = candidates_[0];
+  if (!best_candidate_ && core_->tracks().size()) {
+    best_candidate_ = core_->tracks()[0];
   }
 
   if (show_detection_) {
@@ -222,48 +541,111 @@ void Depthtection::detectionCallback(const vision_msgs::msg::Detection2DArray::S
   }
 }
 
-geometry_msgs::msg::PointStamped Depthtection::extractEstimatedPoint(const cv::Mat &depth_img,
-                                                                     const vision_msgs::msg::Detection2D &detection) {
-  geometry_msgs::msg::PointStamped point_msg;
+bool Depthtection::opticalToEarth(const std::string &frame_id, Eigen::Isometry3d &optical_to_earth) {
+  try {
+    tf2::Stamped<tf2::Transform> transform;
+    tf2::fromMsg(tfBuffer_->lookupTransform("earth", frame_id, tf2::TimePointZero), transform);
+    tf2::Transform camLink;
+    camLink.setIdentity();
+    camLink.setBasis(tf2::Matrix3x3(0, 0, 1, -1, 0, 0, 0, -1, 0));
+    const tf2::Transform optical = transform * camLink;
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) optical_to_earth.linear()(i, j) = optical.getBasis()[i][j];
+    }
+    optical_to_earth.translation() << optical.getOrigin().x(), optical.getOrigin().y(), optical.getOrigin().z();
+  } catch (tf2::TransformException &ex) {
+    RCLCPP_WARN(this->get_logger(), "TF exception: %s", ex.what());
+    return false;
+  }
+  return true;
+}
 
-  auto center = detection.bbox.center;
-  auto point = get_point_from_depth(depth_img, cv::Point(center.x, center.y), K_, D_);
+bool Depthtection::tooNear(const Eigen::Vector3d &target) {
+  tf2::Stamped<tf2::Transform> base;
+  try {
+    tf2::fromMsg(tfBuffer_->lookupTransform("earth", base_frame_, tf2::TimePointZero), base);
+  } catch (tf2::TransformException &ex) {
+    return false;
+  }
+  const Eigen::Vector3d base_position(base.getOrigin().x(), base.getOrigin().y(), base.getOrigin().z());
+  return (target - base_position).norm() < close_range_distance_;
+}
 
-  point_msg.point.x = point[0];
-  point_msg.point.y = point[1];
-  point_msg.point.z = point[2];
-  return point_msg;
+void Depthtection::enterCloseRange() {
+  RCLCPP_WARN(this->get_logger(), "TOO_NEAR_TO_DETECT, tracking from the central depth ROI");
+  current_phase_ = Phase::TOO_NEAR_TO_DETECT;
+  core_->resetCloseRange();
+  close_range_ = true;
 }
 
-// obtain 3D point from depth image
-cv::Vec3f get_point_from_depth(const cv::Mat &depth_img, const cv::Point &point, const cv::Mat &K, const cv::Mat &D) {
-  double depth = depth_img.at<float>(point.y, point.x);
-  if (depth == 0 || depth == std::numeric_limits<float>::infinity()) {
-    return cv::Vec3f(0, 0, 0);
+void Depthtection::closeRangeFrame(const DepthView &depth, const std_msgs::msg::Header &header) {
+  ScopedStage stage(metrics_, Stage::CLOSE_RANGE);
+  std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+  Eigen::Isometry3d optical_to_earth = Eigen::Isometry3d::Identity();
+  if (!best_candidate_ || !core_->hasCamera() || !opticalToEarth(header.frame_id, optical_to_earth)) {
+    return;
   }
-  // undistort point using camera calibration
-
-  // TODO: check distortion model
-  cv::Vec2f point_undistorted;
+  double range;
+  const bool measured =
+      core_->closeRangeUpdate(depth, optical_to_earth, best_candidate_, rclcpp::Time(header.stamp).seconds(), range);
+  if (measured) {
+    logTrack(*best_candidate_, TrackSource::CLOSE_RANGE);
+    pubCandidate(best_candidate_);
+  }
+  if ((measured && range > close_range_exit_distance_) || core_->closeRangeLost()) {
+    RCLCPP_INFO(this->get_logger(), "Leaving close range mode, back to the point cloud");
+    current_phase_ = Phase::ONLY_DEPTH_DETECTION;
+    close_range_ = false;
+  }
+}
 
-  auto cx = K.at<double>(0, 2);
-  auto cy = K.at<double>(1, 2);
-  auto fx = K.at<double>(0, 0);
-  auto fy = K.at<double>(1, 1);
+void Depthtection::closeRangeDepthCallback(const sensor_msgs::msg::Image::ConstSharedPtr &msg) {
+  if (!close_range_ || !on_running_) {
+    return;
+  }
+  if (msg->encoding == sensor_msgs::image_encodings::TYPE_32FC1 && !msg->is_bigendian) {
+    // read in place, the whole callback is a few hundred pixels
+    closeRangeFrame(DepthView{reinterpret_cast<const float *>(msg->data.data()), static_cast<int>(msg->width),
+                              static_cast<int>(msg->height), msg->step / sizeof(float)},
+                    msg->header);
+    return;
+  }
+  const cv::Mat depth = cv_bridge::toCvCopy(msg, sensor_msgs::image_encodings::TYPE_32FC1)->image;
+  closeRangeFrame(DepthView{depth.ptr<float>(), depth.cols, depth.rows, depth.step1()}, msg->header);
+}
 
-  auto x = (point.x - cx) * depth / fx;
-  auto y = (point.y - cy) * depth / fy;
-  auto z = depth;
+template <typename Decoder>
+bool Depthtection::decodeCloseRangeRows(Decoder &decoder, std::string &error) {
+  if (close_range_img_.rows != decoder.height() || close_range_img_.cols != decoder.width()) {
+    close_range_img_ = cv::Mat::zeros(decoder.height(), decoder.width(), CV_32FC1);
+  }
+  // only the rows of the central ROI are ever read
+  const PixelRect roi = closeRangeRoi(decoder.width(), decoder.height(), core_->params().close_range.roi_fraction);
+  return decoder.decodeRows(RowRanges{{roi.y, roi.y + roi.height}}, close_range_img_.ptr<float>(),
+                            close_range_img_.step1(), error);
+}
 
-  return cv::Vec3f(x, y, z);
+void Depthtection::closeRangeCompressedCallback(const sensor_msgs::msg::CompressedImage::ConstSharedPtr &msg) {
+  if (!close_range_ || !on_running_) {
+    return;
+  }
+  std::string error;
+  if (!depth_decoder_.reset(msg->format, msg->data.data(), msg->data.size(), error) ||
+      !decodeCloseRangeRows(depth_decoder_, error)) {
+    RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 5000, "Close range depth: %s", error.c_str());
+    return;
+  }
+  closeRangeFrame(DepthView{close_range_img_.ptr<float>(), close_range_img_.cols, close_range_img_.rows,
+                            close_range_img_.step1()},
+                  msg->header);
 }
 
 bool Depthtection::updateCandidateFromPointCloud(const Candidate::Ptr &candidate,
-                                                 const pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud) {
+                                                 const std::vector<Point3f> &points,
+                                                 const Eigen::Vector3f &sensor,
+                                                 const builtin_interfaces::msg::Time &stamp) {
   // WARN HERE POINT CLOUD MUST BE IN EARTH FRAME
 
-  // EASY WAY for testing
-  // find the point with the highest z value
   if (!new_detection_) {
     n_images_without_detection_++;
   } else {
@@ -279,47 +661,10 @@ bool Depthtection::updateCandidateFromPointCloud(const Candidate::Ptr &candidate
     // return false;
   }
 
-  auto max_z = -std::numeric_limits<float>::max();
-  auto max_idx = 0;
-  for (auto i = 0; i < cloud->size(); i++) {
-    if (cloud->points[i].z > max_z) {
-      max_z = cloud->points[i].z;
-      max_idx = i;
-    }
-  }
-
-  double max_z_point = cloud->points[max_idx].z;
-
-  // get the centroid of the pointcloud with z values between max_z and max_z - 0.2
-  auto centroid = cv::Point3f(0, 0, 0);
-  auto n_points = 0;
-  for (auto i = 0; i < cloud->size(); i++) {
-    if (cloud->points[i].z > max_z - 0.1 && cloud->points[i].z < max_z) {
-      centroid.x += cloud->points[i].x;
-      centroid.y += cloud->points[i].y;
-      centroid.z += cloud->points[i].z;
-      n_points++;
-    }
+  if (!core_->updateFromPoints(candidate, points, sensor, rclcpp::Time(stamp).seconds())) {
+    return false;
   }
-  centroid.x /= n_points;
-  centroid.y /= n_points;
-  centroid.z /= n_points;
-  // RCLCPP_INFO(this->get_logger(), "Centroid %f %f %f", centroid.x, centroid.y, centroid.z);
-
-  geometry_msgs::msg::PointStamped point_msg;
-  /* point_msg.point.x = cloud->points[max_idx].x;
-  point_msg.point.y = cloud->points[max_idx].y;
-  point_msg.point.z = cloud->points[max_idx].z; */
-  point_msg.point.x = centroid.x;
-  point_msg.point.y = centroid.y;
-  point_msg.point.z = centroid.z;
-  point_msg.header.frame_id = "earth";
-  point_msg.header.stamp = this->now();
-
-  candidate->updatePoint(point_msg);
-  // candidate->x() = cloud->points[max_idx].x;
-  // candidate->y() = cloud->points[max_idx].y;
-  // candidate->z() = cloud->points[max_idx].z;
+  logTrack(*candidate, TrackSource::POINT_CLOUD);
 
   /* RCLCPP_INFO(this->get_logger(), "[PC] Candidate point %f %f %f", candidate->x(),
      candidate->y(), candidate->z()); */
@@ -327,128 +672,493 @@ bool Depthtection::updateCandidateFromPointCloud(const Candidate::Ptr &candidate
   return true;
 }
 
+void Depthtection::roiMissed() {
+  if (reacquisition_after_ > 0 && ++roi_misses_ == reacquisition_after_) {
+    RCLCPP_WARN(this->get_logger(), "Track lost by the cloud ROI, scanning the full depth frame");
+    reacquiring_ = true;
+  }
+}
+
 void Depthtection::pointCloudCallback(const sensor_msgs::msg::PointCloud2::SharedPtr msg) {
-  if (current_phase_ != Phase::VISUAL_DETECTION_WITH_DEPTH && current_phase_ != Phase::ONLY_DEPTH_DETECTION) {
+  PointCloudView cloud;
+  std::string error;
+  {
+    ScopedStage stage(metrics_, Stage::CLOUD_CONVERSION);
+    if (!pointCloudViewOf(*msg, cloud, error)) {
+      RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 5000, "Point cloud: %s", error.c_str());
+      return;
+    }
+    stage.setItems(cloud.size());
+  }
+  processPointCloud(cloud, msg->header);
+}
+
+void Depthtection::serializedPointCloudCallback(const std::shared_ptr<rclcpp::SerializedMessage> msg) {
+  PointCloudView cloud;
+  std::string error;
+  {
+    ScopedStage stage(metrics_, Stage::CLOUD_CONVERSION);
+    const auto &buffer = msg->get_rcl_serialized_message();
+    if (!parseSerializedPointCloud(buffer.buffer, buffer.buffer_length, cloud, error)) {
+      RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 5000, "Point cloud: %s", error.c_str());
+      return;
+    }
+    stage.setItems(cloud.size());
+  }
+  std_msgs::msg::Header header;
+  header.stamp = rclcpp::Time(cloud.stamp_ns);
+  header.frame_id = cloud.frame_id;
+  processPointCloud(cloud, header);
+}
+
+void Depthtection::processPointCloud(const PointCloudView &cloud, const std_msgs::msg::Header &header) {
+  // the cloud is filtered without holding the lock so detections are not blocked by it
+  Candidate::Ptr best_candidate;
+  Eigen::Vector3d candidate_vec;
+  {
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+    if (current_phase_ != Phase::VISUAL_DETECTION_WITH_DEPTH && current_phase_ != Phase::ONLY_DEPTH_DETECTION) {
+      return;
+    }
+    if (!best_candidate_) {
+      return;
+    }
+    best_candidate = best_candidate_;
+    candidate_vec = best_candidate_->getEigen();
+  }
+  if (close_range_) {
+    // the central depth ROI replaces the cloud until the target moves away
     return;
   }
-  if (!best_candidate_) {
+  if (tooNear(candidate_vec)) {
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+    enterCloseRange();
     return;
   }
 
-  auto cloud = pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>);
-  pcl::fromROSMsg(*msg, *cloud);
-
   // filter cloud when z > 0 in earth frame
   tf2::Stamped<tf2::Transform> earthTf;
-  tf2::Stamped<tf2::Transform> base_frame_Tf;
   try {
     geometry_msgs::msg::TransformStamped tf;
-    tf = tfBuffer_->lookupTransform("earth", msg->header.frame_id, tf2::TimePointZero);
+    tf = tfBuffer_->lookupTransform("earth", header.frame_id, tf2::TimePointZero);
     tf2::fromMsg(tf, earthTf);
-    tf = tfBuffer_->lookupTransform(base_frame_, msg->header.frame_id, tf2::TimePointZero);
-    tf2::fromMsg(tf, base_frame_Tf);
   } catch (tf2::TransformException &ex) {
-    RCLCPP_ERROR_ONCE(this->get_logger(), "Could not transform %s to %s: %s", "earth", msg->header.frame_id.c_str(),
+    RCLCPP_ERROR_ONCE(this->get_logger(), "Could not transform %s to %s: %s", "earth", header.frame_id.c_str(),
                       ex.what());
     return;
   }
+  Eigen::Affine3f to_earth = Eigen::Affine3f::Identity();
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) to_earth.linear()(i, j) = earthTf.getBasis()[i][j];
+  }
+  to_earth.translation() << earthTf.getOrigin().x(), earthTf.getOrigin().y(), earthTf.getOrigin().z();
 
   pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered(new pcl::PointCloud<pcl::PointXYZ>);
-  cloud_filtered->points.reserve(cloud->points.size());
-
-  for (auto &point : cloud->points) {
-    tf2::Vector3 pointLidar(point.x, point.y, point.z);
-    const tf2::Vector3 pointEarth = earthTf * pointLidar;
-    const tf2::Vector3 pointBase = base_frame_Tf * pointLidar;
-
-    // check NaN values
-    if (!std::isfinite(pointEarth.x()) || !std::isfinite(pointEarth.y()) || !std::isfinite(pointEarth.z())) {
-      continue;
-    }
-
-    const auto candidate_vec = best_candidate_->getEigen();
-    const Eigen::Vector3d earthPoint(pointEarth.x(), pointEarth.y(), pointEarth.z());
-
-    // point must be inside an shpere of radius 0.5m around the best candidate
-    // else continue with next point
-    if ((earthPoint - candidate_vec).norm() > same_object_distance_threshold_) {
-      continue;
-    }
-    cloud_filtered->points.emplace_back(pointEarth.x(), pointEarth.y(), pointEarth.z());
+  {
+    ScopedStage stage(metrics_, Stage::CLOUD_FILTER);
+    stage.setItems(cloud.size());
+    // points must be inside a sphere around the best candidate, read in place from the message
+    filterPointCloudSphere(cloud, to_earth, candidate_vec.cast<float>(), same_object_distance_threshold_,
+                           cloud_filtered->points);
+    cloud_filtered->width = cloud_filtered->points.size();
+    cloud_filtered->height = 1;
   }
+  cloud_bytes_ = cloud_filtered->points.capacity() * sizeof(pcl::PointXYZ);
+  updateFootprint();
 
-  if (cloud_filtered->points.size() < 20) {
+  if (cloud_filtered->points.empty()) {
+    roiMissed();
     return;
   }
 
-  // obtain candidate from point cloud
-  if (!updateCandidateFromPointCloud(best_candidate_, cloud_filtered)) {
-    // RCLCPP_INFO(this->get_logger(), "Could not update candidate from point cloud");
+  std::unique_lock<PriorityInheritanceMutex> lock(tracks_mutex_);
+  if (best_candidate != best_candidate_) {
+    // merged or replaced while filtering
     return;
-  };
-  geometry_msgs::msg::TransformStamped tf;
-  tf2::Stamped<tf2::Transform> base_frame_respect_earth_tf;
-  tf = tfBuffer_->lookupTransform("earth", base_frame_, tf2::TimePointZero);
-  tf2::fromMsg(tf, base_frame_respect_earth_tf);
-
-  // if distance to candidate is less than 0.5m change Phase
-
-  const Eigen::Vector3d candidate_vec = best_candidate_->getEigen();
-  const Eigen::Vector3d base_frame_respect_earth_vec(base_frame_respect_earth_tf.getOrigin().x(),
-                                                     base_frame_respect_earth_tf.getOrigin().y(),
-                                                     base_frame_respect_earth_tf.getOrigin().z());
-  const auto distance = (candidate_vec - base_frame_respect_earth_vec).norm();
-  if (distance < 0.2) {
-    RCLCPP_WARN(this->get_logger(), "TOO_NEAR_TO_DETECT");
+  }
+  // obtain candidate from point cloud
+  {
+    ScopedStage stage(metrics_, Stage::CLOUD_ESTIMATION);
+    // sparse targets are estimated over the last few clouds of the track
+    const double stamp = rclcpp::Time(header.stamp).seconds();
+    if (roi_history_points_ > 0) {
+      if (!best_candidate_->roi_history) {
+        best_candidate_->roi_history = std::make_shared<PointHistory>(roi_history_points_);
+      }
+      best_candidate_->roi_history->push(cloud_filtered->points.data(), cloud_filtered->size(), stamp);
+      best_candidate_->roi_history->gather(stamp, roi_history_window_, best_candidate_->speed.cast<float>(),
+                                           roi_points_cloud_);
+    } else {
+      roi_points_cloud_.clear();
+      for (const auto &p : cloud_filtered->points) roi_points_cloud_.push_back({p.x, p.y, p.z});
+    }
+    stage.setItems(roi_points_cloud_.size());
+    if (static_cast<int>(roi_points_cloud_.size()) < min_roi_points_) {
+      roiMissed();
+      return;
+    }
+    const Eigen::Vector3f sensor(earthTf.getOrigin().x(), earthTf.getOrigin().y(), earthTf.getOrigin().z());
+    const std::vector<Point3f> *roi_points = &roi_points_cloud_;
+    if (roi_voxel_size_ > 0.0) {
+      // overlapping clouds of the history would otherwise weight the static parts more
+      voxelDownsample(roi_points_cloud_.data(), roi_points_cloud_.size(), roi_voxel_size_, roi_voxels_,
+                      roi_points_voxelized_);
+      roi_points = &roi_points_voxelized_;
+    }
+    if (!updateCandidateFromPointCloud(best_candidate_, *roi_points, sensor, header.stamp)) {
+      // RCLCPP_INFO(this->get_logger(), "Could not update candidate from point cloud");
+      return;
+    };
+    roi_misses_ = 0;
+  }
+  if (tooNear(best_candidate_->getEigen())) {
+    enterCloseRange();
     return;
   }
 
+  ScopedStage stage(metrics_, Stage::CLOUD_PUBLISH);
+  pubCandidate(best_candidate_);
+  lock.unlock();
+
   // create msg PointCloud2 with the cloud_filtered points
   sensor_msgs::msg::PointCloud2 cloud_filtered_msg;
   pcl::toROSMsg(*cloud_filtered, cloud_filtered_msg);
-  cloud_filtered_msg.header = msg->header;
+  cloud_filtered_msg.header = header;
   cloud_filtered_msg.header.frame_id = "earth";
 
   // publish filtered cloud
   static auto pub = this->create_publisher<sensor_msgs::msg::PointCloud2>("cloud_filtered", 10);
   pub->publish(cloud_filtered_msg);
-  pubCandidate(best_candidate_);
 }
 
-static pcl::PointCloud<pcl::PointXYZ>::Ptr obtainPointCloudFromDepthCrop(const cv::Mat &depth, const cv::Mat &K,
-                                                                         const cv::Mat &D) {
-  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+void Depthtection::imagesAndDetectionCallback(const sensor_msgs::msg::Image::SharedPtr img_ptr,
+                                              const sensor_msgs::msg::Image::SharedPtr depth_ptr,
+                                              const vision_msgs::msg::Detection2DArray::SharedPtr detection) {
+  if (!on_running_){
+    return;
+  }
+
+  {
+    ScopedStage stage(metrics_, Stage::IMAGES_DECODE);
+    this->rgbImageCallback(img_ptr);
+    this->depthImageCallback(depth_ptr);
+  }
+  {
+    ScopedStage stage(metrics_, Stage::DETECTION);
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+    this->detectionCallback(detection);
+  }
+  updateFootprint();
+}
 
-  const double fx = K.at<double>(0, 0);
-  const double fy = K.at<double>(1, 1);
-  const double cx = K.at<double>(0, 2);
-  const double cy = K.at<double>(1, 2);
+void Depthtection::imagesAndCompressedDetectionCallback(
+    const sensor_msgs::msg::Image::SharedPtr img_ptr, const sensor_msgs::msg::CompressedImage::SharedPtr depth_ptr,
+    const vision_msgs::msg::Detection2DArray::SharedPtr detection) {
+  if (!on_running_) {
+    return;
+  }
 
-  cloud->points.reserve(depth.rows * depth.cols);
-  for (int v = 0; v < depth.rows; v++) {
-    for (int u = 0; u < depth.cols; u++) {
-      double d = depth.at<float>(v, u);
-      if (d == 0 || d == std::numeric_limits<float>::infinity()) {
-        continue;
-      }
-      cv::Vec3f point_undistorted;
-      cv::undistortPoints(cv::Mat(cv::Point3f(u, v, d)), point_undistorted, K, D);
-      cloud->points.emplace_back(point_undistorted[0] * d / fx, point_undistorted[1] * d / fy, d);
+  {
+    ScopedStage stage(metrics_, Stage::IMAGES_DECODE);
+    this->rgbImageCallback(img_ptr);
+    if (!decodeCompressedDepth(*depth_ptr, *detection)) {
+      return;
     }
+    size_t decoded_pixels = 0;
+    for (const auto &rows : decoded_rows_) decoded_pixels += (rows.second - rows.first) * depth_img_.cols;
+    stage.setItems(decoded_pixels);
+  }
+  {
+    ScopedStage stage(metrics_, Stage::DETECTION);
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+    this->detectionCallback(detection);
   }
-  return cloud;
-};
+  updateFootprint();
+}
 
-void Depthtection::imagesAndDetectionCallback(const sensor_msgs::msg::Image::SharedPtr img_ptr,
-                                              const sensor_msgs::msg::Image::SharedPtr depth_ptr,
-                                              const vision_msgs::msg::Detection2DArray::SharedPtr detection) {
-  if (!on_running_){
+bool Depthtection::decodeCompressedDepth(const sensor_msgs::msg::CompressedImage &msg,
+                                         const vision_msgs::msg::Detection2DArray &detections) {
+  std::string error;
+  if (!depth_decoder_.reset(msg.format, msg.data.data(), msg.data.size(), error)) {
+    RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 5000, "Compressed depth: %s", error.c_str());
+    return false;
+  }
+  prepareRoiDepth(depth_decoder_.height(), depth_decoder_.width(), detections);
+  if (!depth_decoder_.decodeRows(decoded_rows_, roi_depth_img_.ptr<float>(), roi_depth_img_.step1(), error)) {
+    RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 5000, "Compressed depth: %s", error.c_str());
+    return false;
+  }
+  return true;
+}
+
+void Depthtection::prepareRoiDepth(int rows, int cols, const vision_msgs::msg::Detection2DArray &detections) {
+  if (roi_depth_img_.rows != rows || roi_depth_img_.cols != cols) {
+    roi_depth_img_ = cv::Mat::zeros(rows, cols, CV_32FC1);
+    decoded_rows_.clear();
+  }
+  // rows decoded for the previous frame would otherwise look valid
+  for (const auto &range : decoded_rows_) {
+    roi_depth_img_.rowRange(range.first, range.second).setTo(0.0f);
+  }
+  decoded_rows_ = mergeRowRanges(depthRowsOfInterest(detections, rows), rows);
+  depth_img_ = roi_depth_img_;
+  publishImageBytes();
+}
+
+void Depthtection::serializedDepthCallback(const std::shared_ptr<rclcpp::SerializedMessage> msg) {
+  const auto &buffer = msg->get_rcl_serialized_message();
+  std::string error;
+  if (!serialized_depth_.reset(buffer.buffer, buffer.buffer_length, error)) {
+    RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 5000, "Serialized depth: %s", error.c_str());
+    return;
+  }
+  const int64_t stamp = serialized_depth_.stampNs();
+  if (close_range_ && on_running_) {
+    if (decodeCloseRangeRows(serialized_depth_, error)) {
+      std_msgs::msg::Header header;
+      header.stamp = rclcpp::Time(stamp);
+      header.frame_id = serialized_depth_.frameId();
+      closeRangeFrame(DepthView{close_range_img_.ptr<float>(), close_range_img_.cols, close_range_img_.rows,
+                                close_range_img_.step1()},
+                      header);
+    }
+  }
+  serialized_sync_->add<1>(stamp, msg);
+}
+
+void Depthtection::rawDepthCallback(const sensor_msgs::msg::Image::SharedPtr msg) {
+  image_sync_->add<1>(rclcpp::Time(msg->header.stamp).nanoseconds(), msg);
+  closeRangeDepthCallback(msg);
+}
+
+void Depthtection::compressedDepthCallback(const sensor_msgs::msg::CompressedImage::SharedPtr msg) {
+  compressed_sync_->add<1>(rclcpp::Time(msg->header.stamp).nanoseconds(), msg);
+  closeRangeCompressedCallback(msg);
+}
+
+void Depthtection::syncedRgbCallback(const sensor_msgs::msg::Image::SharedPtr msg) {
+  const int64_t stamp = rclcpp::Time(msg->header.stamp).nanoseconds();
+  if (image_sync_) {
+    image_sync_->add<0>(stamp, msg);
+  } else if (compressed_sync_) {
+    compressed_sync_->add<0>(stamp, msg);
+  } else {
+    serialized_sync_->add<0>(stamp, msg);
+  }
+}
+
+void Depthtection::syncedDetectionCallback(const vision_msgs::msg::Detection2DArray::SharedPtr msg) {
+  const int64_t stamp = rclcpp::Time(msg->header.stamp).nanoseconds();
+  if (!prefilterDetections(*msg)) {
+    // the images of the frame are dropped undecoded
+    if (image_sync_) {
+      image_sync_->discard(stamp);
+    } else if (compressed_sync_) {
+      compressed_sync_->discard(stamp);
+    } else {
+      serialized_sync_->discard(stamp);
+    }
+    return;
+  }
+  if (image_sync_) {
+    image_sync_->add<2>(stamp, msg);
+  } else if (compressed_sync_) {
+    compressed_sync_->add<2>(stamp, msg);
+  } else {
+    serialized_sync_->add<2>(stamp, msg);
+  }
+}
+
+bool Depthtection::prefilterDetections(vision_msgs::msg::Detection2DArray &msg) {
+  detection_summaries_.resize(msg.detections.size());
+  for (size_t i = 0; i < msg.detections.size(); i++) {
+    const auto &detection = msg.detections[i];
+    auto &summary = detection_summaries_[i];
+    summary.has_hypothesis = !detection.results.empty();
+    if (summary.has_hypothesis) {
+      summary.class_id = detection.results[0].hypothesis.class_id;
+      summary.score = detection.results[0].hypothesis.score;
+    }
+    summary.size_x = detection.bbox.size_x;
+    summary.size_y = detection.bbox.size_y;
+  }
+  detection_filter_->select(detection_summaries_, kept_detections_);
+  if (kept_detections_.size() != msg.detections.size()) {
+    for (size_t i = 0; i < kept_detections_.size(); i++) {
+      const size_t k = kept_detections_[i];
+      if (k != i) msg.detections[i] = std::move(msg.detections[k]);
+    }
+    msg.detections.resize(kept_detections_.size());
+  }
+  // the re-acquisition scan still needs the depth of frames without detections
+  if (msg.detections.empty() && !reacquiring_) {
+    rejected_detection_frames_++;
+    return false;
+  }
+  return true;
+}
+
+void Depthtection::processSerializedDepth(const sensor_msgs::msg::Image::SharedPtr img_ptr,
+                                          const std::shared_ptr<rclcpp::SerializedMessage> &depth,
+                                          const vision_msgs::msg::Detection2DArray::SharedPtr detection) {
+  if (!on_running_) {
     return;
   }
 
-  this->rgbImageCallback(img_ptr);
-  this->depthImageCallback(depth_ptr);
-  this->detectionCallback(detection);
+  {
+    ScopedStage stage(metrics_, Stage::IMAGES_DECODE);
+    this->rgbImageCallback(img_ptr);
+    const auto &buffer = depth->get_rcl_serialized_message();
+    std::string error;
+    if (!serialized_depth_.reset(buffer.buffer, buffer.buffer_length, error)) {
+      return;
+    }
+    prepareRoiDepth(serialized_depth_.height(), serialized_depth_.width(), *detection);
+    if (!serialized_depth_.decodeRows(decoded_rows_, roi_depth_img_.ptr<float>(), roi_depth_img_.step1(), error)) {
+      RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 5000, "Serialized depth: %s", error.c_str());
+      return;
+    }
+    size_t decoded_pixels = 0;
+    for (const auto &rows : decoded_rows_) decoded_pixels += (rows.second - rows.first) * depth_img_.cols;
+    stage.setItems(decoded_pixels);
+  }
+  {
+    ScopedStage stage(metrics_, Stage::DETECTION);
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+    this->detectionCallback(detection);
+  }
+  updateFootprint();
+}
+
+RowRanges Depthtection::depthRowsOfInterest(const vision_msgs::msg::Detection2DArray &detections, int n_rows) {
+  RowRanges rows;
+  for (const auto &detection : detections.detections) {
+    if (detection.results.empty()) {
+      continue;
+    }
+    const auto &bbox = detection.bbox;
+    rows.emplace_back(static_cast<int>(std::floor(bbox.center.y - bbox.size_y / 2)),
+                      static_cast<int>(std::ceil(bbox.center.y + bbox.size_y / 2)) + 1);
+  }
+
+  if (reacquiring_) {
+    // the re-acquisition scan samples every part of the frame
+    rows.emplace_back(0, n_rows);
+    return rows;
+  }
+
+  // rows covered by the sphere around the tracked target
+  std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+  if (!best_candidate_ || !core_->hasCamera()) {
+    return rows;
+  }
+  try {
+    tf2::Stamped<tf2::Transform> transform;
+    tf2::fromMsg(tfBuffer_->lookupTransform("earth", detections.header.frame_id, tf2::TimePointZero), transform);
+    tf2::Transform camLink;
+    camLink.setIdentity();
+    camLink.setBasis(tf2::Matrix3x3(0, 0, 1, -1, 0, 0, 0, -1, 0));
+    const auto target = best_candidate_->getEigen();
+    const tf2::Vector3 p = (transform * camLink).inverse() * tf2::Vector3(target.x(), target.y(), target.z());
+    if (p.z() > 0) {
+      const double fy = cameraIntrinsics(core_->camera()).fy;
+      const double cy = cameraIntrinsics(core_->camera()).cy;
+      const double v = fy * p.y() / p.z() + cy;
+      const double radius = fy * same_object_distance_threshold_ / p.z();
+      rows.emplace_back(static_cast<int>(std::floor(v - radius)), static_cast<int>(std::ceil(v + radius)) + 1);
+    }
+  } catch (tf2::TransformException &ex) {
+    // without the camera pose only the detections are decoded
+  }
+  return rows;
+}
+
+void Depthtection::shmPollCallback() {
+  if (!shm_ring_.isOpen()) {
+    // the producer may start after the node
+    std::string error;
+    if (!shm_ring_.open(shm_input_, error)) {
+      RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 5000, "Waiting for shared memory: %s",
+                           error.c_str());
+      return;
+    }
+  }
+  ShmFrameView frame;
+  uint64_t dropped;
+  if (!shm_ring_.latest(frame, dropped)) {
+    return;
+  }
+  shm_dropped_frames_ += dropped;
+  if (!on_running_) {
+    return;
+  }
+
+  // detections are small, only the depth stays in shared memory
+  auto detections = std::make_shared<vision_msgs::msg::Detection2DArray>();
+  detections->header.stamp = rclcpp::Time(frame.stamp_ns);
+  detections->header.frame_id = std::string(frame.frame_id, strnlen(frame.frame_id, sizeof(ShmSlotHeader::frame_id)));
+  detections->detections.resize(frame.n_detections);
+  for (uint32_t i = 0; i < frame.n_detections; i++) {
+    const auto &src = frame.detections[i];
+    auto &detection = detections->detections[i];
+    detection.header = detections->header;
+    detection.bbox.center.x = src.center_x;
+    detection.bbox.center.y = src.center_y;
+    detection.bbox.size_x = src.size_x;
+    detection.bbox.size_y = src.size_y;
+    detection.results.resize(1);
+    detection.results[0].hypothesis.class_id = std::string(src.class_id, strnlen(src.class_id, sizeof(src.class_id)));
+    detection.results[0].hypothesis.score = src.score;
+  }
+  if (!shm_ring_.stillValid(frame)) {
+    tornShmFrame();
+    return;
+  }
+
+  // the producer may rewrite the slot at any time, the rows read are copied and checked before any use
+  const bool detect = prefilterDetections(*detections);
+  const bool close_range = close_range_;
+  const cv::Mat shm_depth(frame.height, frame.width, CV_32FC1, const_cast<float *>(frame.depth));
+  {
+    ScopedStage stage(metrics_, Stage::IMAGES_DECODE);
+    size_t copied_pixels = 0;
+    if (detect) {
+      prepareRoiDepth(frame.height, frame.width, *detections);
+      for (const auto &range : decoded_rows_) {
+        shm_depth.rowRange(range.first, range.second).copyTo(roi_depth_img_.rowRange(range.first, range.second));
+        copied_pixels += (range.second - range.first) * frame.width;
+      }
+    }
+    if (close_range) {
+      if (close_range_img_.rows != shm_depth.rows || close_range_img_.cols != shm_depth.cols) {
+        close_range_img_ = cv::Mat::zeros(shm_depth.rows, shm_depth.cols, CV_32FC1);
+      }
+      const PixelRect roi = closeRangeRoi(shm_depth.cols, shm_depth.rows, core_->params().close_range.roi_fraction);
+      shm_depth.rowRange(roi.y, roi.y + roi.height).copyTo(close_range_img_.rowRange(roi.y, roi.y + roi.height));
+    }
+    stage.setItems(copied_pixels);
+  }
+  if (!shm_ring_.stillValid(frame)) {
+    tornShmFrame();
+    return;
+  }
+
+  if (detect) {
+    ScopedStage stage(metrics_, Stage::DETECTION);
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+    this->detectionCallback(detections);
+  }
+  if (close_range) {
+    closeRangeFrame(DepthView{close_range_img_.ptr<float>(), close_range_img_.cols, close_range_img_.rows,
+                              close_range_img_.step1()},
+                    detections->header);
+  }
+}
+
+void Depthtection::tornShmFrame() {
+  shm_torn_frames_++;
+  RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 5000,
+                       "Shared memory frame overwritten while reading it, the ring is too small");
 }
 
 void Depthtection::phaseCallback(const std::shared_ptr<std_msgs::msg::String> msg) {
@@ -460,3 +1170,227 @@ void Depthtection::phaseCallback(const std::shared_ptr<std_msgs::msg::String> ms
   return;
 }
 
+
+void Depthtection::mergeCandidates() {
+  std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+  const auto best_id = best_candidate_ ? best_candidate_->id : -1;
+  const int n_merges = core_->merge(best_candidate_);
+  if (n_merges) {
+    RCLCPP_INFO(this->get_logger(), "Merged %d duplicated candidates, %zu left", n_merges, core_->tracks().size());
+  }
+  if (best_candidate_ && best_candidate_->id != best_id) {
+    RCLCPP_INFO(this->get_logger(), "Best candidate %d merged into %d", best_id, best_candidate_->id);
+  }
+}
+
+void Depthtection::publishTrackDigest() {
+  TrackDigest digest;
+  digest.vehicle_id = vehicle_id_;
+  digest.sequence = digest_sequence_++;
+  digest.stamp_ns = this->now().nanoseconds();
+  {
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+    expireRemoteTracks(digest.stamp_ns);
+    for (const auto &candidate : core_->tracks()) {
+      // only share what this vehicle has confirmed itself, remote tracks go back to their owner anyway
+      if (candidate->remote || candidate->confidence < track_sharing_min_confidence_) {
+        continue;
+      }
+      digest.tracks.push_back(
+          {candidate->id, candidate->class_name, candidate->getEigen(), candidate->speed, candidate->confidence});
+    }
+  }
+  if (digest.tracks.empty()) {
+    return;
+  }
+  encode_track_digest(digest, digest_msg_.data);
+  track_digest_pub_->publish(digest_msg_);
+}
+
+void Depthtection::trackDigestCallback(const std_msgs::msg::UInt8MultiArray::SharedPtr msg) {
+  TrackDigest digest;
+  if (!decode_track_digest(msg->data, digest)) {
+    RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 5000, "Discarding malformed track digest");
+    return;
+  }
+  if (digest.vehicle_id == vehicle_id_) {
+    return;
+  }
+  const int64_t received_ns = this->now().nanoseconds();
+  std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+  for (const auto &track : digest.tracks) {
+    fuseRemoteTrack(digest.vehicle_id, track, digest.stamp_ns, received_ns);
+  }
+}
+
+void Depthtection::fuseRemoteTrack(uint8_t vehicle_id, const TrackDigestEntry &track, int64_t stamp_ns,
+                                   int64_t received_ns) {
+  TrackPoint point;
+  point.position = track.position;
+  point.stamp = rclcpp::Time(stamp_ns).seconds();
+
+  const uint32_t key = (static_cast<uint32_t>(vehicle_id) << 24) | (static_cast<uint32_t>(track.id) & 0xffffff);
+  auto &remote = remote_tracks_[key];
+  remote.last_seen_ns = received_ns;
+  auto candidate = remote.candidate.lock();
+  if (!candidate || candidate->merged) {
+    // first time seen (or merged away): associate it once, later digests hit the map
+    candidate = core_->match(track.class_name, point.position);
+    if (!candidate) {
+      candidate = core_->addTrack(track.confidence, track.class_name, point);
+      candidate->remote = true;
+      RCLCPP_INFO(this->get_logger(), "New remote candidate %d from vehicle %d", track.id, vehicle_id);
+    }
+    remote.candidate = candidate;
+  }
+
+  // remote-only tracks follow their owner, local ones only take a fraction of the remote estimate
+  const double w = candidate->remote ? 1.0
+                                     : remote_track_weight_ * track.confidence /
+                                           std::max(track.confidence + candidate->confidence, 1e-6f);
+  core_->table().blend(candidate->slot, track.position.cast<float>(), track.velocity.cast<float>(), w);
+  if (candidate->remote) {
+    candidate->confidence = track.confidence;
+    candidate->raw_point = point;
+  }
+  candidate->syncFromTable();
+}
+
+void Depthtection::expireRemoteTracks(int64_t now_ns) {
+  // the owner stopped sharing these, or lost them
+  std::vector<Candidate::Ptr> stale;
+  for (auto it = remote_tracks_.begin(); it != remote_tracks_.end();) {
+    auto candidate = it->second.candidate.lock();
+    if (candidate && !candidate->merged && now_ns - it->second.last_seen_ns <= remote_track_timeout_ns_) {
+      ++it;
+      continue;
+    }
+    if (candidate && !candidate->merged && candidate->remote) stale.push_back(candidate);
+    it = remote_tracks_.erase(it);
+  }
+  for (const auto &candidate : stale) {
+    // still followed through the digest of another vehicle
+    if (std::any_of(remote_tracks_.begin(), remote_tracks_.end(),
+                    [&candidate](const auto &entry) { return entry.second.candidate.lock() == candidate; })) {
+      continue;
+    }
+    RCLCPP_INFO(this->get_logger(), "Remote candidate %d expired", candidate->id);
+    if (best_candidate_ == candidate) best_candidate_.reset();
+    core_->removeTrack(candidate);
+  }
+}
+
+void Depthtection::logTrack(const Candidate &candidate, TrackSource source) {
+  if (!track_log_.isOpen()) {
+    return;
+  }
+  TrackRecord record;
+  record.stamp_ns = std::llround(candidate.point.stamp * 1e9);
+  record.track_id = candidate.id;
+  record.confidence = candidate.confidence;
+  record.phase = static_cast<uint8_t>(current_phase_);
+  record.source = static_cast<uint8_t>(source);
+  auto copy = [](float *dst, const TrackPoint &p) {
+    dst[0] = p.position.x();
+    dst[1] = p.position.y();
+    dst[2] = p.position.z();
+  };
+  copy(record.raw, candidate.raw_point);
+  copy(record.filtered, candidate.filtered_point);
+  copy(record.predicted, candidate.compensated_point);
+  record.velocity[0] = candidate.speed.x();
+  record.velocity[1] = candidate.speed.y();
+  record.velocity[2] = candidate.speed.z();
+  track_log_.append(record);
+}
+
+void Depthtection::updateFootprint() {
+  MemoryFootprint footprint;
+  footprint.image_bytes = image_bytes_;
+  {
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+    footprint.n_tracks = core_->tracks().size();
+    footprint.track_store_bytes = core_->trackBytes();
+    for (const auto &candidate : core_->tracks()) {
+      if (candidate->roi_history) footprint.track_store_bytes += candidate->roi_history->bytes();
+    }
+    footprint.cloud_bytes = cloud_bytes_ + roi_voxels_.bytes();
+  }
+  metrics_.setFootprint(footprint);
+}
+
+void Depthtection::publishImageBytes() {
+  image_bytes_ = rgb_img_.total() * rgb_img_.elemSize() + depth_img_.total() * depth_img_.elemSize();
+}
+
+void Depthtection::publishMetrics() {
+  MemoryFootprint footprint;
+  const auto snapshot = metrics_.takeSnapshot(footprint);
+
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+  status.name = std::string(this->get_name()) + ": pipeline";
+  status.hardware_id = this->get_fully_qualified_name();
+  auto add_value = [&status](const std::string &key, double value) {
+    diagnostic_msgs::msg::KeyValue kv;
+    kv.key = key;
+    kv.value = std::to_string(value);
+    status.values.emplace_back(kv);
+  };
+
+  for (int i = 0; i < StageMetrics::N; i++) {
+    const auto &stats = snapshot[i];
+    const std::string name = stageName(static_cast<Stage>(i));
+    const double calls = std::max<uint64_t>(stats.calls, 1);
+    add_value(name + "/calls", stats.calls);
+    add_value(name + "/mean_ms", stats.total_ms / calls);
+    add_value(name + "/max_ms", stats.max_ms);
+    add_value(name + "/allocs_per_call", stats.allocs / calls);
+    add_value(name + "/bytes_per_call", stats.bytes / calls);
+    if (metrics_.perfEnabled()) {
+      const double points = stats.items ? stats.items : calls;
+      add_value(name + "/ipc", stats.perf.cycles ? double(stats.perf.instructions) / stats.perf.cycles : 0.0);
+      add_value(name + "/cycles_per_point", stats.perf.cycles / points);
+      add_value(name + "/l1d_misses_per_point", stats.perf.l1d_misses / points);
+      add_value(name + "/llc_misses_per_point", stats.perf.llc_misses / points);
+      add_value(name + "/branch_misses_per_point", stats.perf.branch_misses / points);
+    }
+  }
+  add_value("memory/n_tracks", footprint.n_tracks);
+  add_value("memory/track_store_bytes", footprint.track_store_bytes);
+  add_value("memory/cloud_bytes", footprint.cloud_bytes);
+  add_value("memory/image_bytes", footprint.image_bytes);
+  add_value("detections/rejected_low_fill", core_->rejectedLowFill());
+  add_value("detections/rejected_depth_range", core_->rejectedDepthRange());
+  add_value("detections/rejected_depth_spread", core_->rejectedDepthSpread());
+  for (int i = 0; i < DetectionFilter::N; i++) {
+    const auto rejection = static_cast<DetectionRejection>(i);
+    add_value(std::string("detections/filtered_") + detectionRejectionName(rejection),
+              detection_filter_->rejected(rejection));
+  }
+  add_value("detections/rejected_frames", rejected_detection_frames_);
+  add_value("tracks/reacquisitions", core_->reacquisitions());
+  add_value("tracks/max_association_component", core_->maxAssociationComponent());
+  add_value("tracks/greedy_associations", core_->greedyAssociations());
+  {
+    std::lock_guard<PriorityInheritanceMutex> lock(tracks_mutex_);
+    add_value("tracks/late_measurements", core_->table().lateMeasurements());
+    add_value("tracks/dropped_late_measurements", core_->table().droppedLateMeasurements());
+  }
+  if (sync_stats_) {
+    add_value("sync/matched", sync_stats_->matched);
+    add_value("sync/partial", sync_stats_->partial);
+    add_value("sync/dropped_rgb", sync_stats_->dropped[0]);
+    add_value("sync/dropped_depth", sync_stats_->dropped[1]);
+    add_value("sync/dropped_detections", sync_stats_->dropped[2]);
+  }
+  if (shm_ring_.isOpen()) {
+    add_value("shm/dropped_frames", shm_dropped_frames_);
+    add_value("shm/torn_frames", shm_torn_frames_);
+  }
+
+  diagnostic_msgs::msg::DiagnosticArray msg;
+  msg.header.stamp = this->now();
+  msg.status.emplace_back(status);
+  diagnostics_pub_->publish(msg);
+}
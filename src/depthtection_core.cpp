@@ -0,0 +1,291 @@
+#include "depthtection_core.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+PixelRect BoundingBox::rect() const {
+  PixelRect r;
+  r.x = static_cast<int>(std::floor(center_x - size_x / 2));
+  r.y = static_cast<int>(std::floor(center_y - size_y / 2));
+  r.width = static_cast<int>(std::ceil(size_x)) + 1;
+  r.height = static_cast<int>(std::ceil(size_y)) + 1;
+  return r;
+}
+
+DepthtectionCore::DepthtectionCore(const CoreParams &params)
+    : params_(params), default_estimator_(PointEstimators::index("top_slab")) {}
+
+bool DepthtectionCore::setEstimator(std::string_view name, const std::string &class_id) {
+  const int index = PointEstimators::index(name);
+  if (index < 0) {
+    return false;
+  }
+  if (class_id.empty()) {
+    default_estimator_ = index;
+  } else {
+    class_estimators_[class_id] = index;
+  }
+  return true;
+}
+
+int DepthtectionCore::estimatorFor(const std::string &class_id) const {
+  auto it = class_estimators_.find(class_id);
+  return it == class_estimators_.end() ? default_estimator_ : it->second;
+}
+
+void DepthtectionCore::setCamera(const std::string &distortion_model, const double *k, const std::vector<double> &d,
+                                 int width, int height, std::string &error) {
+  camera_ = makeCameraModel(distortion_model, k, d, width, height, error);
+  has_camera_ = true;
+}
+
+void DepthtectionCore::setMerger(double radius, size_t max_checks) {
+  merger_ = std::make_unique<CandidateMerger>(radius, max_checks);
+}
+
+// Index of name among the classes of the frame, -1 if no box has it
+static int frameClass(const std::vector<std::string_view> &classes, std::string_view name) {
+  auto it = std::find(classes.begin(), classes.end(), name);
+  return it == classes.end() ? -1 : static_cast<int>(it - classes.begin());
+}
+
+void DepthtectionCore::processFrame(const DepthView &depth, const std::vector<BoundingBox> &boxes,
+                                    const Eigen::Isometry3d &optical_to_earth, double stamp, FrameResult &result) {
+  result.clear();
+  result.outcomes.resize(boxes.size());
+  result.track_ids.assign(boxes.size(), -1);
+  // gate against where the tracks are expected now, measurements are applied in one batch
+  table_->predict(stamp);
+  depth_integral_.clear();
+
+  // earth up seen from the optical frame
+  EstimatorFrame frame;
+  frame.up = (optical_to_earth.linear().transpose() * Eigen::Vector3d::UnitZ()).cast<float>();
+
+  measured_boxes_.clear();
+  measured_extents_.clear();
+  measurements_.clear();
+  measurement_classes_.clear();
+  frame_classes_.clear();
+  const auto &intrinsics = cameraIntrinsics(camera_);
+  for (size_t i = 0; i < boxes.size(); i++) {
+    const auto &box = boxes[i];
+    BoxOutcome rejection;
+    if (!acceptDepthBox(depth, boxes, box, rejection)) {
+      result.outcomes[i] = rejection;
+      continue;
+    }
+    Eigen::Vector3f estimate;
+    if (!estimateBox(depth, box, frame, estimate)) {
+      result.outcomes[i] = BoxOutcome::NO_DEPTH;
+      continue;
+    }
+    int class_index = frameClass(frame_classes_, box.class_id);
+    if (class_index < 0) {
+      class_index = static_cast<int>(frame_classes_.size());
+      frame_classes_.push_back(box.class_id);
+    }
+    measured_boxes_.push_back(i);
+    measured_extents_.push_back(std::max(box.size_x / intrinsics.fx, box.size_y / intrinsics.fy) * estimate.z());
+    measurements_.push_back(optical_to_earth * estimate.cast<double>());
+    measurement_classes_.push_back(class_index);
+  }
+
+  // all the estimates against all the tracks at once, so the box order does not matter
+  track_positions_.clear();
+  track_classes_.clear();
+  for (const auto &candidate : candidates_) {
+    track_positions_.push_back(candidate->getPredictedEigen());
+    track_classes_.push_back(frameClass(frame_classes_, candidate->class_name));
+  }
+  associator_.solve(measurements_, measurement_classes_, track_positions_, track_classes_,
+                    params_.same_object_distance, params_.association_max_component, assignment_);
+  if (static_cast<uint64_t>(associator_.largestComponent()) > max_association_component_) {
+    max_association_component_ = associator_.largestComponent();
+  }
+  greedy_associations_ += associator_.greedyComponents();
+
+  for (size_t k = 0; k < measured_boxes_.size(); k++) {
+    const auto &box = boxes[measured_boxes_[k]];
+    TrackPoint point;
+    point.position = measurements_[k];
+    point.stamp = stamp;
+    Candidate::Ptr candidate = assignment_[k] >= 0 ? candidates_[assignment_[k]] : nullptr;
+    if (!candidate) {
+      // another box of a target first seen in this frame
+      candidate = match_candidate(result.created, box.class_id, point.position, params_.same_object_distance);
+    }
+    if (!candidate) {
+      candidate = addTrack(box.score, box.class_id, point);
+      result.created.emplace_back(candidate);
+      result.outcomes[measured_boxes_[k]] = BoxOutcome::NEW_TRACK;
+    } else {
+      candidate->confidence = (candidate->confidence + box.score) / 2;
+      candidate->updatePoint(point);
+      result.updated.emplace_back(candidate);
+      result.outcomes[measured_boxes_[k]] = BoxOutcome::UPDATED_TRACK;
+    }
+    candidate->extent = measured_extents_[k];
+    result.track_ids[measured_boxes_[k]] = candidate->id;
+  }
+
+  table_->commit(stamp);
+  for (const auto &candidate : result.updated) candidate->syncFromTable();
+}
+
+bool DepthtectionCore::acceptDepthBox(const DepthView &depth, const std::vector<BoundingBox> &boxes,
+                                      const BoundingBox &box, BoxOutcome &rejection) {
+  const PixelRect rect = box.rect();
+  DepthBoxStats stats;
+  if (static_cast<int>(boxes.size()) >= params_.depth_stats_min_detections) {
+    // many boxes, one pass over the rows they span answers all of them
+    if (!depth_integral_.covers(rect)) {
+      int row_begin = depth.height, row_end = 0;
+      for (const auto &other : boxes) {
+        const PixelRect other_rect = other.rect();
+        row_begin = std::min(row_begin, other_rect.y);
+        row_end = std::max(row_end, other_rect.y + other_rect.height);
+      }
+      depth_integral_.build(depth, row_begin, row_end);
+    }
+    stats = depth_integral_.stats(rect);
+  } else {
+    stats = depthBoxStats(depth, rect);
+  }
+
+  if (stats.fill() < params_.min_depth_fill) {
+    rejected_low_fill_++;
+    rejection = BoxOutcome::REJECTED_LOW_FILL;
+    return false;
+  }
+  if (stats.mean < params_.min_depth || stats.mean > params_.max_depth) {
+    rejected_depth_range_++;
+    rejection = BoxOutcome::REJECTED_DEPTH_RANGE;
+    return false;
+  }
+  if (params_.max_depth_std > 0.0 && stats.variance > params_.max_depth_std * params_.max_depth_std) {
+    rejected_depth_spread_++;
+    rejection = BoxOutcome::REJECTED_DEPTH_SPREAD;
+    return false;
+  }
+  return true;
+}
+
+bool DepthtectionCore::estimateBox(const DepthView &depth, const BoundingBox &box, const EstimatorFrame &frame,
+                                   Eigen::Vector3f &out) {
+  // back-project the inner half of the bbox, subsampled to bound the cost on large boxes
+  const int u0 = std::max(0, static_cast<int>(box.center_x - box.size_x / 4));
+  const int u1 = std::min(depth.width, static_cast<int>(box.center_x + box.size_x / 4) + 1);
+  const int v0 = std::max(0, static_cast<int>(box.center_y - box.size_y / 4));
+  const int v1 = std::min(depth.height, static_cast<int>(box.center_y + box.size_y / 4) + 1);
+  if (u1 <= u0 || v1 <= v0) {
+    // the inner half, centre included, is out of the image
+    return false;
+  }
+  const int step = std::max(1, static_cast<int>(std::sqrt(double(u1 - u0) * (v1 - v0) / MAX_ROI_SAMPLES)));
+  roi_points_.clear();
+  std::visit(
+      [&](const auto &camera) {
+        for (int v = v0; v < v1; v += step) {
+          const float *row = depth.row(v);
+          for (int u = u0; u < u1; u += step) {
+            if (row[u] > 0 && std::isfinite(row[u])) {
+              const Eigen::Vector3f p = camera.backProject(u, v, row[u]);
+              roi_points_.push_back({p.x(), p.y(), p.z()});
+            }
+          }
+        }
+      },
+      camera_);
+
+  if (PointEstimators::estimate(estimatorFor(box.class_id), roi_points_.data(), roi_points_.size(), frame,
+                                params_.estimator_params, out)) {
+    return true;
+  }
+
+  // no valid depth in the box, fall back to the centre pixel
+  const int u = std::clamp(static_cast<int>(box.center_x), 0, depth.width - 1);
+  const int v = std::clamp(static_cast<int>(box.center_y), 0, depth.height - 1);
+  const float d = depth.at(v, u);
+  if (!(d > 0 && std::isfinite(d))) {
+    return false;
+  }
+  out = std::visit([&](const auto &camera) { return camera.backProject(u, v, d); }, camera_);
+  return true;
+}
+
+bool DepthtectionCore::updateFromPoints(const Candidate::Ptr &candidate, const std::vector<Point3f> &points,
+                                        const Eigen::Vector3f &sensor, double stamp) {
+  EstimatorFrame frame;
+  frame.sensor = sensor;
+  Eigen::Vector3f estimate;
+  if (!PointEstimators::estimate(estimatorFor(candidate->class_name), points.data(), points.size(), frame,
+                                 params_.estimator_params, estimate)) {
+    return false;
+  }
+  TrackPoint point;
+  point.position = estimate.cast<double>();
+  point.stamp = stamp;
+  candidate->updatePoint(point);
+  table_->commit(stamp);
+  candidate->syncFromTable();
+  return true;
+}
+
+bool DepthtectionCore::reacquire(const DepthView &depth, const Eigen::Isometry3d &optical_to_earth,
+                                 const Candidate::Ptr &candidate, double stamp) {
+  const double extent = candidate->extent > 0 ? candidate->extent : params_.reacquisition.default_extent;
+  Eigen::Vector3d found;
+  if (!reacquisition_.scan(depth, camera_, optical_to_earth, candidate->getEigen(), extent, params_.reacquisition,
+                           found)) {
+    return false;
+  }
+  // the old velocity brought the track where the target is not
+  table_->blend(candidate->slot, found.cast<float>(), Eigen::Vector3f::Zero(), 1.0f);
+  candidate->raw_point.position = found;
+  candidate->raw_point.stamp = stamp;
+  candidate->syncFromTable();
+  reacquisitions_++;
+  return true;
+}
+
+bool DepthtectionCore::closeRangeUpdate(const DepthView &depth, const Eigen::Isometry3d &optical_to_earth,
+                                        const Candidate::Ptr &candidate, double stamp, double &range) {
+  Eigen::Vector3f estimate;
+  if (!close_range_.estimate(depth, camera_, params_.close_range, estimate)) {
+    return false;
+  }
+  range = estimate.norm();
+  TrackPoint point;
+  point.position = optical_to_earth * estimate.cast<double>();
+  point.stamp = stamp;
+  candidate->updatePoint(point);
+  table_->commit(stamp);
+  candidate->syncFromTable();
+  return true;
+}
+
+Candidate::Ptr DepthtectionCore::addTrack(float confidence, std::string_view class_id, const TrackPoint &point) {
+  candidates_.emplace_back(std::make_shared<Candidate>(next_id_++, confidence, class_id, point, table_));
+  return candidates_.back();
+}
+
+int DepthtectionCore::merge(Candidate::Ptr &best) { return merger_ ? merger_->step(candidates_, best) : 0; }
+
+void DepthtectionCore::removeTrack(const Candidate::Ptr &candidate) {
+  auto it = std::find(candidates_.begin(), candidates_.end(), candidate);
+  if (it == candidates_.end()) {
+    return;
+  }
+  candidate->merged = true;
+  table_->remove(candidate->slot);
+  candidates_.erase(it);
+}
+
+size_t DepthtectionCore::trackBytes() const {
+  size_t bytes = candidates_.capacity() * sizeof(Candidate::Ptr) + table_->bytes() + depth_integral_.bytes() +
+                 roi_points_.capacity() * sizeof(Point3f) + reacquisition_.bytes() + close_range_.bytes() +
+                 associator_.bytes();
+  for (const auto &candidate : candidates_) bytes += sizeof(Candidate) + candidate->class_name.capacity();
+  return bytes;
+}
@@ -1,9 +1,138 @@
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
 #include "depthtection.hpp"
 #include "rclcpp/rclcpp.hpp"
 
+// Scheduling of the threads running one role (detection, cloud or the default group)
+struct ThreadConfig {
+  std::string role;
+  std::vector<int64_t> cpus;
+  int nice = 0;
+  int rt_priority = 0;
+};
+
+static ThreadConfig declareThreadConfig(rclcpp::Node &node, const std::string &role) {
+  ThreadConfig config;
+  config.role = role;
+  config.cpus = node.declare_parameter<std::vector<int64_t>>(role + "_thread.cpus", std::vector<int64_t>());
+  config.nice = node.declare_parameter<int>(role + "_thread.nice", 0);
+  config.rt_priority = node.declare_parameter<int>(role + "_thread.rt_priority", 0);
+  return config;
+}
+
+// Applies the config to the calling thread and describes the resulting layout
+static std::string applyThreadConfig(const rclcpp::Logger &logger, const ThreadConfig &config) {
+  const pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+  std::ostringstream layout;
+  layout << config.role << " thread " << tid;
+
+  if (!config.cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : config.cpus) CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+      RCLCPP_WARN(logger, "Could not set the affinity of the %s thread", config.role.c_str());
+    }
+  }
+  cpu_set_t current;
+  if (pthread_getaffinity_np(pthread_self(), sizeof(current), &current) == 0) {
+    layout << " cpus [";
+    for (int cpu = 0, n = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &current)) layout << (n++ ? "," : "") << cpu;
+    }
+    layout << "]";
+  }
+
+  if (config.rt_priority > 0) {
+    sched_param param;
+    param.sched_priority = config.rt_priority;
+    const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+      RCLCPP_WARN(logger, "Could not set SCHED_FIFO %d on the %s thread: %s", config.rt_priority,
+                  config.role.c_str(), std::strerror(err));
+    } else {
+      layout << " SCHED_FIFO " << config.rt_priority;
+    }
+  } else if (config.nice != 0) {
+    // on Linux the nice value is per thread
+    if (setpriority(PRIO_PROCESS, tid, config.nice) != 0) {
+      RCLCPP_WARN(logger, "Could not set nice %d on the %s thread: %s", config.nice, config.role.c_str(),
+                  std::strerror(errno));
+    } else {
+      layout << " nice " << config.nice;
+    }
+  }
+  return layout.str();
+}
+
 int main(int argc, char* argv[]) {
   rclcpp::init(argc, argv);
-  rclcpp::spin(std::make_shared<Depthtection>());
+  auto node = std::make_shared<Depthtection>();
+  const auto logger = node->get_logger();
+
+  // single: rclcpp::spin, static: StaticSingleThreadedExecutor, multi: MultiThreadedExecutor,
+  // per_group: one single threaded executor and thread per callback group
+  const auto executor_type = node->declare_parameter<std::string>("executor", "single");
+  const auto n_threads = node->declare_parameter<int>("executor_threads", 0);
+  const auto default_config = declareThreadConfig(*node, "default");
+  const auto detection_config = declareThreadConfig(*node, "detection");
+  const auto cloud_config = declareThreadConfig(*node, "cloud");
+
+  if (executor_type == "per_group") {
+    rclcpp::executors::SingleThreadedExecutor default_executor, detection_executor, cloud_executor;
+    default_executor.add_node(node);
+    detection_executor.add_callback_group(node->detectionCallbackGroup(), node->get_node_base_interface());
+    cloud_executor.add_callback_group(node->cloudCallbackGroup(), node->get_node_base_interface());
+
+    auto run = [&logger](rclcpp::Executor &executor, const ThreadConfig &config) {
+      RCLCPP_INFO(logger, "Executor layout: %s", applyThreadConfig(logger, config).c_str());
+      executor.spin();
+    };
+    std::thread detection_thread(run, std::ref(detection_executor), std::cref(detection_config));
+    std::thread cloud_thread(run, std::ref(cloud_executor), std::cref(cloud_config));
+    run(default_executor, default_config);
+
+    detection_executor.cancel();
+    cloud_executor.cancel();
+    detection_thread.join();
+    cloud_thread.join();
+  } else if (executor_type == "multi") {
+    const size_t threads = n_threads > 0 ? n_threads : std::thread::hardware_concurrency();
+    rclcpp::executors::MultiThreadedExecutor executor(rclcpp::ExecutorOptions(), threads);
+    executor.add_node(node);
+    executor.add_callback_group(node->detectionCallbackGroup(), node->get_node_base_interface());
+    executor.add_callback_group(node->cloudCallbackGroup(), node->get_node_base_interface());
+    // worker threads inherit affinity and priority from the spinning thread
+    RCLCPP_INFO(logger, "Executor layout: multi threaded with %zu threads, %s", threads,
+                applyThreadConfig(logger, default_config).c_str());
+    executor.spin();
+  } else {
+    if (executor_type != "single" && executor_type != "static") {
+      RCLCPP_WARN(logger, "Unknown executor '%s', using single", executor_type.c_str());
+    }
+    std::unique_ptr<rclcpp::Executor> executor;
+    if (executor_type == "static") {
+      executor = std::make_unique<rclcpp::executors::StaticSingleThreadedExecutor>();
+    } else {
+      executor = std::make_unique<rclcpp::executors::SingleThreadedExecutor>();
+    }
+    executor->add_node(node);
+    executor->add_callback_group(node->detectionCallbackGroup(), node->get_node_base_interface());
+    executor->add_callback_group(node->cloudCallbackGroup(), node->get_node_base_interface());
+    RCLCPP_INFO(logger, "Executor layout: %s, %s", executor_type.c_str(),
+                applyThreadConfig(logger, default_config).c_str());
+    executor->spin();
+  }
+
   rclcpp::shutdown();
   return 0;
 }
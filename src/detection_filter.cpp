@@ -0,0 +1,41 @@
+#include "detection_filter.hpp"
+
+#include <algorithm>
+
+bool DetectionFilter::accept(const DetectionSummary &detection) {
+  const double shorter = std::min(detection.size_x, detection.size_y);
+  const double longer = std::max(detection.size_x, detection.size_y);
+  DetectionRejection rejection;
+  if (!detection.has_hypothesis) {
+    rejection = DetectionRejection::NO_HYPOTHESIS;
+  } else if (!(detection.score >= params_.min_score)) {
+    rejection = DetectionRejection::LOW_SCORE;
+  } else if (!params_.classes.empty() &&
+             std::find(params_.classes.begin(), params_.classes.end(), detection.class_id) == params_.classes.end()) {
+    rejection = DetectionRejection::CLASS;
+  } else if (!(detection.size_x > 0.0 && detection.size_y > 0.0 && shorter >= params_.min_size)) {
+    rejection = DetectionRejection::TOO_SMALL;
+  } else if (params_.max_size > 0.0 && longer > params_.max_size) {
+    rejection = DetectionRejection::TOO_LARGE;
+  } else {
+    return true;
+  }
+  rejected_[static_cast<int>(rejection)]++;
+  return false;
+}
+
+void DetectionFilter::select(const std::vector<DetectionSummary> &detections, std::vector<int> &kept) {
+  kept.clear();
+  for (size_t i = 0; i < detections.size(); i++) {
+    if (accept(detections[i])) kept.push_back(static_cast<int>(i));
+  }
+  if (params_.max_detections <= 0 || kept.size() <= static_cast<size_t>(params_.max_detections)) {
+    return;
+  }
+  // the best scores, ties to the first, back in input order
+  std::stable_sort(kept.begin(), kept.end(),
+                   [&](int a, int b) { return detections[a].score > detections[b].score; });
+  rejected_[static_cast<int>(DetectionRejection::OVER_LIMIT)] += kept.size() - params_.max_detections;
+  kept.resize(params_.max_detections);
+  std::sort(kept.begin(), kept.end());
+}
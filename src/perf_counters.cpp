@@ -0,0 +1,74 @@
+#include "perf_counters.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+
+static int openCounter(uint32_t type, uint64_t config, int group_fd) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = group_fd == -1 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  // pid 0, cpu -1: the calling thread on any cpu
+  return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+
+PerfCounters::PerfCounters() {
+  for (auto &fd : fds_) fd = -1;
+
+  const uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  const struct {
+    uint32_t type;
+    uint64_t config;
+  } events[N_COUNTERS] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},   {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HW_CACHE, l1d_read_miss},              {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  };
+
+  for (int i = 0; i < N_COUNTERS; i++) {
+    fds_[i] = openCounter(events[i].type, events[i].config, i == 0 ? -1 : fds_[0]);
+    if (fds_[i] < 0) {
+      // all or nothing, a partial group would give misleading ratios
+      for (int j = 0; j <= i; j++) {
+        if (fds_[j] >= 0) close(fds_[j]);
+        fds_[j] = -1;
+      }
+      return;
+    }
+  }
+  ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounters::~PerfCounters() {
+  for (auto fd : fds_) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+bool PerfCounters::read(PerfSample &sample) const {
+  if (!valid()) return false;
+  uint64_t buffer[1 + N_COUNTERS];
+  if (::read(fds_[0], buffer, sizeof(buffer)) != sizeof(buffer)) return false;
+  sample.cycles = buffer[1];
+  sample.instructions = buffer[2];
+  sample.l1d_misses = buffer[3];
+  sample.llc_misses = buffer[4];
+  sample.branch_misses = buffer[5];
+  return true;
+}
+
+PerfCounters &PerfCounters::forThisThread() {
+  static thread_local PerfCounters counters;
+  return counters;
+}
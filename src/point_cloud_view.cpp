@@ -0,0 +1,74 @@
+#include "point_cloud_view.hpp"
+
+#include "cdr_cursor.hpp"
+
+bool validatePointCloudView(const PointCloudView &view, size_t data_size, std::string &error) {
+  for (int i = 0; i < 3; i++) {
+    if (view.offset[i] + sizeof(float) > view.point_step) {
+      error = "xyz fields outside the point";
+      return false;
+    }
+  }
+  if (view.height && (size_t(view.width) * view.point_step > view.row_step ||
+                      size_t(view.row_step) * (view.height - 1) + size_t(view.width) * view.point_step > data_size)) {
+    error = "inconsistent cloud size";
+    return false;
+  }
+  return true;
+}
+
+bool parseSerializedPointCloud(const uint8_t *buffer, size_t size, PointCloudView &view, std::string &error) {
+  view.data = nullptr;
+  if (size < 4 || buffer[1] != 0x01) {
+    error = "not a CDR little endian message";
+    return false;
+  }
+  CdrCursor cursor{buffer, size, 4};
+  int32_t sec;
+  uint32_t nanosec, n_fields;
+  if (!cursor.read(sec) || !cursor.read(nanosec) || !cursor.readString(view.frame_id) || !cursor.read(view.height) ||
+      !cursor.read(view.width) || !cursor.read(n_fields)) {
+    error = "truncated cloud header";
+    return false;
+  }
+  view.stamp_ns = int64_t(sec) * 1000000000 + nanosec;
+
+  int found = 0;
+  std::string name;
+  for (uint32_t i = 0; i < n_fields; i++) {
+    uint32_t offset, count;
+    uint8_t datatype;
+    if (!cursor.readString(name) || !cursor.read(offset) || !cursor.read(datatype) || !cursor.read(count)) {
+      error = "truncated cloud fields";
+      return false;
+    }
+    if (name.size() != 1 || name[0] < 'x' || name[0] > 'z') continue;
+    if (datatype != POINT_FIELD_FLOAT32) {
+      error = "xyz fields must be FLOAT32";
+      return false;
+    }
+    view.offset[name[0] - 'x'] = offset;
+    found |= 1 << (name[0] - 'x');
+  }
+  if (found != 7) {
+    error = "cloud without xyz fields";
+    return false;
+  }
+
+  uint8_t big_endian;
+  uint32_t data_size;
+  if (!cursor.read(big_endian) || !cursor.read(view.point_step) || !cursor.read(view.row_step) ||
+      !cursor.read(data_size) || cursor.pos + data_size > size) {
+    error = "truncated cloud data";
+    return false;
+  }
+  if (big_endian) {
+    error = "big endian clouds are not supported";
+    return false;
+  }
+  if (!validatePointCloudView(view, data_size, error)) {
+    return false;
+  }
+  view.data = buffer + cursor.pos;
+  return true;
+}
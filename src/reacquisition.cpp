@@ -0,0 +1,95 @@
+#include "reacquisition.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+bool ReacquisitionScan::scan(const DepthView &depth, const CameraModel &camera,
+                             const Eigen::Isometry3d &optical_to_earth, const Eigen::Vector3d &last_position,
+                             double extent, const ReacquisitionParams &params, Eigen::Vector3d &found) {
+  if (depth.empty() || params.max_cells <= 0) {
+    return false;
+  }
+  const int step = std::max(
+      1, static_cast<int>(std::ceil(std::sqrt(double(depth.width) * depth.height / params.max_cells))));
+  const int cols = depth.width / step;
+  const int rows = depth.height / step;
+  const size_t n = size_t(cols) * rows;
+  depth_.assign(n, 0.0f);
+  points_.resize(n);
+  visited_.assign(n, 0);
+
+  // one sample per cell, kept when near the height the target was last seen at
+  const Eigen::Isometry3f to_earth = optical_to_earth.cast<float>();
+  const float z_min = last_position.z() - params.height_tolerance;
+  const float z_max = last_position.z() + params.height_tolerance;
+  std::visit(
+      [&](const auto &model) {
+        for (int r = 0; r < rows; r++) {
+          const int v = r * step + step / 2;
+          const float *row = depth.row(v);
+          for (int c = 0; c < cols; c++) {
+            const int u = c * step + step / 2;
+            const float d = row[u];
+            if (!(d > 0) || !std::isfinite(d)) continue;
+            const Eigen::Vector3f p = to_earth * model.backProject(u, v, d);
+            if (p.z() < z_min || p.z() > z_max) continue;
+            depth_[r * cols + c] = d;
+            points_[r * cols + c] = p;
+          }
+        }
+      },
+      camera);
+
+  // blobs of 4-connected cells without depth jumps
+  const float inv_f = 1.0f / cameraIntrinsics(camera).fx;
+  const double min_extent = extent / (1.0 + params.size_tolerance);
+  const double max_extent = extent * (1.0 + params.size_tolerance);
+  double best_distance = std::numeric_limits<double>::max();
+  for (size_t seed = 0; seed < n; seed++) {
+    if (visited_[seed] || depth_[seed] == 0.0f) continue;
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    Eigen::Vector3f lo = points_[seed], hi = points_[seed];
+    float footprint = 0.0f;
+    uint32_t n_cells = 0;
+    visited_[seed] = 1;
+    stack_.assign(1, static_cast<int>(seed));
+    while (!stack_.empty()) {
+      const int i = stack_.back();
+      stack_.pop_back();
+      sum += points_[i].cast<double>();
+      lo = lo.cwiseMin(points_[i]);
+      hi = hi.cwiseMax(points_[i]);
+      footprint += depth_[i];
+      n_cells++;
+      const int r = i / cols, c = i % cols;
+      const float max_jump = params.depth_jump * depth_[i];
+      const auto visit = [&](int j) {
+        if (!visited_[j] && depth_[j] != 0.0f && std::abs(depth_[j] - depth_[i]) <= max_jump) {
+          visited_[j] = 1;
+          stack_.push_back(j);
+        }
+      };
+      if (c > 0) visit(i - 1);
+      if (c + 1 < cols) visit(i + 1);
+      if (r > 0) visit(i - cols);
+      if (r + 1 < rows) visit(i + cols);
+    }
+
+    // samples are a cell apart, a blob spans about one more cell than its samples
+    const double blob_extent = (hi - lo).maxCoeff() + step * inv_f * footprint / n_cells;
+    if (blob_extent < min_extent || blob_extent > max_extent) continue;
+    const Eigen::Vector3d centroid = sum / n_cells;
+    const double distance = (centroid - last_position).norm();
+    if (distance < best_distance) {
+      best_distance = distance;
+      found = centroid;
+    }
+  }
+  return best_distance < std::numeric_limits<double>::max();
+}
+
+size_t ReacquisitionScan::bytes() const {
+  return depth_.capacity() * sizeof(float) + points_.capacity() * sizeof(Eigen::Vector3f) + visited_.capacity() +
+         stack_.capacity() * sizeof(int);
+}
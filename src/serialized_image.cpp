@@ -0,0 +1,85 @@
+#include "serialized_image.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include "cdr_cursor.hpp"
+
+bool SerializedDepthImage::reset(const uint8_t *data, size_t size, std::string &error) {
+  pixels_ = nullptr;
+  if (size < 4 || data[1] != 0x01) {
+    error = "not a CDR little endian message";
+    return false;
+  }
+  CdrCursor cursor{data, size, 4};
+  int32_t sec;
+  uint32_t nanosec, height, width, step, data_size;
+  std::string encoding;
+  uint8_t big_endian;
+  if (!cursor.read(sec) || !cursor.read(nanosec) || !cursor.readString(frame_id_) || !cursor.read(height) ||
+      !cursor.read(width) || !cursor.readString(encoding) || !cursor.read(big_endian) || !cursor.read(step) ||
+      !cursor.read(data_size)) {
+    error = "truncated image header";
+    return false;
+  }
+
+  size_t pixel_size;
+  if (encoding == "16UC1" || encoding == "mono16") {
+    millimetres_ = true;
+    pixel_size = 2;
+  } else if (encoding == "32FC1") {
+    millimetres_ = false;
+    pixel_size = 4;
+  } else {
+    error = "unsupported depth encoding '" + encoding + "'";
+    return false;
+  }
+  if (width == 0 || height == 0 || step < width * pixel_size || data_size < size_t(step) * height || cursor.pos + data_size > size) {
+    error = "inconsistent image size";
+    return false;
+  }
+
+  stamp_ns_ = int64_t(sec) * 1000000000 + nanosec;
+  width_ = width;
+  height_ = height;
+  step_ = step;
+  // the message is little endian, the pixels follow is_bigendian
+  swap_ = big_endian != 0;
+  pixels_ = data + cursor.pos;
+  return true;
+}
+
+bool SerializedDepthImage::decodeRows(const RowRanges &rows, float *depth, size_t stride, std::string &error) const {
+  if (!pixels_) {
+    error = "no image";
+    return false;
+  }
+  for (const auto &range : mergeRowRanges(rows, height_)) {
+    for (int v = range.first; v < range.second; v++) {
+      const uint8_t *src = pixels_ + size_t(v) * step_;
+      float *row = depth + v * stride;
+      if (millimetres_) {
+        for (int u = 0; u < width_; u++) {
+          uint16_t raw;
+          std::memcpy(&raw, src + 2 * u, 2);
+          if (swap_) raw = uint16_t(raw << 8 | raw >> 8);
+          row[u] = raw * 0.001f;
+        }
+      } else if (!swap_) {
+        std::memcpy(row, src, width_ * sizeof(float));
+        for (int u = 0; u < width_; u++) {
+          if (!std::isfinite(row[u])) row[u] = 0.0f;
+        }
+      } else {
+        for (int u = 0; u < width_; u++) {
+          uint32_t raw;
+          std::memcpy(&raw, src + 4 * u, 4);
+          raw = __builtin_bswap32(raw);
+          std::memcpy(&row[u], &raw, 4);
+          if (!std::isfinite(row[u])) row[u] = 0.0f;
+        }
+      }
+    }
+  }
+  return true;
+}
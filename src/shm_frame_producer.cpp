@@ -0,0 +1,70 @@
+// Reference producer for the shared memory frame input of depthtection_node. Writes synthetic
+// depth frames (a plane with a box in front of it moving across the image) and the matching
+// detection.
+// usage: shm_frame_producer <name> [width height rate_hz class_id frame_id]
+
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "shm_frame_ring.hpp"
+
+static volatile std::sig_atomic_t running = 1;
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <name> [width height rate_hz class_id frame_id]" << std::endl;
+    return 1;
+  }
+  const std::string name = argv[1];
+  const uint32_t width = argc > 2 ? std::stoul(argv[2]) : 640;
+  const uint32_t height = argc > 3 ? std::stoul(argv[3]) : 480;
+  const double rate = argc > 4 ? std::stod(argv[4]) : 30.0;
+  const std::string class_id = argc > 5 ? argv[5] : "small_blue_box";
+  const std::string frame_id = argc > 6 ? argv[6] : "camera_link";
+
+  ShmFrameRing ring;
+  std::string error;
+  if (!ring.create(name, 4, width, height, 16, error)) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  std::signal(SIGINT, [](int) { running = 0; });
+  std::cout << "Publishing " << width << "x" << height << " frames at " << rate << " Hz on " << name << std::endl;
+
+  std::vector<float> depth(size_t(width) * height);
+  const auto period = std::chrono::duration<double>(1.0 / rate);
+  auto next = std::chrono::steady_clock::now();
+  for (uint64_t frame = 0; running; frame++) {
+    const int box_size = height / 6;
+    const int cx = width / 2 + static_cast<int>(width / 4 * std::sin(frame * 0.02));
+    const int cy = height / 2;
+    for (uint32_t v = 0; v < height; v++) {
+      for (uint32_t u = 0; u < width; u++) {
+        const bool in_box = std::abs(int(u) - cx) < box_size / 2 && std::abs(int(v) - cy) < box_size / 2;
+        depth[size_t(v) * width + u] = in_box ? 3.0f : 5.0f;
+      }
+    }
+    ShmDetection detection;
+    std::memset(&detection, 0, sizeof(detection));
+    std::strncpy(detection.class_id, class_id.c_str(), sizeof(detection.class_id) - 1);
+    detection.score = 0.9f;
+    detection.center_x = cx;
+    detection.center_y = cy;
+    detection.size_x = box_size;
+    detection.size_y = box_size;
+
+    const auto stamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+    ring.publish(stamp, frame_id, depth.data(), width, height, width * sizeof(float), &detection, 1);
+
+    next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+    std::this_thread::sleep_until(next);
+  }
+  return 0;
+}
@@ -0,0 +1,191 @@
+#include "shm_frame_ring.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+static size_t alignUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+static size_t slotSize(uint32_t max_width, uint32_t max_height, uint32_t max_detections) {
+  return alignUp(sizeof(ShmSlotHeader) + max_detections * sizeof(ShmDetection), 64) +
+         alignUp(size_t(max_width) * max_height * sizeof(float), 64);
+}
+
+ShmFrameRing::~ShmFrameRing() { close(); }
+
+bool ShmFrameRing::create(const std::string &name, uint32_t n_slots, uint32_t max_width, uint32_t max_height,
+                          uint32_t max_detections, std::string &error) {
+  close();
+  const size_t slot_size = slotSize(max_width, max_height, max_detections);
+  const size_t size = alignUp(sizeof(ShmRingHeader), 64) + n_slots * slot_size;
+
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    error = "shm_open " + name + ": " + std::strerror(errno);
+    return false;
+  }
+  if (ftruncate(fd, size) != 0) {
+    error = "ftruncate " + name + ": " + std::strerror(errno);
+    ::close(fd);
+    return false;
+  }
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    error = "mmap " + name + ": " + std::strerror(errno);
+    return false;
+  }
+
+  header_ = static_cast<ShmRingHeader *>(addr);
+  size_ = size;
+  name_ = name;
+  owner_ = true;
+  header_->version = SHM_FRAME_RING_VERSION;
+  header_->n_slots = n_slots;
+  header_->max_width = max_width;
+  header_->max_height = max_height;
+  header_->max_detections = max_detections;
+  header_->slot_size = slot_size;
+  header_->write_index.store(0, std::memory_order_relaxed);
+  for (uint32_t i = 0; i < n_slots; i++) {
+    reinterpret_cast<ShmSlotHeader *>(slot(i))->sequence.store(0, std::memory_order_relaxed);
+  }
+  // readers check the magic last
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header_->magic, SHM_FRAME_RING_MAGIC, sizeof(header_->magic));
+  return true;
+}
+
+bool ShmFrameRing::publish(int64_t stamp_ns, const std::string &frame_id, const float *depth, uint32_t width,
+                           uint32_t height, size_t step_bytes, const ShmDetection *detections,
+                           uint32_t n_detections) {
+  if (!header_ || width > header_->max_width || height > header_->max_height) {
+    return false;
+  }
+  const uint64_t index = header_->write_index.load(std::memory_order_relaxed);
+  char *s = slot(index % header_->n_slots);
+  auto *slot_header = reinterpret_cast<ShmSlotHeader *>(s);
+
+  const uint64_t sequence = slot_header->sequence.load(std::memory_order_relaxed);
+  slot_header->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot_header->stamp_ns = stamp_ns;
+  slot_header->width = width;
+  slot_header->height = height;
+  slot_header->n_detections = std::min(n_detections, header_->max_detections);
+  std::strncpy(slot_header->frame_id, frame_id.c_str(), sizeof(slot_header->frame_id) - 1);
+  slot_header->frame_id[sizeof(slot_header->frame_id) - 1] = '\0';
+  std::memcpy(slotDetections(s), detections, slot_header->n_detections * sizeof(ShmDetection));
+  float *dst = slotDepth(s);
+  for (uint32_t row = 0; row < height; row++) {
+    std::memcpy(dst + size_t(row) * width, reinterpret_cast<const char *>(depth) + row * step_bytes,
+                width * sizeof(float));
+  }
+
+  slot_header->sequence.store(sequence + 2, std::memory_order_release);
+  header_->write_index.store(index + 1, std::memory_order_release);
+  return true;
+}
+
+bool ShmFrameRing::open(const std::string &name, std::string &error) {
+  close();
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    error = "shm_open " + name + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader)) {
+    error = name + " is not a frame ring";
+    ::close(fd);
+    return false;
+  }
+  void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    error = "mmap " + name + ": " + std::strerror(errno);
+    return false;
+  }
+  auto *header = static_cast<ShmRingHeader *>(addr);
+  if (std::memcmp(header->magic, SHM_FRAME_RING_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != SHM_FRAME_RING_VERSION ||
+      alignUp(sizeof(ShmRingHeader), 64) + header->n_slots * header->slot_size > static_cast<size_t>(st.st_size)) {
+    error = name + " is not a compatible frame ring";
+    munmap(addr, st.st_size);
+    return false;
+  }
+  header_ = header;
+  size_ = st.st_size;
+  name_ = name;
+  owner_ = false;
+  last_read_ = header_->write_index.load(std::memory_order_acquire);
+  return true;
+}
+
+bool ShmFrameRing::latest(ShmFrameView &view, uint64_t &dropped) {
+  dropped = 0;
+  if (!header_) {
+    return false;
+  }
+  const uint64_t index = header_->write_index.load(std::memory_order_acquire);
+  if (index == last_read_ || index == 0) {
+    return false;
+  }
+  const char *s = slot((index - 1) % header_->n_slots);
+  const auto *slot_header = reinterpret_cast<const ShmSlotHeader *>(s);
+  const uint64_t sequence = slot_header->sequence.load(std::memory_order_acquire);
+  if (sequence & 1) {
+    // being rewritten, the producer lapped the whole ring
+    return false;
+  }
+  view.sequence = sequence;
+  view.frame_index = index - 1;
+  view.stamp_ns = slot_header->stamp_ns;
+  view.frame_id = slot_header->frame_id;
+  view.width = slot_header->width;
+  view.height = slot_header->height;
+  view.n_detections = slot_header->n_detections;
+  view.detections = slotDetections(const_cast<char *>(s));
+  view.depth = slotDepth(const_cast<char *>(s));
+  if (!stillValid(view)) {
+    return false;
+  }
+  dropped = index - last_read_ - 1;
+  last_read_ = index;
+  return true;
+}
+
+bool ShmFrameRing::stillValid(const ShmFrameView &view) const {
+  const char *s = slot(view.frame_index % header_->n_slots);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return reinterpret_cast<const ShmSlotHeader *>(s)->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+char *ShmFrameRing::slot(uint64_t index) const {
+  return reinterpret_cast<char *>(header_) + alignUp(sizeof(ShmRingHeader), 64) + index * header_->slot_size;
+}
+
+ShmDetection *ShmFrameRing::slotDetections(char *slot) const {
+  return reinterpret_cast<ShmDetection *>(slot + sizeof(ShmSlotHeader));
+}
+
+float *ShmFrameRing::slotDepth(char *slot) const {
+  return reinterpret_cast<float *>(slot +
+                                   alignUp(sizeof(ShmSlotHeader) + header_->max_detections * sizeof(ShmDetection), 64));
+}
+
+void ShmFrameRing::close() {
+  if (header_) {
+    munmap(header_, size_);
+    if (owner_) shm_unlink(name_.c_str());
+  }
+  header_ = nullptr;
+  size_ = 0;
+}
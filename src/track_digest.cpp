@@ -0,0 +1,158 @@
+#include "track_digest.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static constexpr double POSITION_QUANTUM = 0.01;  // m
+static constexpr double VELOCITY_QUANTUM = 0.01;  // m/s
+
+static void putVarint(std::vector<uint8_t> &buffer, uint64_t value) {
+  while (value >= 0x80) {
+    buffer.emplace_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  buffer.emplace_back(static_cast<uint8_t>(value));
+}
+
+static void putSigned(std::vector<uint8_t> &buffer, int64_t value) {
+  putVarint(buffer, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+template <typename T>
+static void putRaw(std::vector<uint8_t> &buffer, T value) {
+  const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+struct Reader {
+  const std::vector<uint8_t> &buffer;
+  size_t pos = 0;
+  bool ok = true;
+
+  uint64_t varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos >= buffer.size()) break;
+      const uint8_t byte = buffer[pos++];
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return value;
+    }
+    ok = false;
+    return 0;
+  }
+
+  int64_t signedVarint() {
+    const uint64_t value = varint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  template <typename T>
+  T raw() {
+    T value{};
+    if (pos + sizeof(T) > buffer.size()) {
+      ok = false;
+      return value;
+    }
+    std::copy(buffer.begin() + pos, buffer.begin() + pos + sizeof(T), reinterpret_cast<uint8_t *>(&value));
+    pos += sizeof(T);
+    return value;
+  }
+};
+
+static int64_t quantize(double value, double quantum) { return static_cast<int64_t>(std::llround(value / quantum)); }
+
+void encode_track_digest(const TrackDigest &digest, std::vector<uint8_t> &buffer) {
+  buffer.clear();
+  putRaw<uint8_t>(buffer, TRACK_DIGEST_VERSION);
+  putRaw<uint8_t>(buffer, digest.vehicle_id);
+  putRaw<uint16_t>(buffer, digest.sequence);
+  putRaw<int64_t>(buffer, digest.stamp_ns);
+
+  std::vector<const TrackDigestEntry *> tracks;
+  std::vector<std::string> classes;
+  tracks.reserve(digest.tracks.size());
+  for (const auto &track : digest.tracks) {
+    tracks.emplace_back(&track);
+    if (std::find(classes.begin(), classes.end(), track.class_name) == classes.end()) {
+      classes.emplace_back(track.class_name);
+    }
+  }
+  std::sort(tracks.begin(), tracks.end(), [](const auto *a, const auto *b) { return a->id < b->id; });
+  classes.resize(std::min<size_t>(classes.size(), 255));
+
+  putRaw<uint8_t>(buffer, classes.size());
+  for (const auto &name : classes) {
+    const size_t length = std::min<size_t>(name.size(), 255);
+    putRaw<uint8_t>(buffer, length);
+    buffer.insert(buffer.end(), name.begin(), name.begin() + length);
+  }
+
+  putVarint(buffer, tracks.size());
+  int last_id = 0;
+  int64_t last[3] = {0, 0, 0};
+  for (const auto *track : tracks) {
+    const size_t class_idx = std::find(classes.begin(), classes.end(), track->class_name) - classes.begin();
+    putVarint(buffer, track->id - last_id);
+    putVarint(buffer, class_idx);
+    for (int i = 0; i < 3; i++) {
+      const int64_t q = quantize(track->position[i], POSITION_QUANTUM);
+      putSigned(buffer, q - last[i]);
+      last[i] = q;
+    }
+    for (int i = 0; i < 3; i++) {
+      putSigned(buffer, quantize(track->velocity[i], VELOCITY_QUANTUM));
+    }
+    putRaw<uint8_t>(buffer, static_cast<uint8_t>(std::clamp(track->confidence, 0.0f, 1.0f) * 255.0f + 0.5f));
+    last_id = track->id;
+  }
+}
+
+bool decode_track_digest(const std::vector<uint8_t> &buffer, TrackDigest &digest) {
+  Reader reader{buffer};
+  if (reader.raw<uint8_t>() != TRACK_DIGEST_VERSION) {
+    return false;
+  }
+  digest.vehicle_id = reader.raw<uint8_t>();
+  digest.sequence = reader.raw<uint16_t>();
+  digest.stamp_ns = reader.raw<int64_t>();
+
+  std::vector<std::string> classes(reader.raw<uint8_t>());
+  for (auto &name : classes) {
+    const size_t length = reader.raw<uint8_t>();
+    if (!reader.ok || reader.pos + length > buffer.size()) {
+      return false;
+    }
+    name.assign(buffer.begin() + reader.pos, buffer.begin() + reader.pos + length);
+    reader.pos += length;
+  }
+
+  const uint64_t n_tracks = reader.varint();
+  // every track takes at least 9 bytes, reject absurd counts before allocating
+  if (!reader.ok || n_tracks > (buffer.size() - reader.pos) / 9) {
+    return false;
+  }
+  digest.tracks.resize(n_tracks);
+  int last_id = 0;
+  int64_t last[3] = {0, 0, 0};
+  for (auto &track : digest.tracks) {
+    const uint64_t id_delta = reader.varint();
+    const uint64_t class_idx = reader.varint();
+    if (id_delta > static_cast<uint64_t>(std::numeric_limits<int>::max() - last_id) || class_idx >= classes.size()) {
+      return false;
+    }
+    track.id = last_id + static_cast<int>(id_delta);
+    track.class_name = classes[class_idx];
+    for (int i = 0; i < 3; i++) {
+      // wraps instead of overflowing on corrupted deltas
+      last[i] = static_cast<int64_t>(static_cast<uint64_t>(last[i]) + static_cast<uint64_t>(reader.signedVarint()));
+      track.position[i] = last[i] * POSITION_QUANTUM;
+    }
+    for (int i = 0; i < 3; i++) {
+      track.velocity[i] = reader.signedVarint() * VELOCITY_QUANTUM;
+    }
+    track.confidence = reader.raw<uint8_t>() / 255.0f;
+    last_id = track.id;
+  }
+  return reader.ok;
+}
@@ -0,0 +1,79 @@
+#include "track_log.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+TrackLogWriter::~TrackLogWriter() { close(); }
+
+bool TrackLogWriter::open(const std::string &prefix, uint64_t records_per_file, int n_files, std::string &error) {
+  close();
+  if (records_per_file == 0 || n_files <= 0) {
+    error = "track log needs at least one file with one record";
+    return false;
+  }
+
+  const size_t size = sizeof(TrackLogHeader) + records_per_file * sizeof(TrackRecord);
+  for (int i = 0; i < n_files; i++) {
+    const std::string path = prefix + "_" + std::to_string(i) + ".bin";
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      error = "could not open " + path + ": " + std::strerror(errno);
+      close();
+      return false;
+    }
+    // reserve the blocks now so that page faults while logging never hit a full disk
+    int err = posix_fallocate(fd, 0, size);
+    if (err != 0) {
+      error = "could not allocate " + path + ": " + std::strerror(err);
+      ::close(fd);
+      close();
+      return false;
+    }
+    void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      error = "could not map " + path + ": " + std::strerror(errno);
+      close();
+      return false;
+    }
+
+    MappedFile file;
+    file.addr = addr;
+    file.size = size;
+    file.header = static_cast<TrackLogHeader *>(addr);
+    file.records = reinterpret_cast<TrackRecord *>(static_cast<char *>(addr) + sizeof(TrackLogHeader));
+    std::memcpy(file.header->magic, TRACK_LOG_MAGIC, sizeof(file.header->magic));
+    file.header->version = TRACK_LOG_VERSION;
+    file.header->record_size = sizeof(TrackRecord);
+    file.header->capacity = records_per_file;
+    file.header->sequence = 0;
+    file.header->count = 0;
+    files_.emplace_back(file);
+  }
+
+  current_ = 0;
+  sequence_ = 0;
+  files_[0].header->sequence = sequence_;
+  return true;
+}
+
+TrackLogWriter::MappedFile *TrackLogWriter::rotate() {
+  // hand the full file to the kernel and reuse the oldest one
+  msync(files_[current_].addr, files_[current_].size, MS_ASYNC);
+  current_ = (current_ + 1) % files_.size();
+  MappedFile *file = &files_[current_];
+  file->header->sequence = ++sequence_;
+  file->header->count = 0;
+  return file;
+}
+
+void TrackLogWriter::close() {
+  for (auto &file : files_) {
+    msync(file.addr, file.size, MS_SYNC);
+    munmap(file.addr, file.size);
+  }
+  files_.clear();
+}
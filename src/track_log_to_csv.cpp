@@ -0,0 +1,60 @@
+// Converts track log files written by depthtection_node to CSV.
+// usage: track_log_to_csv <prefix>_0.bin [<prefix>_1.bin ...] > tracks.csv
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "track_log.hpp"
+
+struct LogFile {
+  std::string path;
+  TrackLogHeader header;
+};
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <track_log_file>..." << std::endl;
+    return 1;
+  }
+
+  std::vector<LogFile> files;
+  for (int i = 1; i < argc; i++) {
+    LogFile file;
+    file.path = argv[i];
+    std::ifstream in(file.path, std::ios::binary);
+    if (!in.read(reinterpret_cast<char *>(&file.header), sizeof(file.header)) ||
+        std::memcmp(file.header.magic, TRACK_LOG_MAGIC, sizeof(file.header.magic)) != 0) {
+      std::cerr << "skipping " << file.path << ": not a track log" << std::endl;
+      continue;
+    }
+    if (file.header.version != TRACK_LOG_VERSION || file.header.record_size != sizeof(TrackRecord)) {
+      std::cerr << "skipping " << file.path << ": unsupported version " << file.header.version << std::endl;
+      continue;
+    }
+    files.emplace_back(file);
+  }
+  // the ring is written in sequence order
+  std::sort(files.begin(), files.end(),
+            [](const LogFile &a, const LogFile &b) { return a.header.sequence < b.header.sequence; });
+
+  std::printf(
+      "stamp_ns,track_id,confidence,phase,source,raw_x,raw_y,raw_z,filtered_x,filtered_y,filtered_z,"
+      "predicted_x,predicted_y,predicted_z,vx,vy,vz\n");
+  for (const auto &file : files) {
+    std::ifstream in(file.path, std::ios::binary);
+    in.seekg(sizeof(TrackLogHeader));
+    const uint64_t count = std::min(file.header.count, file.header.capacity);
+    TrackRecord r;
+    for (uint64_t i = 0; i < count && in.read(reinterpret_cast<char *>(&r), sizeof(r)); i++) {
+      std::printf("%ld,%d,%f,%u,%u,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f\n", static_cast<long>(r.stamp_ns), r.track_id,
+                  r.confidence, r.phase, r.source, r.raw[0], r.raw[1], r.raw[2], r.filtered[0], r.filtered[1],
+                  r.filtered[2], r.predicted[0], r.predicted[1], r.predicted[2], r.velocity[0], r.velocity[1],
+                  r.velocity[2]);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,238 @@
+#include "track_table.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// Masks of the commit loop are integer compares applied with bitwise ands. Float compares, or
+// a float multiplied by a 0/1 condition, may trap, so GCC keeps them as branches and the loop
+// does not vectorize.
+static inline int32_t floatBits(float x) {
+  int32_t i;
+  std::memcpy(&i, &x, sizeof(i));
+  return i;
+}
+
+static inline float bitsToFloat(int32_t i) {
+  float x;
+  std::memcpy(&x, &i, sizeof(x));
+  return x;
+}
+
+// Float bits as an integer with the same order
+static inline int32_t orderedBits(float x) {
+  const int32_t i = floatBits(x);
+  return i ^ ((i >> 31) & 0x7fffffff);
+}
+
+// x where mask is all ones, 0 where it is zero
+static inline float masked(float x, int32_t mask) { return bitsToFloat(floatBits(x) & mask); }
+
+uint32_t TrackTable::add(const Eigen::Vector3f &position, double stamp) {
+  uint32_t slot;
+  if (!free_.empty()) {
+    slot = free_.back();
+    free_.pop_back();
+  } else {
+    slot = fx_.size();
+    for (auto *v : {&fx_, &fy_, &fz_, &vx_, &vy_, &vz_, &cx_, &cy_, &cz_, &px_, &py_, &pz_, &ax_, &ay_, &az_, &mx_,
+                    &my_, &mz_, &staged_}) {
+      v->emplace_back(0.0f);
+    }
+    speed_samples_.emplace_back(0);
+    anchor_t_.emplace_back(0.0);
+    last_t_.emplace_back(0.0);
+    history_.resize(history_.size() + HISTORY);
+    history_begin_.emplace_back(0);
+    history_size_.emplace_back(0);
+  }
+  fx_[slot] = cx_[slot] = px_[slot] = ax_[slot] = position.x();
+  fy_[slot] = cy_[slot] = py_[slot] = ay_[slot] = position.y();
+  fz_[slot] = cz_[slot] = pz_[slot] = az_[slot] = position.z();
+  vx_[slot] = vy_[slot] = vz_[slot] = 0.0f;
+  anchor_t_[slot] = last_t_[slot] = stamp;
+  // the creation position is the first speed anchor
+  speed_samples_[slot] = 1;
+  staged_[slot] = 0.0f;
+  history_size_[slot] = 0;
+  return slot;
+}
+
+void TrackTable::remove(uint32_t slot) {
+  staged_[slot] = 0.0f;
+  free_.push_back(slot);
+}
+
+void TrackTable::stage(uint32_t slot, const Eigen::Vector3f &measurement) {
+  mx_[slot] = measurement.x();
+  my_[slot] = measurement.y();
+  mz_[slot] = measurement.z();
+  if (staged_[slot] == 0.0f) staged_slots_.push_back(slot);
+  staged_[slot] = 1.0f;
+}
+
+void TrackTable::commit(double stamp) {
+  for (const uint32_t i : staged_slots_) {
+    if (staged_[i] == 0.0f) continue;  // removed since
+    if (stamp < last_t_[i]) {
+      replay(i, stamp);
+    } else {
+      record(i, stamp);
+    }
+  }
+  staged_slots_.clear();
+  apply(0, fx_.size(), stamp);
+}
+
+void TrackTable::record(uint32_t slot, double stamp) {
+  if (history_size_[slot] == HISTORY) {
+    history_begin_[slot] = (history_begin_[slot] + 1) % HISTORY;
+    history_size_[slot]--;
+  }
+  HistoryEntry &e = entry(slot, history_size_[slot]++);
+  e.stamp = stamp;
+  e.mx = mx_[slot], e.my = my_[slot], e.mz = mz_[slot];
+  e.fx = fx_[slot], e.fy = fy_[slot], e.fz = fz_[slot];
+  e.vx = vx_[slot], e.vy = vy_[slot], e.vz = vz_[slot];
+  e.ax = ax_[slot], e.ay = ay_[slot], e.az = az_[slot];
+  e.speed_samples = speed_samples_[slot];
+  e.anchor_t = anchor_t_[slot];
+  e.last_t = last_t_[slot];
+}
+
+void TrackTable::replay(uint32_t slot, double stamp) {
+  const Eigen::Vector3f late(mx_[slot], my_[slot], mz_[slot]);
+  staged_[slot] = 0.0f;
+
+  // first measurement newer than the late one, the state before it must be older
+  int k = history_size_[slot];
+  while (k > 0 && entry(slot, k - 1).stamp > stamp) k--;
+  if (k == history_size_[slot] || stamp < entry(slot, k).last_t) {
+    dropped_late_measurements_++;
+    return;
+  }
+  replayed_.assign(1, entry(slot, k));
+  for (int j = k + 1; j < history_size_[slot]; j++) replayed_.push_back(entry(slot, j));
+
+  const HistoryEntry &e = replayed_[0];
+  fx_[slot] = e.fx, fy_[slot] = e.fy, fz_[slot] = e.fz;
+  vx_[slot] = e.vx, vy_[slot] = e.vy, vz_[slot] = e.vz;
+  ax_[slot] = e.ax, ay_[slot] = e.ay, az_[slot] = e.az;
+  speed_samples_[slot] = e.speed_samples;
+  anchor_t_[slot] = e.anchor_t;
+  last_t_[slot] = e.last_t;
+  history_size_[slot] = k;
+
+  step(slot, late, stamp);
+  for (const auto &later : replayed_) step(slot, Eigen::Vector3f(later.mx, later.my, later.mz), later.stamp);
+  late_measurements_++;
+}
+
+void TrackTable::step(uint32_t slot, const Eigen::Vector3f &measurement, double stamp) {
+  // staged directly, stage() would append to the list commit is walking
+  mx_[slot] = measurement.x();
+  my_[slot] = measurement.y();
+  mz_[slot] = measurement.z();
+  staged_[slot] = 1.0f;
+  record(slot, stamp);
+  apply(slot, slot + 1, stamp);
+}
+
+void TrackTable::apply(size_t begin, size_t end, double stamp) {
+  float *fx = fx_.data(), *fy = fy_.data(), *fz = fz_.data();
+  float *vx = vx_.data(), *vy = vy_.data(), *vz = vz_.data();
+  float *cx = cx_.data(), *cy = cy_.data(), *cz = cz_.data();
+  float *px = px_.data(), *py = py_.data(), *pz = pz_.data();
+  float *ax = ax_.data(), *ay = ay_.data(), *az = az_.data();
+  float *staged = staged_.data();
+  int32_t *samples = speed_samples_.data();
+  const float *mx = mx_.data(), *my = my_.data(), *mz = mz_.data();
+  double *anchor_t = anchor_t_.data(), *last_t = last_t_.data();
+
+  const int32_t speed_period = orderedBits(static_cast<float>(SPEED_PERIOD));
+  const int32_t min_elapsed = orderedBits(1e-3f);
+
+  // every lane runs the same arithmetic, the masks only zero terms. The arrays never alias.
+#pragma GCC ivdep
+  for (size_t i = begin; i < end; i++) {
+    const float m = staged[i];
+    const float a = ALPHA * m;
+    fx[i] += a * (mx[i] - fx[i]);
+    fy[i] += a * (my[i] - fy[i]);
+    fz[i] += a * (mz[i] - fz[i]);
+
+    const int32_t elapsed = orderedBits(static_cast<float>(stamp - anchor_t[i]));
+    const int32_t sample_mask =
+        -static_cast<int32_t>(floatBits(m) != 0) & -static_cast<int32_t>(elapsed >= speed_period);
+    const float sample = masked(1.0f, sample_mask);
+    const float first = masked(sample, -static_cast<int32_t>(samples[i] == 1));
+    // the first sample sets the speed, the next ones are averaged in
+    const float w = first + (sample - first) * ALPHA;
+    // positive, its ordered bits are its bits
+    const float inv_elapsed = 1.0f / bitsToFloat(std::max(elapsed, min_elapsed));
+    vx[i] += w * ((fx[i] - ax[i]) * inv_elapsed - vx[i]);
+    vy[i] += w * ((fy[i] - ay[i]) * inv_elapsed - vy[i]);
+    vz[i] += w * ((fz[i] - az[i]) * inv_elapsed - vz[i]);
+    ax[i] += sample * (fx[i] - ax[i]);
+    ay[i] += sample * (fy[i] - ay[i]);
+    az[i] += sample * (fz[i] - az[i]);
+    anchor_t[i] += sample * (stamp - anchor_t[i]);
+    samples[i] += sample_mask & 1;
+    last_t[i] += m * (stamp - last_t[i]);
+
+    const float h = masked(COMPENSATION_HORIZON, -static_cast<int32_t>(samples[i] > SPEED_SAMPLES_BEFORE_PREDICTION));
+    cx[i] = fx[i] + h * vx[i];
+    cy[i] = fy[i] + h * vy[i];
+    cz[i] = fz[i] + h * vz[i];
+    px[i] = fx[i];
+    py[i] = fy[i];
+    pz[i] = fz[i];
+    staged[i] = 0.0f;
+  }
+}
+
+void TrackTable::predict(double stamp) {
+  const size_t n = fx_.size();
+  const float *fx = fx_.data(), *fy = fy_.data(), *fz = fz_.data();
+  const float *vx = vx_.data(), *vy = vy_.data(), *vz = vz_.data();
+  float *px = px_.data(), *py = py_.data(), *pz = pz_.data();
+  const double *last_t = last_t_.data();
+#pragma GCC ivdep
+  for (size_t i = 0; i < n; i++) {
+    const float dt = static_cast<float>(stamp - last_t[i]);
+    px[i] = fx[i] + dt * vx[i];
+    py[i] = fy[i] + dt * vy[i];
+    pz[i] = fz[i] + dt * vz[i];
+  }
+}
+
+void TrackTable::blend(uint32_t slot, const Eigen::Vector3f &position, const Eigen::Vector3f &velocity, float w) {
+  fx_[slot] += w * (position.x() - fx_[slot]);
+  fy_[slot] += w * (position.y() - fy_[slot]);
+  fz_[slot] += w * (position.z() - fz_[slot]);
+  vx_[slot] += w * (velocity.x() - vx_[slot]);
+  vy_[slot] += w * (velocity.y() - vy_[slot]);
+  vz_[slot] += w * (velocity.z() - vz_[slot]);
+  const float h = hasCompensation(slot) ? COMPENSATION_HORIZON : 0.0f;
+  cx_[slot] = fx_[slot] + h * vx_[slot];
+  cy_[slot] = fy_[slot] + h * vy_[slot];
+  cz_[slot] = fz_[slot] + h * vz_[slot];
+  px_[slot] = fx_[slot];
+  py_[slot] = fy_[slot];
+  pz_[slot] = fz_[slot];
+  history_size_[slot] = 0;
+}
+
+void TrackTable::fuse(uint32_t kept, uint32_t removed, float w_kept, float w_removed) {
+  for (auto *v : {&fx_, &fy_, &fz_, &vx_, &vy_, &vz_, &cx_, &cy_, &cz_, &px_, &py_, &pz_}) {
+    (*v)[kept] = w_kept * (*v)[kept] + w_removed * (*v)[removed];
+  }
+  speed_samples_[kept] = std::max(speed_samples_[kept], speed_samples_[removed]);
+  history_size_[kept] = 0;
+}
+
+size_t TrackTable::bytes() const {
+  return fx_.capacity() * 20 * sizeof(float) + anchor_t_.capacity() * 2 * sizeof(double) +
+         free_.capacity() * sizeof(uint32_t) + history_.capacity() * sizeof(HistoryEntry) +
+         history_begin_.capacity() * 2 + replayed_.capacity() * sizeof(HistoryEntry) +
+         staged_slots_.capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "association.hpp"
+
+static Eigen::Vector3d at(double x, double y = 0.0) { return Eigen::Vector3d(x, y, 1.0); }
+
+// assignment cost as the Associator defines it: squared distances, gate squared per measurement left out
+static double totalCost(const std::vector<Eigen::Vector3d>& measurements, const std::vector<Eigen::Vector3d>& tracks,
+                        const std::vector<int>& assignment, double gate) {
+  double cost = 0.0;
+  for (size_t i = 0; i < measurements.size(); i++) {
+    cost += assignment[i] < 0 ? gate * gate : (measurements[i] - tracks[assignment[i]]).squaredNorm();
+  }
+  return cost;
+}
+
+static void bruteForce(const std::vector<Eigen::Vector3d>& measurements, const std::vector<int>& measurement_classes,
+                       const std::vector<Eigen::Vector3d>& tracks, const std::vector<int>& track_classes, double gate,
+                       size_t i, std::vector<int>& assignment, std::vector<bool>& used, double& best) {
+  if (i == measurements.size()) {
+    best = std::min(best, totalCost(measurements, tracks, assignment, gate));
+    return;
+  }
+  assignment[i] = -1;
+  bruteForce(measurements, measurement_classes, tracks, track_classes, gate, i + 1, assignment, used, best);
+  for (size_t t = 0; t < tracks.size(); t++) {
+    if (used[t] || track_classes[t] != measurement_classes[i] || (measurements[i] - tracks[t]).norm() > gate) continue;
+    used[t] = true;
+    assignment[i] = t;
+    bruteForce(measurements, measurement_classes, tracks, track_classes, gate, i + 1, assignment, used, best);
+    used[t] = false;
+  }
+  assignment[i] = -1;
+}
+
+TEST(Associator, HungarianBeatsGreedy) {
+  // m0 is closest to t0, taking it leaves m1 with no track within the gate
+  const std::vector<Eigen::Vector3d> measurements = {at(0.3), at(-0.4)};
+  const std::vector<Eigen::Vector3d> tracks = {at(0.0), at(0.9)};
+  const std::vector<int> classes = {0, 0};
+  const double gate = 1.0;
+  Associator associator;
+  std::vector<int> assignment;
+
+  associator.solve(measurements, classes, tracks, classes, gate, 8, assignment);
+  EXPECT_EQ(assignment, (std::vector<int>{1, 0}));
+  EXPECT_EQ(associator.components(), 1);
+  EXPECT_EQ(associator.greedyComponents(), 0);
+  const double optimal = totalCost(measurements, tracks, assignment, gate);
+
+  // the same component over max_component is assigned closest pair first
+  associator.solve(measurements, classes, tracks, classes, gate, 1, assignment);
+  EXPECT_EQ(assignment, (std::vector<int>{0, -1}));
+  EXPECT_EQ(associator.greedyComponents(), 1);
+  EXPECT_GT(totalCost(measurements, tracks, assignment, gate), optimal);
+}
+
+TEST(Associator, RespectsClassesAndGate) {
+  const std::vector<Eigen::Vector3d> measurements = {at(0.0), at(5.0), at(10.0)};
+  const std::vector<int> measurement_classes = {0, 1, 0};
+  const std::vector<Eigen::Vector3d> tracks = {at(0.1), at(5.1), at(10.1), at(12.0)};
+  // a track of the other class next to the first measurement, one no measurement may take
+  const std::vector<int> track_classes = {1, 1, -1, 0};
+  Associator associator;
+  std::vector<int> assignment;
+  associator.solve(measurements, measurement_classes, tracks, track_classes, 1.0, 8, assignment);
+  EXPECT_EQ(assignment, (std::vector<int>{-1, 1, -1}));
+
+  // within a wider gate the last one reaches the track of its class
+  associator.solve(measurements, measurement_classes, tracks, track_classes, 2.5, 8, assignment);
+  EXPECT_EQ(assignment, (std::vector<int>{-1, 1, 3}));
+}
+
+TEST(Associator, ComponentsAreIndependentOfOrder) {
+  // two clusters far apart
+  std::vector<Eigen::Vector3d> measurements = {at(0.0), at(0.5), at(100.0), at(100.4)};
+  const std::vector<Eigen::Vector3d> tracks = {at(100.2), at(0.2), at(0.6), at(100.5)};
+  const std::vector<int> classes = {0, 0, 0, 0};
+  Associator associator;
+  std::vector<int> assignment;
+  associator.solve(measurements, classes, tracks, classes, 1.0, 8, assignment);
+  EXPECT_EQ(associator.components(), 2);
+  // in measurements or tracks, whichever is more
+  EXPECT_EQ(associator.largestComponent(), 2);
+  const std::vector<int> forward = assignment;
+
+  std::reverse(measurements.begin(), measurements.end());
+  associator.solve(measurements, classes, tracks, classes, 1.0, 8, assignment);
+  std::reverse(assignment.begin(), assignment.end());
+  EXPECT_EQ(assignment, forward);
+}
+
+TEST(Associator, OptimalOnRandomClusters) {
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<double> position(0.0, 2.0);
+  std::uniform_int_distribution<int> count(1, 5);
+  Associator associator;
+  std::vector<int> assignment;
+  for (int trial = 0; trial < 300; trial++) {
+    std::vector<Eigen::Vector3d> measurements(count(rng)), tracks(count(rng));
+    for (auto& m : measurements) m = at(position(rng), position(rng));
+    for (auto& t : tracks) t = at(position(rng), position(rng));
+    std::vector<int> measurement_classes(measurements.size()), track_classes(tracks.size());
+    for (auto& c : measurement_classes) c = rng() % 2;
+    for (auto& c : track_classes) c = rng() % 2;
+    const double gate = 0.8;
+
+    associator.solve(measurements, measurement_classes, tracks, track_classes, gate, 8, assignment);
+    std::vector<bool> used(tracks.size(), false);
+    for (size_t i = 0; i < assignment.size(); i++) {
+      if (assignment[i] < 0) continue;
+      ASSERT_FALSE(used[assignment[i]]) << trial;
+      used[assignment[i]] = true;
+      ASSERT_EQ(track_classes[assignment[i]], measurement_classes[i]) << trial;
+      ASSERT_LE((measurements[i] - tracks[assignment[i]]).norm(), gate) << trial;
+    }
+
+    double best = std::numeric_limits<double>::max();
+    std::vector<int> candidate(measurements.size(), -1);
+    used.assign(tracks.size(), false);
+    bruteForce(measurements, measurement_classes, tracks, track_classes, gate, 0, candidate, used, best);
+    EXPECT_NEAR(totalCost(measurements, tracks, assignment, gate), best, 1e-9) << trial;
+  }
+}
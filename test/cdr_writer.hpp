@@ -0,0 +1,93 @@
+/**
+ * @file cdr_writer.hpp
+ * @brief CDR little endian encoding of the messages the in place parsers read, for the tests.
+ */
+
+#ifndef __CDR_WRITER_HPP__
+#define __CDR_WRITER_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Mirror of CdrCursor, alignment is relative to the end of the encapsulation header
+class CdrWriter {
+  public:
+  CdrWriter() : buffer_{0x00, 0x01, 0x00, 0x00} {}
+
+  template <typename T>
+  void put(T value) {
+    align(sizeof(T));
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    buffer_.insert(buffer_.end(), bytes, bytes + sizeof(T));
+  }
+  void putString(const std::string& value) {
+    put<uint32_t>(value.size() + 1);
+    buffer_.insert(buffer_.end(), value.begin(), value.end());
+    buffer_.push_back(0);
+  }
+  void putBytes(const std::vector<uint8_t>& bytes) {
+    put<uint32_t>(bytes.size());
+    buffer_.insert(buffer_.end(), bytes.begin(), bytes.end());
+  }
+
+  const std::vector<uint8_t>& buffer() const { return buffer_; }
+
+  private:
+  void align(size_t n) {
+    while ((buffer_.size() - 4) % n) buffer_.push_back(0);
+  }
+
+  std::vector<uint8_t> buffer_;
+};
+
+// sensor_msgs/Image
+inline std::vector<uint8_t> encodeImage(int32_t sec, uint32_t nanosec, const std::string& frame_id, uint32_t height,
+                                        uint32_t width, const std::string& encoding, bool big_endian, uint32_t step,
+                                        const std::vector<uint8_t>& data) {
+  CdrWriter writer;
+  writer.put(sec);
+  writer.put(nanosec);
+  writer.putString(frame_id);
+  writer.put(height);
+  writer.put(width);
+  writer.putString(encoding);
+  writer.put<uint8_t>(big_endian);
+  writer.put(step);
+  writer.putBytes(data);
+  return writer.buffer();
+}
+
+struct CloudField {
+  std::string name;
+  uint32_t offset;
+  uint8_t datatype;
+};
+
+// sensor_msgs/PointCloud2
+inline std::vector<uint8_t> encodeCloud(int32_t sec, uint32_t nanosec, const std::string& frame_id, uint32_t height,
+                                        uint32_t width, const std::vector<CloudField>& fields, uint32_t point_step,
+                                        uint32_t row_step, const std::vector<uint8_t>& data) {
+  CdrWriter writer;
+  writer.put(sec);
+  writer.put(nanosec);
+  writer.putString(frame_id);
+  writer.put(height);
+  writer.put(width);
+  writer.put<uint32_t>(fields.size());
+  for (const auto& field : fields) {
+    writer.putString(field.name);
+    writer.put(field.offset);
+    writer.put(field.datatype);
+    writer.put<uint32_t>(1);
+  }
+  writer.put<uint8_t>(0);
+  writer.put(point_step);
+  writer.put(row_step);
+  writer.putBytes(data);
+  writer.put<uint8_t>(1);  // is_dense
+  return writer.buffer();
+}
+
+#endif  // __CDR_WRITER_HPP__
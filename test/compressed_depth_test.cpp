@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+
+#include "compressed_depth.hpp"
+
+static const float UNTOUCHED = -1.0f;
+
+// compressed_depth_image_transport ConfigHeader: format, depthQuantA, depthQuantB
+static std::vector<uint8_t> configHeader(float depth_quant_a, float depth_quant_b) {
+  std::vector<uint8_t> header(12, 0);
+  std::memcpy(&header[4], &depth_quant_a, 4);
+  std::memcpy(&header[8], &depth_quant_b, 4);
+  return header;
+}
+
+// Reference RVL encoder (A. Wilson, 2017), as written by compressed_depth_image_transport
+class RvlEncoder {
+  public:
+  std::vector<uint8_t> encode(const std::vector<uint16_t>& image, uint32_t width, uint32_t height) {
+    out_ = configHeader(0.0f, 0.0f);
+    putWord(width);
+    putWord(height);
+    word_ = 0;
+    nibbles_ = 0;
+    int previous = 0;
+    for (size_t i = 0; i < image.size();) {
+      size_t zeros = 0, nonzeros = 0;
+      for (; i < image.size() && image[i] == 0; i++) zeros++;
+      for (size_t j = i; j < image.size() && image[j] != 0; j++) nonzeros++;
+      encodeVle(zeros);
+      encodeVle(nonzeros);
+      for (; nonzeros; nonzeros--, i++) {
+        const int delta = image[i] - previous;
+        encodeVle((static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+        previous = image[i];
+      }
+    }
+    if (nibbles_) putWord(word_ << (4 * (8 - nibbles_)));
+    return out_;
+  }
+
+  private:
+  void encodeVle(uint32_t value) {
+    do {
+      uint32_t nibble = value & 0x7;
+      if (value >>= 3) nibble |= 0x8;
+      word_ = (word_ << 4) | nibble;
+      if (++nibbles_ == 8) {
+        putWord(word_);
+        word_ = 0;
+        nibbles_ = 0;
+      }
+    } while (value);
+  }
+  void putWord(uint32_t word) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&word);
+    out_.insert(out_.end(), bytes, bytes + 4);
+  }
+
+  std::vector<uint8_t> out_;
+  uint32_t word_ = 0;
+  int nibbles_ = 0;
+};
+
+static void pngWrite(png_structp png, png_bytep data, png_size_t length) {
+  auto* out = static_cast<std::vector<uint8_t>*>(png_get_io_ptr(png));
+  out->insert(out->end(), data, data + length);
+}
+
+static std::vector<uint8_t> encodePng(const std::vector<uint16_t>& image, int width, int height, bool interlaced) {
+  std::vector<uint8_t> out = configHeader(0.0f, 0.0f);
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  png_infop info = png_create_info_struct(png);
+  png_set_write_fn(png, &out, pngWrite, nullptr);
+  png_set_IHDR(png, info, width, height, 16, PNG_COLOR_TYPE_GRAY,
+               interlaced ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+               PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+  png_set_swap(png);
+  std::vector<png_bytep> rows(height);
+  for (int v = 0; v < height; v++) rows[v] = (png_bytep)&image[size_t(v) * width];
+  png_write_image(png, rows.data());
+  png_write_end(png, nullptr);
+  png_destroy_write_struct(&png, &info);
+  return out;
+}
+
+// runs of zeros, some across rows, and deltas of every size
+static std::vector<uint16_t> testImage(int width, int height) {
+  std::mt19937 rng(7);
+  std::vector<uint16_t> image(size_t(width) * height);
+  for (size_t i = 0; i < image.size(); i++) {
+    const size_t v = i / width;
+    if ((i / 13) % 4 == 0 || v == 3) continue;
+    image[i] = static_cast<uint16_t>(rng() % 3 == 0 ? rng() : 1000 + i % 50);
+  }
+  return image;
+}
+
+static void expectRows(const CompressedDepthDecoder& decoder, const std::vector<uint16_t>& image,
+                       const std::vector<float>& depth, const RowRanges& rows) {
+  const int width = decoder.width();
+  for (int v = 0; v < decoder.height(); v++) {
+    bool requested = false;
+    for (const auto& range : rows) requested |= v >= range.first && v < range.second;
+    for (int u = 0; u < width; u++) {
+      const uint16_t raw = image[size_t(v) * width + u];
+      ASSERT_EQ(depth[size_t(v) * width + u], requested ? raw * 0.001f : UNTOUCHED) << v << " " << u;
+    }
+  }
+}
+
+static void checkRoundTrip(const std::string& format, const std::vector<uint8_t>& payload,
+                           const std::vector<uint16_t>& image, int width, int height) {
+  CompressedDepthDecoder decoder;
+  std::string error;
+  ASSERT_TRUE(decoder.reset(format, payload.data(), payload.size(), error)) << error;
+  ASSERT_EQ(decoder.width(), width);
+  ASSERT_EQ(decoder.height(), height);
+
+  // forward, then behind the first request, then the whole image
+  const std::vector<RowRanges> requests = {{{5, 9}, {20, 22}}, {{1, 3}}, {{0, height}}};
+  for (const auto& rows : requests) {
+    std::vector<float> depth(size_t(width) * height, UNTOUCHED);
+    ASSERT_TRUE(decoder.decodeRows(rows, depth.data(), width, error)) << error;
+    expectRows(decoder, image, depth, rows);
+  }
+}
+
+TEST(CompressedDepth, RvlRoundTrip) {
+  const int width = 37, height = 29;
+  const auto image = testImage(width, height);
+  checkRoundTrip("16UC1; compressedDepth rvl", RvlEncoder().encode(image, width, height), image, width, height);
+}
+
+TEST(CompressedDepth, PngRoundTrip) {
+  const int width = 37, height = 29;
+  const auto image = testImage(width, height);
+  checkRoundTrip("16UC1; compressedDepth png", encodePng(image, width, height, false), image, width, height);
+  checkRoundTrip("16UC1; compressedDepth png", encodePng(image, width, height, true), image, width, height);
+}
+
+TEST(CompressedDepth, InverseDepthQuantization) {
+  const int width = 4, height = 2;
+  const std::vector<uint16_t> image = {0, 100, 200, 300, 400, 500, 600, 0};
+  auto payload = RvlEncoder().encode(image, width, height);
+  const auto header = configHeader(2000.0f, 50.0f);
+  std::copy(header.begin(), header.end(), payload.begin());
+
+  CompressedDepthDecoder decoder;
+  std::string error;
+  ASSERT_TRUE(decoder.reset("32FC1; compressedDepth rvl", payload.data(), payload.size(), error)) << error;
+  std::vector<float> depth(width * height, UNTOUCHED);
+  ASSERT_TRUE(decoder.decodeRows({{0, height}}, depth.data(), width, error)) << error;
+  for (size_t i = 0; i < image.size(); i++) {
+    EXPECT_EQ(depth[i], image[i] ? 2000.0f / (image[i] - 50.0f) : 0.0f) << i;
+  }
+}
+
+TEST(CompressedDepth, RejectsTruncatedStreams) {
+  const int width = 16, height = 12;
+  const auto image = testImage(width, height);
+  const std::pair<std::string, std::vector<uint8_t>> streams[] = {
+      {"16UC1; compressedDepth rvl", RvlEncoder().encode(image, width, height)},
+      {"16UC1; compressedDepth png", encodePng(image, width, height, false)},
+  };
+  std::vector<float> depth(width * height);
+  for (const auto& [format, payload] : streams) {
+    for (size_t size = 0; size < payload.size(); size++) {
+      CompressedDepthDecoder decoder;
+      std::string error;
+      // the PNG trailer is never read, a stream cut there still decodes
+      const bool decoded = decoder.reset(format, payload.data(), size, error) &&
+                           decoder.decodeRows({{0, height}}, depth.data(), width, error);
+      if (decoded) EXPECT_TRUE(format.find("png") != std::string::npos) << format << " " << size;
+    }
+  }
+}
+
+TEST(CompressedDepth, RejectsBadHeaders) {
+  const auto image = testImage(4, 4);
+  const auto rvl = RvlEncoder().encode(image, 4, 4);
+  CompressedDepthDecoder decoder;
+  std::string error;
+  EXPECT_FALSE(decoder.reset("8UC1; compressedDepth rvl", rvl.data(), rvl.size(), error));
+  EXPECT_FALSE(decoder.reset("16UC1; png", rvl.data(), rvl.size(), error));
+  EXPECT_FALSE(decoder.reset("16UC1; compressedDepth png", rvl.data(), rvl.size(), error));
+
+  // dimensions no depth camera produces
+  for (const uint32_t dims : {0u, 0x7fffffffu, 0xffffffffu}) {
+    auto bad = rvl;
+    std::memcpy(&bad[16], &dims, 4);
+    EXPECT_FALSE(decoder.reset("16UC1; compressedDepth rvl", bad.data(), bad.size(), error)) << dims;
+  }
+}
+
+// Whatever reset accepts must decode within the payload, checked by the sanitizers
+TEST(CompressedDepth, SurvivesCorruption) {
+  const int width = 23, height = 17;
+  const auto image = testImage(width, height);
+  const std::pair<std::string, std::vector<uint8_t>> streams[] = {
+      {"16UC1; compressedDepth rvl", RvlEncoder().encode(image, width, height)},
+      {"16UC1; compressedDepth png", encodePng(image, width, height, false)},
+      {"16UC1; compressedDepth png", encodePng(image, width, height, true)},
+  };
+  std::mt19937 rng(3);
+  std::vector<float> depth;
+  for (const auto& [format, original] : streams) {
+    for (int trial = 0; trial < 2000; trial++) {
+      auto payload = original;
+      const int flips = 1 + trial % 4;
+      for (int i = 0; i < flips; i++) payload[rng() % payload.size()] = static_cast<uint8_t>(rng());
+      CompressedDepthDecoder decoder;
+      std::string error;
+      if (!decoder.reset(format, payload.data(), payload.size(), error)) continue;
+      ASSERT_GT(decoder.width(), 0);
+      ASSERT_GT(decoder.height(), 0);
+      if (size_t(decoder.width()) * decoder.height() > (1u << 22)) continue;
+      depth.assign(size_t(decoder.width()) * decoder.height(), UNTOUCHED);
+      decoder.decodeRows({{decoder.height() / 2, decoder.height()}, {0, 2}}, depth.data(), decoder.width(), error);
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <vector>
+
+#include "detection_filter.hpp"
+
+static DetectionSummary detection(std::string_view class_id, float score, double size_x = 40.0,
+                                  double size_y = 30.0) {
+  return {true, class_id, score, size_x, size_y};
+}
+
+TEST(DetectionFilter, AcceptsEverythingByDefault) {
+  DetectionFilter filter;
+  const std::vector<DetectionSummary> detections = {detection("drone", 0.0f), detection("bird", 1.0f, 1.0, 1e4)};
+  std::vector<int> kept;
+  filter.select(detections, kept);
+  EXPECT_EQ(kept, (std::vector<int>{0, 1}));
+}
+
+TEST(DetectionFilter, CountsEachRejectionOnce) {
+  DetectionFilterParams params;
+  params.min_score = 0.5f;
+  params.classes = {"drone", "plane"};
+  params.min_size = 10.0;
+  params.max_size = 200.0;
+  DetectionFilter filter(params);
+
+  DetectionSummary no_hypothesis;
+  no_hypothesis.size_x = no_hypothesis.size_y = 50.0;
+  const std::vector<DetectionSummary> detections = {
+      no_hypothesis,
+      detection("drone", 0.4f),                                      // low score
+      detection("drone", std::numeric_limits<float>::quiet_NaN()),  // low score
+      detection("bird", 0.9f),                                       // class
+      detection("drone", 0.1f, 5.0, 5.0),                            // low score first
+      detection("drone", 0.9f, 300.0, 9.0),                          // too small first
+      detection("plane", 0.9f, 0.0, 50.0),                           // empty box
+      detection("plane", 0.9f, 250.0, 50.0),                         // too large
+      detection("plane", 0.5f, 10.0, 200.0),                         // at every limit, kept
+      detection("drone", 0.95f),                                     // kept
+  };
+  std::vector<int> kept;
+  filter.select(detections, kept);
+  EXPECT_EQ(kept, (std::vector<int>{8, 9}));
+  EXPECT_EQ(filter.rejected(DetectionRejection::NO_HYPOTHESIS), 1u);
+  EXPECT_EQ(filter.rejected(DetectionRejection::LOW_SCORE), 3u);
+  EXPECT_EQ(filter.rejected(DetectionRejection::CLASS), 1u);
+  EXPECT_EQ(filter.rejected(DetectionRejection::TOO_SMALL), 2u);
+  EXPECT_EQ(filter.rejected(DetectionRejection::TOO_LARGE), 1u);
+  EXPECT_EQ(filter.rejected(DetectionRejection::OVER_LIMIT), 0u);
+
+  // the counters add up over frames
+  filter.select(detections, kept);
+  EXPECT_EQ(filter.rejected(DetectionRejection::LOW_SCORE), 6u);
+}
+
+TEST(DetectionFilter, KeepsBestScoresInInputOrder) {
+  DetectionFilterParams params;
+  params.max_detections = 3;
+  DetectionFilter filter(params);
+  const std::vector<DetectionSummary> detections = {
+      detection("drone", 0.2f), detection("drone", 0.9f), detection("drone", 0.5f),
+      detection("drone", 0.7f), detection("drone", 0.5f), detection("drone", 0.1f),
+  };
+  std::vector<int> kept;
+  filter.select(detections, kept);
+  // of the two 0.5 the first one wins
+  EXPECT_EQ(kept, (std::vector<int>{1, 2, 3}));
+  EXPECT_EQ(filter.rejected(DetectionRejection::OVER_LIMIT), 3u);
+
+  // under the limit nothing is dropped
+  filter.select({detections[0], detections[5]}, kept);
+  EXPECT_EQ(kept, (std::vector<int>{0, 1}));
+  EXPECT_EQ(filter.rejected(DetectionRejection::OVER_LIMIT), 3u);
+}
+
+TEST(DetectionFilter, EmptyFrame) {
+  DetectionFilterParams params;
+  params.max_detections = 2;
+  DetectionFilter filter(params);
+  std::vector<int> kept = {4, 2};
+  filter.select({}, kept);
+  EXPECT_TRUE(kept.empty());
+}
+
+TEST(DetectionFilter, RejectionNames) {
+  for (int i = 0; i < DetectionFilter::N; i++) {
+    EXPECT_NE(detectionRejectionName(static_cast<DetectionRejection>(i)), nullptr);
+  }
+  EXPECT_STREQ(detectionRejectionName(DetectionRejection::OVER_LIMIT), "over_limit");
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "cdr_writer.hpp"
+#include "point_cloud_view.hpp"
+
+struct TestPoint {
+  float x, y, z;
+};
+
+// xyz after an rgb field and before padding, the way most drivers lay them out
+static std::vector<uint8_t> organizedCloud(uint32_t width, uint32_t height, std::vector<TestPoint>& points) {
+  const uint32_t point_step = 20, row_step = width * point_step + 8;
+  std::vector<uint8_t> data(size_t(row_step) * height, 0xee);
+  for (uint32_t v = 0; v < height; v++) {
+    for (uint32_t u = 0; u < width; u++) {
+      const TestPoint p{0.1f * u, -0.2f * v, 1.0f + u + v};
+      points.push_back(p);
+      std::memcpy(&data[v * row_step + u * point_step + 4], &p, sizeof(p));
+    }
+  }
+  const std::vector<CloudField> fields = {{"rgb", 0, POINT_FIELD_FLOAT32},
+                                          {"x", 4, POINT_FIELD_FLOAT32},
+                                          {"y", 8, POINT_FIELD_FLOAT32},
+                                          {"z", 12, POINT_FIELD_FLOAT32},
+                                          {"intensity", 16, POINT_FIELD_FLOAT32}};
+  return encodeCloud(1700000001, 5, "camera_link", height, width, fields, point_step, row_step, data);
+}
+
+TEST(PointCloudView, RoundTrip) {
+  std::vector<TestPoint> points;
+  const auto buffer = organizedCloud(6, 4, points);
+
+  PointCloudView view;
+  std::string error;
+  ASSERT_TRUE(parseSerializedPointCloud(buffer.data(), buffer.size(), view, error)) << error;
+  EXPECT_EQ(view.width, 6u);
+  EXPECT_EQ(view.height, 4u);
+  EXPECT_EQ(view.stamp_ns, 1700000001000000005);
+  EXPECT_EQ(view.frame_id, "camera_link");
+
+  // a radius covering every point reads them all back in order
+  std::vector<TestPoint> out;
+  filterPointCloudSphere(view, Eigen::Affine3f::Identity(), Eigen::Vector3f::Zero(), 100.0f, out);
+  ASSERT_EQ(out.size(), points.size());
+  for (size_t i = 0; i < points.size(); i++) {
+    EXPECT_EQ(out[i].x, points[i].x);
+    EXPECT_EQ(out[i].y, points[i].y);
+    EXPECT_EQ(out[i].z, points[i].z);
+  }
+}
+
+TEST(PointCloudView, RejectsEveryTruncation) {
+  std::vector<TestPoint> points;
+  auto buffer = organizedCloud(3, 2, points);
+  // without the trailing is_dense the data ends the buffer
+  buffer.pop_back();
+  PointCloudView view;
+  std::string error;
+  for (size_t size = 0; size < buffer.size(); size++) {
+    EXPECT_FALSE(parseSerializedPointCloud(buffer.data(), size, view, error)) << size;
+  }
+}
+
+TEST(PointCloudView, RejectsBadLayouts) {
+  const std::vector<uint8_t> data(96);
+  const std::vector<CloudField> xyz = {{"x", 0, POINT_FIELD_FLOAT32}, {"y", 4, POINT_FIELD_FLOAT32},
+                                       {"z", 8, POINT_FIELD_FLOAT32}};
+  const std::vector<CloudField> xy = {{"x", 0, POINT_FIELD_FLOAT32}, {"y", 4, POINT_FIELD_FLOAT32}};
+  const std::vector<CloudField> double_z = {{"x", 0, POINT_FIELD_FLOAT32}, {"y", 4, POINT_FIELD_FLOAT32},
+                                            {"z", 8, 8}};
+  const std::vector<std::vector<uint8_t>> buffers = {
+      encodeCloud(0, 0, "c", 1, 8, xyz, 12, 96, data),        // fine
+      encodeCloud(0, 0, "c", 1, 8, xy, 12, 96, data),         // no z
+      encodeCloud(0, 0, "c", 1, 8, double_z, 12, 96, data),   // z not FLOAT32
+      encodeCloud(0, 0, "c", 1, 8, xyz, 10, 96, data),        // z past the point
+      encodeCloud(0, 0, "c", 1, 9, xyz, 12, 96, data),        // row longer than row_step
+      encodeCloud(0, 0, "c", 2, 8, xyz, 12, 96, data),        // rows past the data
+  };
+  const bool valid[] = {true, false, false, false, false, false};
+  PointCloudView view;
+  std::string error;
+  for (size_t i = 0; i < buffers.size(); i++) {
+    EXPECT_EQ(parseSerializedPointCloud(buffers[i].data(), buffers[i].size(), view, error), valid[i]) << i;
+  }
+}
+
+// Whatever the parser accepts must be read within the buffer, checked by the sanitizers
+TEST(PointCloudView, SurvivesCorruption) {
+  std::vector<TestPoint> points;
+  const auto original = organizedCloud(5, 3, points);
+  std::mt19937 rng(2);
+  PointCloudView view;
+  std::string error;
+  std::vector<TestPoint> out;
+  for (int trial = 0; trial < 5000; trial++) {
+    auto buffer = original;
+    const int flips = 1 + trial % 4;
+    for (int i = 0; i < flips; i++) buffer[rng() % buffer.size()] = static_cast<uint8_t>(rng());
+    buffer.resize(buffer.size() - rng() % 8);
+    if (!parseSerializedPointCloud(buffer.data(), buffer.size(), view, error)) continue;
+    if (view.size() > (1u << 22)) continue;
+    out.clear();
+    filterPointCloudSphere(view, Eigen::Affine3f::Identity(), Eigen::Vector3f::Zero(), 100.0f, out);
+  }
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "point_estimators.hpp"
+
+// 1 m x 1 m top rising 0.2 m across x above its footprint centre at 1 m, and a side wall
+static std::vector<Point3f> slopedTop() {
+  std::vector<Point3f> points;
+  for (int i = 0; i <= 20; i++) {
+    for (int j = 0; j <= 20; j++) {
+      const float x = -0.5f + 0.05f * i, y = -0.5f + 0.05f * j;
+      points.push_back({x, y, 1.0f + 0.2f * x});
+    }
+  }
+  for (int i = 0; i <= 20; i++) {
+    for (int k = 0; k < 10; k++) points.push_back({-0.5f, -0.5f + 0.05f * i, 0.09f * k});
+  }
+  return points;
+}
+
+TEST(PointEstimators, PlaneTopEvaluatedAboveFootprintCentre) {
+  const auto points = slopedTop();
+  const EstimatorFrame frame;
+  const EstimatorParams params;
+  Eigen::Vector3f slab, plane;
+  ASSERT_TRUE(TopSlabEstimator::estimate(points.data(), points.size(), frame, params, slab));
+  ASSERT_TRUE(PlaneTopEstimator::estimate(points.data(), points.size(), frame, params, plane));
+
+  // the slab only holds the high side of the top
+  EXPECT_GT(slab.x(), 0.2f);
+  EXPECT_GT(slab.z(), 1.04f);
+  // the wall pulls the footprint centre towards -x, the plane follows the slope down to it
+  Eigen::Vector3f footprint = Eigen::Vector3f::Zero();
+  for (const auto& p : points) footprint += toEigen(p);
+  footprint /= points.size();
+  EXPECT_NEAR(plane.x(), footprint.x(), 1e-4f);
+  EXPECT_NEAR(plane.y(), footprint.y(), 1e-4f);
+  EXPECT_NEAR(plane.z(), 1.0f + 0.2f * footprint.x(), 1e-3f);
+}
+
+TEST(PointEstimators, PlaneTopFallsBackOnDegenerateSlab) {
+  // a single point above the rest, and a slab along a line
+  const std::vector<std::vector<Point3f>> targets = {
+      {{0.3f, 0.2f, 2.0f}, {0.0f, 0.0f, 0.0f}, {-1.0f, 0.5f, 0.5f}},
+      {{0.0f, 0.0f, 2.0f}, {0.5f, 0.0f, 2.0f}, {1.0f, 0.0f, 2.0f}, {0.0f, 3.0f, 0.0f}},
+  };
+  const EstimatorFrame frame;
+  const EstimatorParams params;
+  for (const auto& points : targets) {
+    Eigen::Vector3f slab, plane;
+    ASSERT_TRUE(TopSlabEstimator::estimate(points.data(), points.size(), frame, params, slab));
+    ASSERT_TRUE(PlaneTopEstimator::estimate(points.data(), points.size(), frame, params, plane));
+    EXPECT_TRUE(plane.isApprox(slab)) << plane.transpose();
+  }
+}
+
+TEST(PointEstimators, NearestModeSkipsStrayPoints) {
+  // a few points 1 m in front of a surface 3 m away from the sensor
+  std::vector<Point3f> points;
+  for (int i = 0; i < 5; i++) points.push_back({2.0f, 0.01f * i, 0.0f});
+  for (int i = 0; i < 100; i++) points.push_back({3.0f, 0.01f * i, 0.0f});
+  const EstimatorFrame frame;
+  EstimatorParams params;
+  Eigen::Vector3f out;
+  ASSERT_TRUE(NearestModeEstimator::estimate(points.data(), points.size(), frame, params, out));
+  EXPECT_NEAR(out.x(), 3.0f, 1e-4f);
+
+  // every non empty bin qualifies with the smallest fraction, the stray points are the nearest
+  params.mode_min_fraction = 0.01f;
+  ASSERT_TRUE(NearestModeEstimator::estimate(points.data(), points.size(), frame, params, out));
+  EXPECT_NEAR(out.x(), 2.0f, 1e-4f);
+}
+
+TEST(PointEstimators, RejectsInvalidParams) {
+  std::string error;
+  EXPECT_TRUE(validEstimatorParams(EstimatorParams(), error));
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for (const float fraction : {0.0f, -0.5f, 1.5f, nan}) {
+    EstimatorParams params;
+    params.mode_min_fraction = fraction;
+    EXPECT_FALSE(validEstimatorParams(params, error)) << fraction;
+  }
+  for (const float size : {0.0f, -0.05f, nan}) {
+    EstimatorParams params;
+    params.mode_bin = size;
+    EXPECT_FALSE(validEstimatorParams(params, error)) << size;
+    params = EstimatorParams();
+    params.cluster_radius = size;
+    EXPECT_FALSE(validEstimatorParams(params, error)) << size;
+  }
+}
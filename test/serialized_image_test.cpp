@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "cdr_writer.hpp"
+#include "serialized_image.hpp"
+
+static const float UNTOUCHED = -1.0f;
+
+static std::vector<uint8_t> millimetreImage(int width, int height, uint32_t step, std::vector<uint16_t>& raw) {
+  std::vector<uint8_t> data(size_t(step) * height, 0xee);
+  raw.resize(size_t(width) * height);
+  for (int v = 0; v < height; v++) {
+    for (int u = 0; u < width; u++) {
+      raw[v * width + u] = static_cast<uint16_t>(v * 1000 + u * 7);
+      std::memcpy(&data[v * step + 2 * u], &raw[v * width + u], 2);
+    }
+  }
+  return encodeImage(1700000000, 250000000, "camera_depth_optical", height, width, "16UC1", false, step, data);
+}
+
+TEST(SerializedDepthImage, MillimetresRoundTrip) {
+  const int width = 7, height = 6;
+  std::vector<uint16_t> raw;
+  const auto buffer = millimetreImage(width, height, width * 2 + 6, raw);
+
+  SerializedDepthImage image;
+  std::string error;
+  ASSERT_TRUE(image.reset(buffer.data(), buffer.size(), error)) << error;
+  EXPECT_EQ(image.width(), width);
+  EXPECT_EQ(image.height(), height);
+  EXPECT_EQ(image.stampNs(), 1700000000250000000);
+  EXPECT_EQ(image.frameId(), "camera_depth_optical");
+
+  std::vector<float> depth(width * height, UNTOUCHED);
+  ASSERT_TRUE(image.decodeRows({{4, 6}, {1, 2}}, depth.data(), width, error)) << error;
+  for (int v = 0; v < height; v++) {
+    const bool requested = v == 1 || v >= 4;
+    for (int u = 0; u < width; u++) {
+      EXPECT_EQ(depth[v * width + u], requested ? raw[v * width + u] * 0.001f : UNTOUCHED) << v << " " << u;
+    }
+  }
+}
+
+TEST(SerializedDepthImage, BigEndianMetres) {
+  const int width = 3, height = 2;
+  const float values[] = {1.5f, std::numeric_limits<float>::quiet_NaN(), 0.25f,
+                          std::numeric_limits<float>::infinity(), 12.0f, 0.0f};
+  std::vector<uint8_t> data(sizeof(values));
+  for (int i = 0; i < width * height; i++) {
+    uint32_t bits;
+    std::memcpy(&bits, &values[i], 4);
+    bits = __builtin_bswap32(bits);
+    std::memcpy(&data[4 * i], &bits, 4);
+  }
+  const auto buffer = encodeImage(0, 0, "depth", height, width, "32FC1", true, width * 4, data);
+
+  SerializedDepthImage image;
+  std::string error;
+  ASSERT_TRUE(image.reset(buffer.data(), buffer.size(), error)) << error;
+  std::vector<float> depth(width * height, UNTOUCHED);
+  ASSERT_TRUE(image.decodeRows({{0, height}}, depth.data(), width, error)) << error;
+  for (int i = 0; i < width * height; i++) {
+    EXPECT_EQ(depth[i], std::isfinite(values[i]) ? values[i] : 0.0f) << i;
+  }
+}
+
+TEST(SerializedDepthImage, RejectsEveryTruncation) {
+  std::vector<uint16_t> raw;
+  const auto buffer = millimetreImage(4, 3, 8, raw);
+  SerializedDepthImage image;
+  std::string error;
+  for (size_t size = 0; size < buffer.size(); size++) {
+    EXPECT_FALSE(image.reset(buffer.data(), size, error)) << size;
+  }
+}
+
+TEST(SerializedDepthImage, RejectsInconsistentHeaders) {
+  SerializedDepthImage image;
+  std::string error;
+  const std::vector<uint8_t> data(64);
+  const std::vector<std::vector<uint8_t>> buffers = {
+      encodeImage(0, 0, "depth", 4, 4, "bgr8", false, 12, data),   // not depth
+      encodeImage(0, 0, "depth", 4, 4, "16UC1", false, 6, data),   // step shorter than a row
+      encodeImage(0, 0, "depth", 4, 4, "32FC1", false, 16, data),  // 4 rows of 16 bytes, fine
+      encodeImage(0, 0, "depth", 5, 4, "32FC1", false, 16, data),  // one row more than the data
+      encodeImage(0, 0, "depth", 0xffffffff, 0, "16UC1", false, 0, data),  // no pixels
+  };
+  const bool valid[] = {false, false, true, false, false};
+  for (size_t i = 0; i < buffers.size(); i++) {
+    EXPECT_EQ(image.reset(buffers[i].data(), buffers[i].size(), error), valid[i]) << i;
+  }
+}
+
+// Whatever reset accepts must decode within the buffer, checked by the sanitizers
+TEST(SerializedDepthImage, SurvivesCorruption) {
+  std::vector<uint16_t> raw;
+  const auto original = millimetreImage(9, 5, 20, raw);
+  std::mt19937 rng(1);
+  SerializedDepthImage image;
+  std::string error;
+  std::vector<float> depth;
+  for (int trial = 0; trial < 5000; trial++) {
+    auto buffer = original;
+    const int flips = 1 + trial % 4;
+    for (int i = 0; i < flips; i++) buffer[rng() % buffer.size()] = static_cast<uint8_t>(rng());
+    buffer.resize(buffer.size() - rng() % 8);
+    if (!image.reset(buffer.data(), buffer.size(), error)) continue;
+    ASSERT_GT(image.width(), 0);
+    ASSERT_GT(image.height(), 0);
+    if (size_t(image.width()) * image.height() > (1u << 22)) continue;
+    depth.assign(size_t(image.width()) * image.height(), UNTOUCHED);
+    EXPECT_TRUE(image.decodeRows({{0, image.height()}}, depth.data(), image.width(), error)) << error;
+  }
+}
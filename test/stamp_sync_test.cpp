@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "stamp_sync.hpp"
+
+struct Msg {
+  int64_t stamp;
+};
+
+typedef StampSync<Msg, Msg, Msg> Sync;
+
+static const int64_t PERIOD = 33333333;
+static const int64_t T0 = 1700000000000000000;
+
+struct Sets {
+  std::vector<std::array<int64_t, 3>> stamps;
+
+  Sync::Callback callback() {
+    return [this](const std::shared_ptr<Msg>& a, const std::shared_ptr<Msg>& b, const std::shared_ptr<Msg>& c) {
+      stamps.push_back({a ? a->stamp : -1, b ? b->stamp : -1, c ? c->stamp : -1});
+    };
+  }
+};
+
+template <size_t I>
+static void add(Sync& sync, int64_t stamp) {
+  sync.add<I>(stamp, std::make_shared<Msg>(Msg{stamp}));
+}
+
+TEST(StampSync, MatchesInAnyOrder) {
+  Sets sets;
+  Sync sync(0, 0, {true, true, true}, sets.callback());
+  const int64_t a = T0, b = T0 + PERIOD;
+  add<2>(sync, b);
+  add<0>(sync, a);
+  add<1>(sync, b);
+  add<1>(sync, a);
+  EXPECT_TRUE(sets.stamps.empty());
+  add<2>(sync, a);
+  add<0>(sync, b);
+  ASSERT_EQ(sets.stamps.size(), 2u);
+  EXPECT_EQ(sets.stamps[0], (std::array<int64_t, 3>{a, a, a}));
+  EXPECT_EQ(sets.stamps[1], (std::array<int64_t, 3>{b, b, b}));
+  EXPECT_EQ(sync.stats().matched, 2u);
+}
+
+TEST(StampSync, ClosestPartnerWithinTolerance) {
+  Sets sets;
+  const int64_t tolerance = 5000000;
+  Sync sync(tolerance, 0, {false, true, true}, sets.callback());
+  // two depth frames in reach, the closest one is taken
+  add<1>(sync, T0 - 4000000);
+  add<1>(sync, T0 + 1000000);
+  add<1>(sync, T0 + PERIOD);
+  add<2>(sync, T0);
+  ASSERT_EQ(sets.stamps.size(), 1u);
+  // no rgb, optional
+  EXPECT_EQ(sets.stamps[0], (std::array<int64_t, 3>{-1, T0 + 1000000, T0}));
+  // one more than the tolerance away
+  add<2>(sync, T0 + PERIOD + tolerance + 1);
+  EXPECT_EQ(sets.stamps.size(), 1u);
+  add<2>(sync, T0 + PERIOD - tolerance);
+  EXPECT_EQ(sets.stamps.size(), 2u);
+}
+
+TEST(StampSync, EvictsOldestWhenBucketIsFull) {
+  Sets sets;
+  Sync sync(0, 0, {true, true, true}, sets.callback());
+  // enough rgb frames to fill every way of every bucket several times over
+  const int n = 8 * Sync::SLOTS;
+  for (int i = 0; i < n; i++) add<0>(sync, T0 + i * PERIOD);
+  EXPECT_EQ(sync.stats().dropped[0], uint64_t(n - Sync::SLOTS));
+  EXPECT_EQ(sync.stats().partial, 0u);
+  // the newest frames are still there
+  add<1>(sync, T0 + (n - 1) * PERIOD);
+  add<2>(sync, T0 + (n - 1) * PERIOD);
+  EXPECT_EQ(sets.stamps.size(), 1u);
+
+  // an evicted required message takes its waiting partners with it, as a partial set
+  Sync partial(0, 0, {true, true, true}, sets.callback());
+  add<1>(partial, T0);
+  for (int i = 0; i < n; i++) add<0>(partial, T0 + i * PERIOD);
+  EXPECT_EQ(partial.stats().partial, 1u);
+  add<2>(partial, T0);
+  EXPECT_EQ(sets.stamps.size(), 1u);
+}
+
+TEST(StampSync, ExpiresMessagesOutOfWindow) {
+  Sets sets;
+  const int64_t window = 10 * PERIOD;
+  Sync sync(0, window, {true, true, true}, sets.callback());
+  ASSERT_EQ(sync.window(), window);
+  add<0>(sync, T0);
+  add<1>(sync, T0);
+  // a slow detector, the newest stamp moves on, out of the window of the first two frames
+  for (int i = 1; i <= 11; i++) add<0>(sync, T0 + i * PERIOD);
+  // the sweeps allow an eighth of the window of slack
+  EXPECT_EQ(sync.stats().dropped[0], 0u);
+  add<0>(sync, T0 + 12 * PERIOD);
+  EXPECT_EQ(sync.stats().dropped[0], 2u);
+  EXPECT_EQ(sync.stats().dropped[1], 1u);
+  // the detection arrives too late for its images, and is dropped as well
+  add<2>(sync, T0);
+  EXPECT_TRUE(sets.stamps.empty());
+  EXPECT_EQ(sync.stats().dropped[2], 1u);
+  // while one within the window still matches
+  add<1>(sync, T0 + 5 * PERIOD);
+  add<2>(sync, T0 + 5 * PERIOD);
+  EXPECT_EQ(sets.stamps.size(), 1u);
+}
+
+TEST(StampSync, DiscardForgetsPartners) {
+  Sets sets;
+  Sync sync(0, 0, {true, true, true}, sets.callback());
+  add<0>(sync, T0);
+  add<1>(sync, T0);
+  sync.discard(T0);
+  add<2>(sync, T0);
+  EXPECT_TRUE(sets.stamps.empty());
+  EXPECT_EQ(sync.stats().partial, 0u);
+  EXPECT_EQ(sync.stats().dropped[0] + sync.stats().dropped[1], 0u);
+}
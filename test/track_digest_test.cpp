@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <random>
+
+#include "track_digest.hpp"
+
+static TrackDigest testDigest() {
+  TrackDigest digest;
+  digest.vehicle_id = 3;
+  digest.sequence = 65535;
+  digest.stamp_ns = -1700000000123456789;
+  // unsorted ids, repeated classes, negative coordinates
+  digest.tracks = {
+      {42, "drone", {12.34, -5.67, 8.9}, {0.5, -0.25, 0.0}, 0.9f},
+      {7, "person", {-100.0, 0.01, 2.5}, {-1.2, 3.4, -0.01}, 0.55f},
+      {1000000, "drone", {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, 1.0f},
+      {8, "", {1e4, -1e4, 0.004}, {20.0, -20.0, 0.006}, 0.0f},
+  };
+  return digest;
+}
+
+TEST(TrackDigest, RoundTrip) {
+  const TrackDigest digest = testDigest();
+  std::vector<uint8_t> buffer;
+  encode_track_digest(digest, buffer);
+
+  TrackDigest decoded;
+  ASSERT_TRUE(decode_track_digest(buffer, decoded));
+  EXPECT_EQ(decoded.vehicle_id, digest.vehicle_id);
+  EXPECT_EQ(decoded.sequence, digest.sequence);
+  EXPECT_EQ(decoded.stamp_ns, digest.stamp_ns);
+  ASSERT_EQ(decoded.tracks.size(), digest.tracks.size());
+  // decoded sorted by id, within the 1 cm and 1 cm/s quanta
+  const int order[] = {1, 3, 0, 2};
+  for (size_t i = 0; i < decoded.tracks.size(); i++) {
+    const auto& in = digest.tracks[order[i]];
+    const auto& out = decoded.tracks[i];
+    EXPECT_EQ(out.id, in.id);
+    EXPECT_EQ(out.class_name, in.class_name);
+    EXPECT_LE((out.position - in.position).cwiseAbs().maxCoeff(), 0.005 + 1e-9) << out.id;
+    EXPECT_LE((out.velocity - in.velocity).cwiseAbs().maxCoeff(), 0.005 + 1e-9) << out.id;
+    EXPECT_NEAR(out.confidence, in.confidence, 0.5f / 255.0f + 1e-6f) << out.id;
+  }
+
+  // quantized values survive another round trip unchanged
+  std::vector<uint8_t> again;
+  encode_track_digest(decoded, again);
+  TrackDigest redecoded;
+  ASSERT_TRUE(decode_track_digest(again, redecoded));
+  ASSERT_EQ(redecoded.tracks.size(), decoded.tracks.size());
+  for (size_t i = 0; i < decoded.tracks.size(); i++) {
+    EXPECT_EQ(redecoded.tracks[i].id, decoded.tracks[i].id);
+    EXPECT_EQ(redecoded.tracks[i].class_name, decoded.tracks[i].class_name);
+    EXPECT_EQ(redecoded.tracks[i].position, decoded.tracks[i].position);
+    EXPECT_EQ(redecoded.tracks[i].velocity, decoded.tracks[i].velocity);
+    EXPECT_EQ(redecoded.tracks[i].confidence, decoded.tracks[i].confidence);
+  }
+}
+
+TEST(TrackDigest, Empty) {
+  TrackDigest digest;
+  std::vector<uint8_t> buffer;
+  encode_track_digest(digest, buffer);
+  TrackDigest decoded = testDigest();
+  ASSERT_TRUE(decode_track_digest(buffer, decoded));
+  EXPECT_TRUE(decoded.tracks.empty());
+}
+
+TEST(TrackDigest, RejectsEveryTruncation) {
+  std::vector<uint8_t> buffer;
+  encode_track_digest(testDigest(), buffer);
+  for (size_t size = 0; size < buffer.size(); size++) {
+    const std::vector<uint8_t> truncated(buffer.begin(), buffer.begin() + size);
+    TrackDigest decoded;
+    EXPECT_FALSE(decode_track_digest(truncated, decoded)) << size;
+  }
+}
+
+TEST(TrackDigest, RejectsUnknownVersionAndClass) {
+  std::vector<uint8_t> buffer;
+  encode_track_digest(testDigest(), buffer);
+  TrackDigest decoded;
+
+  auto version = buffer;
+  version[0] = TRACK_DIGEST_VERSION + 1;
+  EXPECT_FALSE(decode_track_digest(version, decoded));
+
+  // a single track pointing past the class table
+  TrackDigest one;
+  one.tracks = {{1, "drone", {0, 0, 0}, {0, 0, 0}, 1.0f}};
+  encode_track_digest(one, buffer);
+  // version, vehicle, sequence, stamp, 1 class "drone", 1 track, id delta, then the class index
+  const size_t class_index = 1 + 1 + 2 + 8 + 1 + 1 + 5 + 1 + 1;
+  ASSERT_EQ(buffer[class_index], 0);
+  buffer[class_index] = 1;
+  EXPECT_FALSE(decode_track_digest(buffer, decoded));
+}
+
+TEST(TrackDigest, RejectsIdOverflow) {
+  // two tracks of class "a", each 2^31 - 1 ids after the previous one
+  std::vector<uint8_t> buffer = {TRACK_DIGEST_VERSION, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 'a', 2};
+  for (int track = 0; track < 2; track++) {
+    buffer.insert(buffer.end(), {0xff, 0xff, 0xff, 0xff, 0x07, 0, 0, 0, 0, 0, 0, 0, 255});
+  }
+  TrackDigest decoded;
+  EXPECT_FALSE(decode_track_digest(buffer, decoded));
+  // the first one alone is valid
+  buffer[15] = 1;
+  buffer.resize(buffer.size() - 13);
+  ASSERT_TRUE(decode_track_digest(buffer, decoded));
+  EXPECT_EQ(decoded.tracks[0].id, std::numeric_limits<int>::max());
+}
+
+// Corrupted digests are rejected or decoded without reading past the buffer
+TEST(TrackDigest, SurvivesCorruption) {
+  std::vector<uint8_t> original;
+  encode_track_digest(testDigest(), original);
+  std::mt19937 rng(4);
+  for (int trial = 0; trial < 20000; trial++) {
+    auto buffer = original;
+    const int flips = 1 + trial % 4;
+    for (int i = 0; i < flips; i++) buffer[rng() % buffer.size()] = static_cast<uint8_t>(rng());
+    buffer.resize(buffer.size() - rng() % 4);
+    TrackDigest decoded;
+    decode_track_digest(buffer, decoded);
+  }
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "track_table.hpp"
+
+// a target moving at 1 m/s along x, measured with some noise on y
+static Eigen::Vector3f measurementAt(double t) {
+  return Eigen::Vector3f(t, 0.1f * static_cast<float>(static_cast<int>(t * 10) % 3), 2.0f);
+}
+
+static void expectSameState(const TrackTable& a, uint32_t slot_a, const TrackTable& b, uint32_t slot_b) {
+  EXPECT_TRUE(a.filtered(slot_a).isApprox(b.filtered(slot_b), 1e-5f))
+      << a.filtered(slot_a).transpose() << " / " << b.filtered(slot_b).transpose();
+  EXPECT_TRUE(a.velocity(slot_a).isApprox(b.velocity(slot_b), 1e-5f))
+      << a.velocity(slot_a).transpose() << " / " << b.velocity(slot_b).transpose();
+  EXPECT_TRUE(a.compensated(slot_a).isApprox(b.compensated(slot_b), 1e-5f));
+  EXPECT_EQ(a.hasCompensation(slot_a), b.hasCompensation(slot_b));
+  EXPECT_EQ(a.lastUpdate(slot_a), b.lastUpdate(slot_b));
+}
+
+TEST(TrackTable, LateMeasurementMatchesInOrder) {
+  const std::vector<double> stamps = {1.2, 2.4, 3.6, 4.8, 6.0};
+  const double late = 3.0;
+
+  // the late measurement arrives after every other one
+  TrackTable replayed;
+  const uint32_t r = replayed.add(measurementAt(0.0), 0.0);
+  // a second track the late commit leaves alone
+  const uint32_t other = replayed.add(Eigen::Vector3f(-5.0f, 0.0f, 1.0f), 0.0);
+  for (const double t : stamps) {
+    replayed.stage(r, measurementAt(t));
+    replayed.commit(t);
+  }
+  const Eigen::Vector3f other_before = replayed.filtered(other);
+  replayed.stage(r, measurementAt(late));
+  replayed.commit(late);
+  EXPECT_EQ(replayed.lateMeasurements(), 1u);
+  EXPECT_EQ(replayed.droppedLateMeasurements(), 0u);
+  EXPECT_EQ(replayed.filtered(other), other_before);
+
+  TrackTable in_order;
+  const uint32_t o = in_order.add(measurementAt(0.0), 0.0);
+  std::vector<double> sorted = stamps;
+  sorted.push_back(late);
+  std::sort(sorted.begin(), sorted.end());
+  for (const double t : sorted) {
+    in_order.stage(o, measurementAt(t));
+    in_order.commit(t);
+  }
+  EXPECT_EQ(in_order.lateMeasurements(), 0u);
+  expectSameState(replayed, r, in_order, o);
+}
+
+TEST(TrackTable, DropsMeasurementOlderThanHistory) {
+  TrackTable table;
+  const uint32_t slot = table.add(measurementAt(0.0), 0.0);
+  for (int i = 1; i <= TrackTable::HISTORY + 2; i++) {
+    table.stage(slot, measurementAt(i));
+    table.commit(i);
+  }
+  const Eigen::Vector3f filtered = table.filtered(slot);
+  const Eigen::Vector3f velocity = table.velocity(slot);
+  // older than the first measurement kept
+  table.stage(slot, measurementAt(1.5));
+  table.commit(1.5);
+  EXPECT_EQ(table.lateMeasurements(), 0u);
+  EXPECT_EQ(table.droppedLateMeasurements(), 1u);
+  EXPECT_EQ(table.filtered(slot), filtered);
+  EXPECT_EQ(table.velocity(slot), velocity);
+  EXPECT_EQ(table.lastUpdate(slot), TrackTable::HISTORY + 2);
+}
+
+TEST(TrackTable, RemovedSlotsAreReused) {
+  TrackTable table;
+  const uint32_t a = table.add(Eigen::Vector3f(1.0f, 0.0f, 0.0f), 0.0);
+  const uint32_t b = table.add(Eigen::Vector3f(2.0f, 0.0f, 0.0f), 0.0);
+  table.stage(a, Eigen::Vector3f(3.0f, 0.0f, 0.0f));
+  table.remove(a);
+  // the measurement staged before the removal is not applied to the new track
+  const uint32_t c = table.add(Eigen::Vector3f(5.0f, 0.0f, 0.0f), 1.0);
+  EXPECT_EQ(c, a);
+  table.commit(2.0);
+  EXPECT_EQ(table.size(), 2u);
+  EXPECT_EQ(table.filtered(c), Eigen::Vector3f(5.0f, 0.0f, 0.0f));
+  EXPECT_EQ(table.filtered(b), Eigen::Vector3f(2.0f, 0.0f, 0.0f));
+}